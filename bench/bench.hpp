@@ -0,0 +1,127 @@
+#ifndef MICRO_BENCH_H
+#define MICRO_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef BENCH_REV
+#define BENCH_REV "unknown"
+#endif
+
+// 微基准的运行框架：每个基准是一个 uint64_t(uint64_t iterations) 函数，返回处理的字节数（不关心时返回0）。
+// 迭代次数从1开始翻倍，直到一次运行超过--min-ms，再按这个次数重复--repeat次取中位数。
+// 默认输出对齐的文本；--json每行输出一个JSON对象（JSON Lines），带上编译时的git版本，便于保存和比较；
+// --baseline 文件 读取之前的--json输出，打印每个基准相对于它的变化
+class BenchRunner {
+public:
+    BenchRunner(int argc, char* argv[]) {
+        for(int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if(arg == "--json") { json_ = true; }
+            else if(arg == "--filter" && i + 1 < argc) { filter_ = argv[++i]; }
+            else if(arg == "--min-ms" && i + 1 < argc) { minMs_ = atoi(argv[++i]); }
+            else if(arg == "--repeat" && i + 1 < argc) { repeat_ = std::max(1, atoi(argv[++i])); }
+            else if(arg == "--baseline" && i + 1 < argc) { LoadBaseline_(argv[++i]); }
+            else {
+                fprintf(stderr, "usage: %s [--json] [--filter substring] [--min-ms 200] [--repeat 5] [--baseline old.jsonl]\n", argv[0]);
+                exit(1);
+            }
+        }
+    }
+
+    bool Enabled(const std::string& name) const {
+        return filter_.empty() || name.find(filter_) != std::string::npos;
+    }
+
+    void Run(const std::string& name, const std::function<uint64_t(uint64_t)>& fn) {
+        if(!Enabled(name)) { return; }
+        uint64_t iterations = 1;
+        double ns = 0;
+        uint64_t bytes = 0;
+        while(true) { // 确定迭代次数
+            ns = Time_(fn, iterations, bytes);
+            if(ns >= minMs_ * 1e6 || iterations >= (1ULL << 40)) { break; }
+            // 按已经测到的速度估计，最多放大10倍，避免第一次过快导致的误判
+            double scale = ns > 0 ? std::min(10.0, minMs_ * 1e6 * 1.2 / ns) : 10.0;
+            iterations = std::max(iterations + 1, static_cast<uint64_t>(iterations * scale));
+        }
+        std::vector<double> samples = {ns / iterations};
+        for(int i = 1; i < repeat_; i++) {
+            samples.push_back(Time_(fn, iterations, bytes) / iterations);
+        }
+        std::sort(samples.begin(), samples.end());
+        double median = samples[samples.size() / 2];
+        double bytesPerOp = static_cast<double>(bytes) / iterations;
+        Report_(name, iterations, median, samples.front(), samples.back(), bytesPerOp);
+    }
+
+private:
+    static double Time_(const std::function<uint64_t(uint64_t)>& fn, uint64_t iterations, uint64_t& bytes) {
+        auto begin = std::chrono::steady_clock::now();
+        bytes = fn(iterations);
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - begin).count();
+    }
+
+    void Report_(const std::string& name, uint64_t iterations, double ns, double minNs, double maxNs, double bytesPerOp) {
+        double mbPerSec = bytesPerOp > 0 ? bytesPerOp / ns * 1e9 / 1048576.0 : 0;
+        if(json_) {
+            printf("{\"bench\":\"%s\",\"rev\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.2f,\"min_ns_per_op\":%.2f,"
+                   "\"max_ns_per_op\":%.2f,\"ops_per_s\":%.0f,\"mb_per_s\":%.1f}\n",
+                   name.c_str(), BENCH_REV, static_cast<unsigned long long>(iterations), ns, minNs, maxNs, 1e9 / ns, mbPerSec);
+        } else {
+            char extra[32] = "";
+            if(mbPerSec > 0) { snprintf(extra, sizeof(extra), "%10.1f MB/s", mbPerSec); }
+            printf("%-44s %12.1f ns/op %12.0f ops/s%s", name.c_str(), ns, 1e9 / ns, extra);
+        }
+        auto it = baseline_.find(name);
+        if(it != baseline_.end()) {
+            fprintf(json_ ? stderr : stdout, "%s%+7.1f%% vs baseline", json_ ? (name + " ").c_str() : "  ",
+                    (ns - it->second) / it->second * 100);
+            if(json_) { fputc('\n', stderr); }
+        }
+        if(!json_) { putchar('\n'); }
+        fflush(stdout);
+    }
+
+    // 只需要读取自己输出的格式："bench":"名字" 和 "ns_per_op":数值
+    void LoadBaseline_(const char* file) {
+        FILE* in = fopen(file, "r");
+        if(!in) {
+            perror(file);
+            exit(1);
+        }
+        char line[1024];
+        while(fgets(line, sizeof(line), in)) {
+            const char* name = strstr(line, "\"bench\":\"");
+            const char* ns = strstr(line, "\"ns_per_op\":");
+            if(!name || !ns) { continue; }
+            name += 9;
+            const char* end = strchr(name, '"');
+            if(!end) { continue; }
+            baseline_[std::string(name, end)] = atof(ns + 12);
+        }
+        fclose(in);
+    }
+
+    bool json_ = false;
+    std::string filter_;
+    int minMs_ = 200;
+    int repeat_ = 5;
+    std::map<std::string, double> baseline_;
+};
+
+// 防止编译器把基准中的计算优化掉
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#endif // MICRO_BENCH_H
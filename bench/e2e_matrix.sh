@@ -0,0 +1,156 @@
+#!/bin/bash
+# 端到端基准矩阵：在回环地址上按每种配置（触发模式 × 线程数 × 文件发送方式）启动服务器，
+# 用bin/loadgen施加同样的负载（小HTML、图片、mp4分段请求、POST计算），
+# 收集吞吐量、延迟分位数、错误数、服务器的CPU时间和内存，最后输出一张对比表。
+#
+# 用法：bench/e2e_matrix.sh [-d 测量秒数] [-w 预热秒数] [-c 连接数] [-g loadgen线程数]
+#                          [-e "0 1 2 3"] [-t "4 12"] [-s "mmap sendfile"] [-p 端口] [-o 结果目录]
+# 每种配置的loadgen JSON、服务器日志保存在结果目录中，对比表另存为summary.csv
+set -u
+
+REPO=$(cd "$(dirname "$0")/.." && pwd)
+DURATION=10
+WARMUP=2
+CONNS=100
+LG_THREADS=2
+TRIG_MODES="0 1 2 3"
+THREADS="4 12"
+SEND_MODES="mmap sendfile"
+PORT=19006
+OUT="$REPO/bench_results/e2e-$(date +%Y%m%d-%H%M%S)"
+
+while getopts "d:w:c:g:e:t:s:p:o:" opt; do
+    case $opt in
+    d) DURATION=$OPTARG ;;
+    w) WARMUP=$OPTARG ;;
+    c) CONNS=$OPTARG ;;
+    g) LG_THREADS=$OPTARG ;;
+    e) TRIG_MODES=$OPTARG ;;
+    t) THREADS=$OPTARG ;;
+    s) SEND_MODES=$OPTARG ;;
+    p) PORT=$OPTARG ;;
+    o) OUT=$OPTARG ;;
+    *) sed -n '2,9p' "$0"; exit 1 ;;
+    esac
+done
+
+# 固定的负载：请求比例和mp4分段都不随配置变化，结果之间才可以比较。
+# 服务器的请求解析不支持流水线，keep-alive连接上的POST之后连接会被关闭重连，所以不使用-p
+MIX="6:GET:/index.html,2:GET:/picture/img.jpg"
+MIX="$MIX,1:GET:/video/mp4.mp4|Range: bytes=0-1048575"
+MIX="$MIX,1:GET:/video/mp4.mp4|Range: bytes=8388608-9437183"
+MIX="$MIX,1:POST:/CGI:a=3&b=4"
+
+(cd "$REPO" && make >/dev/null && make loadgen >/dev/null) || { echo "build failed" >&2; exit 1; }
+mkdir -p "$OUT"
+
+# 服务器从工作目录下的resources/提供文件：复制一份到临时目录，再生成16MB的mp4（内容无关紧要）
+WORK=$(mktemp -d)
+SERVER_PID=
+cleanup() {
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null && wait "$SERVER_PID" 2>/dev/null
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+cp -r "$REPO/resources" "$WORK/"
+mkdir -p "$WORK/resources/video"
+head -c $((16 * 1024 * 1024)) /dev/urandom > "$WORK/resources/video/mp4.mp4"
+
+CLK_TCK=$(getconf CLK_TCK)
+
+# 进程的用户态+内核态CPU时间（时钟滴答）：/proc/pid/stat的第14、15个字段
+cpu_ticks() {
+    awk '{print $14 + $15}' "/proc/$1/stat" 2>/dev/null || echo 0
+}
+
+wait_listen() {
+    for _ in $(seq 100); do
+        (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null && return 0
+        sleep 0.05
+    done
+    return 1
+}
+
+# 从loadgen的JSON中取值（不依赖jq）：json_num 文件 键，只取第一次出现（总体的结果，不是by_request中的）
+json_num() {
+    grep -o "\"$2\":[0-9.]*" "$1" | head -1 | cut -d: -f2
+}
+
+# 总体延迟分位数所在的对象
+json_latency() {
+    grep -o '"latency_us":{[^}]*}' "$1" | head -1 > "$1.lat"
+    json_num "$1.lat" "$2"
+    rm -f "$1.lat"
+}
+
+HEADER="config,rps,mb_per_s,p50_us,p99_us,p999_us,max_us,errors,non_2xx,cpu_pct,cpu_us_per_req,rss_mb,hwm_mb"
+echo "$HEADER" > "$OUT/summary.csv"
+printf "%-22s %10s %8s %9s %9s %9s %7s %7s %7s %9s %7s %7s\n" \
+    config rps MB/s p50_us p99_us p99.9_us errors non2xx cpu% cpu_us/req rss_MB hwm_MB
+
+for send in $SEND_MODES; do
+    for trig in $TRIG_MODES; do
+        for threads in $THREADS; do
+            name="e${trig}-t${threads}-${send}"
+            args=(-t "$threads" -e "$trig" -l "$OUT/server-$name.log")
+            [ "$send" = "sendfile" ] && args+=(-s)
+            (cd "$WORK" && exec "$REPO/bin/server" "${args[@]}" "$PORT") &
+            SERVER_PID=$!
+            if ! wait_listen; then
+                echo "$name: server did not start" >&2
+                kill "$SERVER_PID" 2>/dev/null; wait "$SERVER_PID" 2>/dev/null; SERVER_PID=
+                continue
+            fi
+
+            # CPU时间只统计测量阶段：预热结束时和测量结束时各取一次
+            cpu_file="$OUT/$name.cpu"
+            (
+                sleep "$WARMUP"; cpu_ticks "$SERVER_PID" > "$cpu_file"
+                sleep "$DURATION"; cpu_ticks "$SERVER_PID" >> "$cpu_file"
+            ) &
+            sampler=$!
+            "$REPO/bin/loadgen" -t "$LG_THREADS" -c "$CONNS" -w "$WARMUP" -d "$DURATION" -m "$MIX" \
+                -o "$OUT/$name.json" "http://127.0.0.1:$PORT" >/dev/null 2>"$OUT/$name.loadgen.log"
+            wait "$sampler"
+
+            rss_kb=$(awk '/^VmRSS:/ {print $2}' "/proc/$SERVER_PID/status" 2>/dev/null)
+            hwm_kb=$(awk '/^VmHWM:/ {print $2}' "/proc/$SERVER_PID/status" 2>/dev/null)
+            kill "$SERVER_PID" 2>/dev/null; wait "$SERVER_PID" 2>/dev/null; SERVER_PID=
+
+            json="$OUT/$name.json"
+            if [ ! -s "$json" ]; then
+                echo "$name: loadgen produced no result, see $OUT/$name.loadgen.log" >&2
+                continue
+            fi
+            rps=$(json_num "$json" rps)
+            requests=$(json_num "$json" requests)
+            mbps=$(json_num "$json" mb_per_s)
+            p50=$(json_latency "$json" p50)
+            p99=$(json_latency "$json" p99)
+            p999=$(json_latency "$json" p999)
+            max=$(json_latency "$json" max)
+            errors=0
+            for key in connect read timeout parse; do
+                errors=$((errors + $(json_num "$json" "$key")))
+            done
+            non2xx=0
+            for key in 1xx 3xx 4xx 5xx other; do
+                non2xx=$((non2xx + $(json_num "$json" "$key")))
+            done
+            read -r cpu0 cpu1 < <(tr '\n' ' ' < "$cpu_file")
+            rm -f "$cpu_file"
+            cpu_pct=$(awk -v a="$cpu0" -v b="$cpu1" -v hz="$CLK_TCK" -v d="$DURATION" \
+                'BEGIN {printf "%.0f", (b - a) / hz / d * 100}')
+            cpu_req=$(awk -v a="$cpu0" -v b="$cpu1" -v hz="$CLK_TCK" -v n="$requests" \
+                'BEGIN {printf "%.1f", (n > 0 ? (b - a) / hz * 1e6 / n : 0)}')
+            rss=$(awk -v k="${rss_kb:-0}" 'BEGIN {printf "%.1f", k / 1024}')
+            hwm=$(awk -v k="${hwm_kb:-0}" 'BEGIN {printf "%.1f", k / 1024}')
+
+            echo "$name,$rps,$mbps,$p50,$p99,$p999,$max,$errors,$non2xx,$cpu_pct,$cpu_req,$rss,$hwm" >> "$OUT/summary.csv"
+            printf "%-22s %10s %8s %9s %9s %9s %7s %7s %7s %9s %7s %7s\n" \
+                "$name" "$rps" "$mbps" "$p50" "$p99" "$p999" "$errors" "$non2xx" "$cpu_pct" "$cpu_req" "$rss" "$hwm"
+        done
+    done
+done
+
+echo "results: $OUT (summary.csv, <config>.json, server-<config>.log)"
@@ -0,0 +1,272 @@
+// 服务器热点组件的微基准：Buffer、HttpRequest::parse、HttpResponse::MakeResponse、Threadpool提交任务
+// make bench && ./bin/micro_bench [--json] [--filter buffer/] [--baseline old.jsonl]
+#include "bench.hpp"
+#include "../buffer/buffer.hpp"
+#include "../http/httprequest.hpp"
+#include "../http/httpresponse.hpp"
+#include "../threadpool/threadpool.hpp"
+#include "../log/log.hpp"
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <thread>
+
+namespace {
+const char SMALL_REQUEST[] =
+    "GET /index.html HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9006\r\n"
+    "User-Agent: curl/8.0.1\r\n"
+    "Accept: */*\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+// 浏览器发出的典型请求：20个左右的头部，带一个较长的Cookie
+std::string LargeRequest() {
+    std::string req =
+        "GET /picture.html HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+        "sec-ch-ua-mobile: ?0\r\n"
+        "sec-ch-ua-platform: \"Linux\"\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8\r\n"
+        "Sec-Fetch-Site: same-origin\r\n"
+        "Sec-Fetch-Mode: navigate\r\n"
+        "Sec-Fetch-User: ?1\r\n"
+        "Sec-Fetch-Dest: document\r\n"
+        "Referer: https://www.example.com/index.html\r\n"
+        "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en-US;q=0.8,en;q=0.7\r\n"
+        "If-None-Match: \"5f3c-6130e8b9c5a40\"\r\n"
+        "If-Modified-Since: Tue, 07 May 2024 08:12:45 GMT\r\n"
+        "Cookie: ";
+    for(int i = 0; i < 16; i++) {
+        req += "session_" + std::to_string(i) + "=0123456789abcdef0123456789abcdef0123456789abcdef; ";
+    }
+    req += "theme=dark\r\n\r\n";
+    return req;
+}
+
+const char POST_REQUEST[] =
+    "POST /CGI HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9006\r\n"
+    "Connection: keep-alive\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 11\r\n"
+    "\r\n"
+    "a=123&b=456";
+
+void BenchBuffer(BenchRunner& runner) {
+    runner.Run("buffer/append_retrieve_64B", [](uint64_t n) {
+        Buffer buff;
+        char data[64] = {};
+        for(uint64_t i = 0; i < n; i++) {
+            buff.Append(data, sizeof(data));
+            buff.Retrieve(sizeof(data));
+        }
+        DoNotOptimize(buff.ReadableBytes());
+        return n * sizeof(data);
+    });
+    // 新缓冲区从1KB增长到64KB（每次追加4KB）：MakeSpace_中的扩容和搬移
+    runner.Run("buffer/grow_1KB_to_64KB", [](uint64_t n) {
+        char data[4096] = {};
+        for(uint64_t i = 0; i < n; i++) {
+            Buffer buff;
+            for(int j = 0; j < 16; j++) {
+                buff.Append(data, sizeof(data));
+            }
+            DoNotOptimize(buff.ReadableBytes());
+        }
+        return n * 16 * sizeof(data);
+    });
+    // 缓冲区中始终留着100字节（半个请求）：写到末尾时把未读的数据搬回开头，不扩容
+    runner.Run("buffer/append_partial_retrieve_4KB", [](uint64_t n) {
+        Buffer buff(16 * 1024);
+        char data[4096] = {};
+        buff.Append(data, 100);
+        for(uint64_t i = 0; i < n; i++) {
+            buff.Append(data, sizeof(data));
+            buff.Retrieve(sizeof(data));
+        }
+        DoNotOptimize(buff.ReadableBytes());
+        return n * sizeof(data);
+    });
+    for(size_t size : {4096, 65536}) {
+        runner.Run("buffer/readfd_socketpair_" + std::to_string(size / 1024) + "KB", [size](uint64_t n) {
+            int fds[2];
+            if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+                perror("socketpair");
+                exit(1);
+            }
+            int sndbuf = 1 << 20;
+            setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+            std::vector<char> data(size, 'x');
+            Buffer buff;
+            int err = 0;
+            for(uint64_t i = 0; i < n; i++) {
+                size_t left = size;
+                while(left > 0) {
+                    ssize_t w = write(fds[1], data.data(), left);
+                    if(w <= 0) { perror("write"); exit(1); }
+                    left -= w;
+                    while(buff.ReadableBytes() < size - left) {
+                        buff.ReadFd(fds[0], &err);
+                    }
+                }
+                buff.RetrieveAll();
+            }
+            close(fds[0]);
+            close(fds[1]);
+            return n * size;
+        });
+    }
+}
+
+void BenchParse(BenchRunner& runner) {
+    struct Case {
+        const char* name;
+        std::string request;
+    };
+    Case cases[] = {
+        {"http/parse_small_5_headers", SMALL_REQUEST},
+        {"http/parse_large_20_headers", LargeRequest()},
+        {"http/parse_post_form", POST_REQUEST},
+    };
+    for(auto& c : cases) {
+        const std::string request = c.request;
+        runner.Run(c.name, [request](uint64_t n) {
+            Buffer buff;
+            HttpRequest req;
+            for(uint64_t i = 0; i < n; i++) {
+                buff.Append(request);
+                req.Init();
+                req.parse(buff);
+                buff.RetrieveAll();
+            }
+            DoNotOptimize(req.path());
+            return n * request.size();
+        });
+    }
+}
+
+// 生成测试文件，放在/var/tmp（一般不是tmpfs），冷读时posix_fadvise才能把页从页缓存中去掉
+std::string MakeFiles() {
+    char dir[] = "/var/tmp/micro_bench.XXXXXX";
+    if(!mkdtemp(dir)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    for(size_t size : {2048, 65536, 1048576}) {
+        std::string path = std::string(dir) + "/" + std::to_string(size / 1024) + "KB.html";
+        FILE* file = fopen(path.c_str(), "w");
+        std::string data(size, 'a');
+        fwrite(data.data(), 1, data.size(), file);
+        fclose(file);
+    }
+    return std::string(dir) + "/";
+}
+
+void RemoveFiles(const std::string& dir) {
+    for(const char* name : {"2KB.html", "64KB.html", "1024KB.html"}) {
+        unlink((dir + name).c_str());
+    }
+    rmdir(dir.c_str());
+}
+
+// 响应：stat + open + mmap + 拼响应头，再按页读一遍映射（相当于writev从映射中取数据时的缺页）
+// hot：文件在页缓存中；cold：每次先用POSIX_FADV_DONTNEED把文件从页缓存中去掉（计时包含这次系统调用）
+std::string ResponseBenchName(size_t size, bool cold) {
+    return "http/make_response_" + std::string(cold ? "cold_" : "hot_") + std::to_string(size / 1024) + "KB";
+}
+
+void BenchResponse(BenchRunner& runner) {
+    //按完整的基准名判断过滤条件（如--filter cold、--filter 1024KB），没有选中任何一个时不生成测试文件
+    bool any = false;
+    for(size_t size : {2048, 65536, 1048576}) {
+        for(bool cold : {false, true}) {
+            any = any || runner.Enabled(ResponseBenchName(size, cold));
+        }
+    }
+    if(!any) { return; }
+    std::string dir = MakeFiles();
+    for(size_t size : {2048, 65536, 1048576}) {
+        std::string file = "/" + std::to_string(size / 1024) + "KB.html";
+        for(bool cold : {false, true}) {
+            runner.Run(ResponseBenchName(size, cold), [dir, file, size, cold](uint64_t n) {
+                HttpResponse response;
+                Buffer buff;
+                std::string path = file;
+                std::unordered_map<std::string, int> post;
+                uint64_t sum = 0;
+                for(uint64_t i = 0; i < n; i++) {
+                    if(cold) {
+                        int fd = open((dir + file).c_str(), O_RDONLY);
+                        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+                        close(fd);
+                    }
+                    path = file;
+                    response.Init(dir, path, post, true, -1);
+                    response.MakeResponse(buff);
+                    const char* data = response.File();
+                    for(size_t off = 0; data && off < response.FileLen(); off += 4096) {
+                        sum += data[off];
+                    }
+                    buff.RetrieveAll();
+                }
+                response.UnmapFile();
+                DoNotOptimize(sum);
+                return n * size;
+            });
+        }
+    }
+    RemoveFiles(dir);
+}
+
+// 多个生产者向线程池提交空任务，直到全部执行完
+void BenchThreadpool(BenchRunner& runner) {
+    for(Mode mode : {Mode::FIXED, Mode::STEALING}) {
+        for(int producers : {1, 2, 4}) {
+            for(int consumers : {1, 2, 4}) {
+                std::string name = std::string("threadpool/submit_") + (mode == Mode::FIXED ? "fixed" : "stealing") +
+                                   "_p" + std::to_string(producers) + "_c" + std::to_string(consumers);
+                runner.Run(name, [mode, producers, consumers](uint64_t n) {
+                    std::atomic<uint64_t> done(0);
+                    Threadpool pool;
+                    pool.setMode(mode);
+                    pool.setTaskQueueThreshold(4096);
+                    pool.setOverloadPolicy(Overload::BLOCK);
+                    pool.start(consumers);
+                    uint64_t total = n / producers * producers;
+                    std::vector<std::thread> threads;
+                    for(int p = 0; p < producers; p++) {
+                        threads.emplace_back([&pool, &done, total, producers] {
+                            for(uint64_t i = 0; i < total / producers; i++) {
+                                pool.post([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+                            }
+                        });
+                    }
+                    for(auto& t : threads) { t.join(); }
+                    while(done.load(std::memory_order_relaxed) < total) {
+                        std::this_thread::yield();
+                    }
+                    return uint64_t(0);
+                });
+            }
+        }
+    }
+}
+}
+
+int main(int argc, char* argv[]) {
+    BenchRunner runner(argc, argv);
+    Logger::root()->setLevel(LogLevel::ERROR); //解析时的DEBUG日志不计入
+    BenchBuffer(runner);
+    BenchParse(runner);
+    BenchResponse(runner);
+    BenchThreadpool(runner);
+    return 0;
+}
@@ -1,6 +1,14 @@
 #include "buffer.hpp"
 
-Buffer::Buffer(int initBuffSize) : buffer_(initBuffSize), readPos_(0), writePos_(0) {}
+Buffer::Buffer(int initBuffSize) : buffer_(initBuffSize), readPos_(0), writePos_(0)
+{
+    Metrics::Add(Gauge::BUFFER_BYTES, static_cast<int64_t>(buffer_.size())); // 缓冲区占用的内存计入指标
+}
+
+Buffer::~Buffer()
+{
+    Metrics::Add(Gauge::BUFFER_BYTES, -static_cast<int64_t>(buffer_.size()));
+}
 
 // 返回可以写入缓冲区的字节数
 size_t Buffer::WritableBytes() const
@@ -136,7 +144,9 @@ void Buffer::MakeSpace_(size_t len)
 {
     if (WritableBytes() + PrependableBytes() < len)
     { // 剩余可写的大小 加 前面可用的空间(已经读取过的缓存) 小于 临时数组中的长度
+        size_t old = buffer_.size();
         buffer_.resize(writePos_ + len + 1);
+        Metrics::Add(Gauge::BUFFER_BYTES, static_cast<int64_t>(buffer_.size() - old));
     }
     else
     { // 可以装len长度的数据 就直接将后面的数据拷贝到前面
@@ -9,11 +9,13 @@
 #include <atomic>
 #include <assert.h>
 
+#include "../metrics/metrics.hpp"
+
 class Buffer {
 public:
     // 缓冲区初始大小
     Buffer(int initBuffSize = 1024);
-    ~Buffer() = default; 
+    ~Buffer(); 
     // 可写的字节数
     size_t WritableBytes() const;       
     // 剩余可读的字节数    
@@ -0,0 +1,259 @@
+#include "accesslog.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
+namespace {
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void AppendNumber(std::string& out, uint64_t value) {
+    char buf[20];
+    char* p = buf + sizeof(buf);
+    do {
+        *--p = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while(value);
+    out.append(p, buf + sizeof(buf) - p);
+}
+
+// 纳秒转换成秒，保留微秒（Apache %D/nginx $request_time的习惯）
+void AppendSeconds(std::string& out, uint64_t ns) {
+    uint64_t us = ns / 1000;
+    AppendNumber(out, us / 1000000);
+    char frac[8];
+    snprintf(frac, sizeof(frac), ".%06u", static_cast<unsigned>(us % 1000000));
+    out.append(frac);
+}
+
+// combined格式的引号字段：转义引号、反斜杠和控制字符，空值写作"-"
+void AppendQuoted(std::string& out, const std::string* str) {
+    out.append(1, '"');
+    if(!str || str->empty()) {
+        out.append(1, '-');
+    } else {
+        for(unsigned char c : *str) {
+            if(c == '"' || c == '\\') {
+                out.append(1, '\\');
+                out.append(1, c);
+            } else if(c < 0x20 || c == 0x7f) {
+                char hex[8];
+                snprintf(hex, sizeof(hex), "\\x%02x", c);
+                out.append(hex);
+            } else {
+                out.append(1, c);
+            }
+        }
+    }
+    out.append(1, '"');
+}
+
+void AppendJsonString(std::string& out, const std::string* str) {
+    out.append(1, '"');
+    if(str) {
+        for(unsigned char c : *str) {
+            switch(c) {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default:
+                if(c < 0x20) {
+                    char hex[8];
+                    snprintf(hex, sizeof(hex), "\\u%04x", c);
+                    out.append(hex);
+                } else {
+                    out.append(1, c);
+                }
+            }
+        }
+    }
+    out.append(1, '"');
+}
+
+// 按实例编号而不是地址判断归属：析构后新建的AccessLog可能恰好分配在同一个地址上
+std::atomic<uint64_t> nextInstanceId(1);
+
+struct ThreadBatch {
+    uint64_t owner = 0;
+    std::shared_ptr<void> batch; // 实际类型是AccessLog::Batch
+    std::atomic<bool>* closed = nullptr;
+    ~ThreadBatch() {
+        if(closed) { closed->store(true, std::memory_order_release); }
+    }
+};
+thread_local ThreadBatch tlsBatch;
+}
+
+AccessLog::AccessLog(const std::string& fileName, Format format, const LogFileOptions& fileOptions,
+                     size_t batchBytes, int flushIntervalMs)
+    : id_(nextInstanceId.fetch_add(1, std::memory_order_relaxed)), format_(format), batchBytes_(batchBytes), flushIntervalMs_(flushIntervalMs),
+      appender_(fileName, 4 * 1024 * 1024, 8, LogOverflow::DROP, flushIntervalMs, fileOptions),
+      timeFormatter_(format == JSON ? "%d{%Y-%m-%dT%H:%M:%S.%3N%z}" : "%d{%d/%b/%Y:%H:%M:%S %z}"),
+      running_(true) {
+    thread_ = std::thread(&AccessLog::ThreadFunc_, this);
+}
+
+AccessLog::~AccessLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        cond_.notify_all();
+    }
+    thread_.join();
+    FlushAll_(0); //存活线程（reactor、协程模式下的主线程）手里的批量缓冲区也要写出
+    appender_.flush();
+}
+
+// 当前线程的批量缓冲区，第一次调用时注册
+AccessLog::Batch* AccessLog::ThreadBatch_() {
+    if(tlsBatch.owner == id_) {
+        return static_cast<Batch*>(tlsBatch.batch.get());
+    }
+    auto batch = std::make_shared<Batch>();
+    batch->data.reserve(batchBytes_ + 1024);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batches_.push_back(batch);
+    }
+    if(tlsBatch.closed) { tlsBatch.closed->store(true, std::memory_order_release); }
+    tlsBatch.owner = id_;
+    tlsBatch.batch = batch;
+    tlsBatch.closed = &batch->closed;
+    return batch.get();
+}
+
+void AccessLog::Log(const AccessRecord& record) {
+    Batch* batch = ThreadBatch_();
+    std::lock_guard<std::mutex> lock(batch->mutex);
+    if(batch->data.empty()) {
+        batch->firstMs = NowMs();
+    }
+    if(format_ == JSON) {
+        FormatJson_(batch->data, record);
+    } else {
+        FormatCombined_(batch->data, record);
+    }
+    if(batch->data.size() >= batchBytes_) {
+        TakeBatch_(*batch);
+    }
+}
+
+// 127.0.0.1 - - [10/Oct/2024:13:55:36 +0800] "GET /index.html HTTP/1.1" 200 2326 "-" "curl/8.0" rt=0.000412 pt=0.000021 wt=0.000030 ka=1
+void AccessLog::FormatCombined_(std::string& out, const AccessRecord& record) {
+    out.append(record.remote);
+    out.append(" - - [");
+    timeFormatter_.format(out, LogLevel::INFO, LogEvent(nullptr, 0, std::thread::id(), std::string(), record.time));
+    out.append("] \"");
+    if(record.method->empty()) {
+        out.append(1, '-'); //请求行解析失败
+    } else {
+        out.append(*record.method);
+        out.append(1, ' ');
+        out.append(*record.target);
+        out.append(" HTTP/");
+        out.append(*record.version);
+    }
+    out.append("\" ");
+    AppendNumber(out, record.status);
+    out.append(1, ' ');
+    AppendNumber(out, record.bytes);
+    out.append(1, ' ');
+    AppendQuoted(out, record.referer);
+    out.append(1, ' ');
+    AppendQuoted(out, record.userAgent);
+    out.append(" rt=");
+    AppendSeconds(out, record.requestNs);
+    out.append(" pt=");
+    AppendSeconds(out, record.parseNs);
+    out.append(" wt=");
+    AppendSeconds(out, record.writeNs);
+    out.append(record.keepAlive ? " ka=1\n" : " ka=0\n");
+}
+
+void AccessLog::FormatJson_(std::string& out, const AccessRecord& record) {
+    out.append("{\"time\":\"");
+    timeFormatter_.format(out, LogLevel::INFO, LogEvent(nullptr, 0, std::thread::id(), std::string(), record.time));
+    out.append("\",\"remote\":\"");
+    out.append(record.remote);
+    out.append("\",\"method\":");
+    AppendJsonString(out, record.method);
+    out.append(",\"target\":");
+    AppendJsonString(out, record.target);
+    out.append(",\"version\":");
+    AppendJsonString(out, record.version);
+    out.append(",\"status\":");
+    AppendNumber(out, record.status);
+    out.append(",\"bytes\":");
+    AppendNumber(out, record.bytes);
+    out.append(",\"referer\":");
+    AppendJsonString(out, record.referer);
+    out.append(",\"user_agent\":");
+    AppendJsonString(out, record.userAgent);
+    out.append(",\"keep_alive\":");
+    out.append(record.keepAlive ? "true" : "false");
+    out.append(",\"request_us\":");
+    AppendNumber(out, record.requestNs / 1000);
+    out.append(",\"parse_us\":");
+    AppendNumber(out, record.parseNs / 1000);
+    out.append(",\"write_us\":");
+    AppendNumber(out, record.writeNs / 1000);
+    out.append("}\n");
+}
+
+void AccessLog::TakeBatch_(Batch& batch) {
+    if(!batch.data.empty()) {
+        appender_.append(batch.data.data(), batch.data.size());
+        batch.data.clear();
+    }
+}
+
+// 取走缓冲时间超过olderThanMs的批量缓冲区，释放已经退出的线程的缓冲区
+bool AccessLog::FlushAll_(int64_t olderThanMs) {
+    std::vector<std::shared_ptr<Batch>> batches;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batches = batches_;
+    }
+    int64_t now = NowMs();
+    bool taken = false;
+    std::vector<std::shared_ptr<Batch>> closed;
+    for(auto& batch : batches) {
+        // 先读closed再取数据：线程退出之前写入的记录都会被取走
+        bool isClosed = batch->closed.load(std::memory_order_acquire);
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        if(!batch->data.empty() && (isClosed || now - batch->firstMs >= olderThanMs)) {
+            TakeBatch_(*batch);
+            taken = true;
+        }
+        if(isClosed) { closed.push_back(batch); }
+    }
+    if(!closed.empty()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto& batch : closed) {
+            auto it = std::find(batches_.begin(), batches_.end(), batch);
+            if(it != batches_.end()) { batches_.erase(it); }
+        }
+    }
+    return taken;
+}
+
+void AccessLog::Flush() {
+    FlushAll_(0);
+    appender_.flush();
+}
+
+// 后台线程：定期取走攒了一段时间还没写满的批量缓冲区，请求很少时日志也不会无限期地留在内存中
+void AccessLog::ThreadFunc_() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(running_) {
+        cond_.wait_for(lock, std::chrono::milliseconds(std::max(flushIntervalMs_ / 2, 1)), [this] { return !running_; });
+        lock.unlock();
+        if(FlushAll_(flushIntervalMs_)) {
+            appender_.flush(); //不再等appender自己的刷新间隔
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../log/asynclog.hpp"
+
+// 一个请求的访问记录，时间均为纳秒
+struct AccessRecord {
+    const char *remote;       // 客户端地址
+    uint64_t time;            // 请求开始的墙上时间（system_clock）
+    const std::string *method;
+    const std::string *target; // 请求行中的原始URL
+    const std::string *version;
+    const std::string *referer;
+    const std::string *userAgent;
+    int status;
+    size_t bytes;             // 实际发送的字节数（响应头+文件）
+    bool keepAlive;
+    uint64_t requestNs;       // 收到第一个字节到响应写完
+    uint64_t parseNs;         // 解析请求
+    uint64_t writeNs;         // 生成响应之后到写完
+};
+
+// 访问日志：每个工作线程把格式化好的记录追加到自己的批量缓冲区，攒够batchBytes或者超过flushIntervalMs
+// 才整批交给AsyncLogAppender（一次加锁、一次memcpy），由它的后台线程写文件（滚动、mmap写入见LogFile），
+// 每个请求没有系统调用
+class AccessLog {
+public:
+    enum Format {
+        COMBINED, // NCSA combined，后面追加耗时字段
+        JSON      // 每行一个JSON对象
+    };
+
+    AccessLog(const std::string& fileName, Format format, const LogFileOptions& fileOptions = LogFileOptions(),
+              size_t batchBytes = 16 * 1024, int flushIntervalMs = 1000);
+    ~AccessLog();
+
+    void Log(const AccessRecord& record);
+    // 把所有线程的批量缓冲区交给appender并等待写出
+    void Flush();
+
+private:
+    // 一个线程的批量缓冲区；mutex只在后台线程按时间取走数据时才有竞争
+    struct Batch {
+        std::mutex mutex;
+        std::string data;
+        int64_t firstMs = 0; // 缓冲区中第一条记录的时间
+        std::atomic<bool> closed{false}; // 所属线程已经退出
+    };
+
+    Batch* ThreadBatch_();
+    void FormatCombined_(std::string& out, const AccessRecord& record);
+    void FormatJson_(std::string& out, const AccessRecord& record);
+    void TakeBatch_(Batch& batch); // 持有batch.mutex
+    bool FlushAll_(int64_t olderThanMs); // 返回是否取走了数据
+    void ThreadFunc_();
+
+    uint64_t id_; // 实例编号，线程的批量缓冲区按它归属
+    Format format_;
+    size_t batchBytes_;
+    int flushIntervalMs_;
+    AsyncLogAppender appender_;
+    LogFormatter timeFormatter_; // 按秒缓存的时间文本
+
+    std::mutex mutex_; // 保护batches_和后台线程的状态
+    std::condition_variable cond_;
+    std::vector<std::shared_ptr<Batch>> batches_;
+    bool running_;
+    std::thread thread_;
+};
+
+#endif // ACCESS_LOG_H
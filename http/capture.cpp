@@ -0,0 +1,81 @@
+#include "capture.hpp"
+#include "../log/log.hpp"
+#include "../metrics/clock.hpp"
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <unistd.h>
+
+TrafficCapture::TrafficCapture(const std::string& fileName, double sampleRate, uint64_t maxBytes)
+    : sampleRate_(sampleRate), maxBytes_(maxBytes), startNs_(CheapClock::NowNs()),
+      connSeq_(0), nextId_(1), bytes_(0), full_(false),
+      appender_(fileName, 4 * 1024 * 1024, 8, LogOverflow::DROP, 1000) {
+    // LogFile以追加方式打开，旧的捕获文件先清空，新文件以文件头开始
+    if(truncate(fileName.c_str(), 0) < 0) {
+        LOG_WARN("truncate capture file %s failed: %s", fileName.c_str(), strerror(errno));
+    }
+    capture::FileHeader header;
+    memcpy(header.magic, capture::MAGIC, sizeof(header.magic));
+    header.wallNs = std::chrono::system_clock::now().time_since_epoch().count();
+    Reserve_(sizeof(header));
+    appender_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    LOG_INFO("Capturing %.0f%% of connections to %s, limit %llu MB", sampleRate_ * 100, fileName.c_str(),
+             static_cast<unsigned long long>(maxBytes_ >> 20));
+}
+
+TrafficCapture::~TrafficCapture() {
+    appender_.flush();
+}
+
+// 第n个连接在floor((n+1)*rate)比floor(n*rate)大时抽中：比例准确，抽中的连接均匀分布，结果可以复现
+uint32_t TrafficCapture::Open() {
+    if(full_.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    uint64_t seq = connSeq_.fetch_add(1, std::memory_order_relaxed);
+    if(static_cast<uint64_t>((seq + 1) * sampleRate_) == static_cast<uint64_t>(seq * sampleRate_)) {
+        return 0;
+    }
+    uint32_t conn = nextId_.fetch_add(1, std::memory_order_relaxed);
+    Append_(conn, capture::OPEN, nullptr, 0);
+    return conn;
+}
+
+void TrafficCapture::Data(uint32_t conn, const char* data, size_t len) {
+    while(len > 0) {
+        size_t n = std::min<size_t>(len, capture::MAX_DATA);
+        Append_(conn, capture::DATA, data, n);
+        data += n;
+        len -= n;
+    }
+}
+
+void TrafficCapture::Close(uint32_t conn) {
+    Append_(conn, capture::CLOSE, nullptr, 0);
+}
+
+bool TrafficCapture::Reserve_(size_t bytes) {
+    if(bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes > maxBytes_) {
+        if(!full_.exchange(true)) {
+            LOG_WARN("Capture file reached %llu MB, capture stopped", static_cast<unsigned long long>(maxBytes_ >> 20));
+        }
+        return false;
+    }
+    return true;
+}
+
+// 记录头和数据拼成一块交给appender，多个线程的记录不会交错
+void TrafficCapture::Append_(uint32_t conn, capture::Type type, const char* data, size_t len) {
+    if(full_.load(std::memory_order_relaxed) || !Reserve_(sizeof(capture::Record) + len)) {
+        return;
+    }
+    capture::Record record;
+    uint64_t now = CheapClock::NowNs();
+    record.offsetNs = now > startNs_ ? now - startNs_ : 0;
+    record.conn = conn;
+    record.typeLen = static_cast<uint32_t>(type) << 24 | static_cast<uint32_t>(len);
+    thread_local std::string out;
+    out.assign(reinterpret_cast<const char*>(&record), sizeof(record));
+    if(len) { out.append(data, len); }
+    appender_.append(out.data(), out.size());
+}
@@ -0,0 +1,70 @@
+#ifndef TRAFFIC_CAPTURE_H
+#define TRAFFIC_CAPTURE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "../log/asynclog.hpp"
+
+// 捕获文件的格式（主机字节序）：文件头，之后是一条条记录，每条记录是记录头加上数据。
+// 连接按编号区分，同一个连接的记录按时间顺序出现；不同连接的记录由多个工作线程写入，之间可能有微小的乱序
+namespace capture {
+const char MAGIC[8] = {'W', 'S', 'C', 'A', 'P', '0', '0', '1'};
+
+struct FileHeader {
+    char magic[8];
+    uint64_t wallNs; // 捕获开始的墙上时间（system_clock）
+};
+
+enum Type : uint8_t {
+    OPEN = 1,  // 接受连接，没有数据
+    DATA = 2,  // 一次read读到的请求字节
+    CLOSE = 3, // 连接关闭，没有数据
+};
+
+const uint32_t LEN_MASK = (1u << 24) - 1;
+const uint32_t MAX_DATA = 1u << 20; // 一条记录最多的数据，更长的一次读取拆成多条记录（不能超过appender的缓冲区）
+
+struct Record {
+    uint64_t offsetNs; // 相对捕获开始的时间
+    uint32_t conn;     // 连接编号，从1开始
+    uint32_t typeLen;  // 高8位类型，低24位数据长度
+
+    Type type() const { return static_cast<Type>(typeLen >> 24); }
+    uint32_t len() const { return typeLen & LEN_MASK; }
+};
+static_assert(sizeof(Record) == 16, "capture record header must stay 16 bytes");
+}
+
+// 流量捕获：按比例抽样连接，把抽中的连接读到的原始请求字节连同相对时间写入二进制文件，
+// 用bin/replay按原来的时间间隔（或加速）重放。抽样按连接进行，抽中的连接从接受开始完整记录；
+// 写入经过AsyncLogAppender（一次加锁、后台线程批量写出），文件达到上限后停止捕获，正在记录的连接在此截断
+class TrafficCapture {
+public:
+    // sampleRate在(0, 1]之间：抽中的连接所占的比例，按接受的顺序均匀分布
+    TrafficCapture(const std::string& fileName, double sampleRate, uint64_t maxBytes);
+    ~TrafficCapture();
+
+    // 新连接：抽中时返回连接编号，否则返回0
+    uint32_t Open();
+    void Data(uint32_t conn, const char* data, size_t len);
+    void Close(uint32_t conn);
+
+    uint64_t Bytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+private:
+    bool Reserve_(size_t bytes); // 计入文件大小，超过上限时返回false
+    void Append_(uint32_t conn, capture::Type type, const char* data, size_t len);
+
+    double sampleRate_;
+    uint64_t maxBytes_;
+    uint64_t startNs_; // CheapClock
+    std::atomic<uint64_t> connSeq_;
+    std::atomic<uint32_t> nextId_;
+    std::atomic<uint64_t> bytes_;
+    std::atomic<bool> full_;
+    AsyncLogAppender appender_;
+};
+
+#endif // TRAFFIC_CAPTURE_H
@@ -0,0 +1,30 @@
+#ifndef HEAP_SIZE_H
+#define HEAP_SIZE_H
+
+#include <string>
+#include <unordered_map>
+
+// 估算字符串和哈希表在堆上占用的字节数，只用于内存统计。按libstdc++的布局：
+// 不超过15个字符的字符串存放在对象内部；哈希表有一个桶数组（只有一个桶时不分配），
+// 每个元素一个节点：next指针、键值对，键是字符串时还缓存了哈希值
+namespace heapsize {
+inline size_t Of(const std::string& s) {
+    return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+template <typename T>
+inline size_t Of(const T&) {
+    return 0;
+}
+
+template <typename K, typename V>
+size_t Of(const std::unordered_map<K, V>& m) {
+    size_t bytes = m.bucket_count() > 1 ? m.bucket_count() * sizeof(void*) : 0;
+    for(const auto& kv : m) {
+        bytes += sizeof(void*) + sizeof(kv) + sizeof(size_t) + Of(kv.first) + Of(kv.second);
+    }
+    return bytes;
+}
+}
+
+#endif // HEAP_SIZE_H
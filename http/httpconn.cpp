@@ -5,15 +5,34 @@ using namespace std;
 bool HttpConn::isET;
 const char* HttpConn::srcDir; 
 std::atomic<int> HttpConn::userCount;
+AccessLog* HttpConn::accessLog = nullptr;
+SlowLog* HttpConn::slowLog = nullptr;
+TrafficCapture* HttpConn::capture = nullptr;
 
 HttpConn::HttpConn() { 
     fd_ = -1;
     addr_ = { 0 };
+    worker_ = 0;
+    parseOk_ = false;
     isClose_ = true; //关闭
+    reqStartNs_ = reqWallNs_ = parseNs_ = respondNs_ = acceptNs_ = 0;
+    bytesSent_ = 0;
+    bytesIn_ = bytesOut_ = 0;
+    responding_ = false;
+    iov_[0].iov_len = iov_[1].iov_len = 0;
+    iovCnt_ = 0;
+    fileOffset_ = 0;
+    fileLeft_ = 0;
+    heapBytes_ = 0;
+    captureId_ = 0;
+    Metrics::Add(Gauge::CONN_OBJECTS, 1);
+    AccountHeap_();
 }
 
 HttpConn::~HttpConn() { 
     Close(); 
+    Metrics::Add(Gauge::CONN_OBJECTS, -1);
+    Metrics::Add(Gauge::CONN_HEAP_BYTES, -static_cast<int64_t>(heapBytes_));
 }
 
 void HttpConn::init(int fd, const sockaddr_in& addr) {
@@ -24,30 +43,91 @@ void HttpConn::init(int fd, const sockaddr_in& addr) {
     writeBuff_.RetrieveAll(); //重置写缓冲区，初始化读写位置
     readBuff_.RetrieveAll(); //重置读缓冲区，初始化读写位置
     isClose_ = false; 
-    cout<<"Client:"<<fd_<< GetIP()<<" : "<<GetPort()<<"joined, userCount："<<(int)userCount<<endl;
+    reqStartNs_ = 0;
+    bytesIn_ = bytesOut_ = 0;
+    iov_[0].iov_len = iov_[1].iov_len = 0;
+    fileLeft_ = 0;
+    acceptNs_ = NowNs_();
+    responding_ = false;
+    if(slowLog && !trace_) {
+        trace_.reset(new ReqTrace());
+        AccountHeap_();
+    }
+    if(trace_) { trace_->Reset(); }
+    captureId_ = capture ? capture->Open() : 0;
+    Metrics::Add(Counter::ACCEPTS);
+    Metrics::Add(Gauge::ACTIVE_CONNS, 1);
+    LOG_DEBUG("Client:%d %s:%d joined, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
 }
 
 ssize_t HttpConn::read(int* saveErrno){
     ssize_t len = -1;
+    bool empty = readBuff_.ReadableBytes() == 0;
     do {
         len = readBuff_.ReadFd(fd_, saveErrno);
         if (len <= 0) {
+            if(len < 0 && *saveErrno == EAGAIN) { Trace(TraceEvent::READ_EAGAIN, readBuff_.ReadableBytes()); }
+            else { Trace(TraceEvent::READ, len); }
             break;
         }
+        Trace(TraceEvent::READ, len);
+        if(captureId_) { //新读到的数据在可读区域的末尾
+            capture->Data(captureId_, readBuff_.Peek() + readBuff_.ReadableBytes() - len, len);
+        }
+        Metrics::Add(Counter::BYTES_IN, len);
+        bytesIn_ += len;
     } while (isET);
+    if(empty && readBuff_.ReadableBytes() > 0) {
+        MarkRequestStart_(); //新请求的第一个字节
+        if(acceptNs_) {
+            Histograms::Record(Stage::FIRST_BYTE, reqStartNs_ - acceptNs_);
+            acceptNs_ = 0;
+        }
+    }
     return len; 
 }
 
 ssize_t HttpConn::write(int* saveErrno){
     ssize_t len = -1;
     do {
-        len = writev(fd_, iov_, iovCnt_);  //集中写 //文件描述符 内存块 内存块数量
+        if(iov_[0].iov_len + iov_[1].iov_len == 0 && fileLeft_ > 0) {
+            /* sendfile模式：响应头已经写完，文件由内核直接发送 */
+            len = sendfile(fd_, response_.FileFd(), &fileOffset_, fileLeft_);
+            if(len < 0) {
+                *saveErrno = errno;
+                break;
+            }
+            if(len == 0) { /* 文件在发送过程中被截短，剩下的字节永远发不出去 */
+                *saveErrno = EIO;
+                len = -1;
+                break;
+            }
+            Trace(TraceEvent::WRITE, len);
+            bytesSent_ += len;
+            bytesOut_ += len;
+            Metrics::Add(Counter::BYTES_OUT, len);
+            fileLeft_ -= len;
+            if(fileLeft_ == 0) { break; } /* 传输结束，不再进行长度为0的写 */
+            continue;
+        }
+        if(fileLeft_ > 0) {
+            /* 后面还有sendfile：响应头带MSG_MORE，和文件的开头合并成同一个报文，否则小响应头单独发出后Nagle要等对端的延迟ACK（约40ms） */
+            msghdr msg = {};
+            msg.msg_iov = iov_;
+            msg.msg_iovlen = iovCnt_;
+            len = sendmsg(fd_, &msg, MSG_MORE);
+        } else {
+            len = writev(fd_, iov_, iovCnt_);  //集中写 //文件描述符 内存块 内存块数量
+        }
         if(len <= 0) {
             *saveErrno = errno;
             break;
         }
-        if(iov_[0].iov_len + iov_[1].iov_len  == 0) { break; } /* 传输结束 */
-        else if(static_cast<size_t>(len) > iov_[0].iov_len) { 
+        Trace(TraceEvent::WRITE, len);
+        bytesSent_ += len;
+        bytesOut_ += len;
+        Metrics::Add(Counter::BYTES_OUT, len);
+        if(static_cast<size_t>(len) > iov_[0].iov_len) { 
             iov_[1].iov_base = (uint8_t*) iov_[1].iov_base + (len - iov_[0].iov_len);
             iov_[1].iov_len -= (len - iov_[0].iov_len);
             if(iov_[0].iov_len) {
@@ -60,17 +140,35 @@ ssize_t HttpConn::write(int* saveErrno){
             iov_[0].iov_len -= len; 
             writeBuff_.Retrieve(len); 
         }
-    } while(isET || ToWriteBytes() > 10240); 
+        if(ToWriteBytes() == 0) { break; } /* 传输结束，不再进行长度为0的写 */
+    } while(isET || ToWriteBytes() > 10240 || (iov_[0].iov_len + iov_[1].iov_len == 0 && fileLeft_ > 0)); /* sendfile与writev一样，一次发完内核能接收的部分 */
+    if(len < 0 && *saveErrno == EAGAIN) {
+        Trace(TraceEvent::WRITE_EAGAIN, ToWriteBytes());
+    }
+    if(responding_ && ToWriteBytes() == 0) {
+        TRACE_PROBE(webserver, write_done, fd_, response_.Code(), bytesSent_);
+        Histograms::RecordSince(Stage::WRITE, respondNs_);
+        FinishRequest_(); //响应写完
+    }
     return len;
 }
 
 void HttpConn::Close() {
+    if(responding_ && isClose_ == false) {
+        FinishRequest_(); //响应没有写完连接就关闭了，记录已经发送的字节数
+    }
     response_.UnmapFile(); //解除内存映射
     if(isClose_ == false){
         isClose_ = true;
         userCount--; 
+        Metrics::Add(Counter::CLOSES);
+        Metrics::Add(Gauge::ACTIVE_CONNS, -1);
         close(fd_); //关闭文件描述符对应的连接
-        cout<<"Client:"<<fd_<<" "<< GetIP()<<": "<<GetPort()<<" quit, userCount:"<<(int)userCount<<endl;
+        if(captureId_) {
+            capture->Close(captureId_);
+            captureId_ = 0;
+        }
+        LOG_DEBUG("Client:%d %s:%d quit, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
     }
 }
 
@@ -92,26 +190,77 @@ struct sockaddr_in HttpConn::GetAddr() const {
 
 //响应的封装
 bool HttpConn::process(){
+    if(!ParseRequest()) {
+        return false;
+    }
+    MakeResponse();
+    return true;
+}
+
+bool HttpConn::ParseRequest(){
     request_.Init(); 
     if(readBuff_.ReadableBytes() <= 0) { 
         return false; 
     }
-    else if(request_.parse(readBuff_)) { //解析并封装响应
+    if(reqStartNs_ == 0) {
+        MarkRequestStart_(); //流水线中的后续请求，数据已经在缓冲区中
+    }
+    uint64_t begin = NowNs_();
+    parseOk_ = request_.parse(readBuff_); //解析请求
+    parseNs_ = NowNs_() - begin;
+    Trace(TraceEvent::PARSE, parseOk_);
+    Histograms::Record(Stage::PARSE, parseNs_);
+    return true;
+}
+
+//POST计算交给阻塞车道，其他请求在当前线程直接处理
+Lane HttpConn::HandlerLane() const {
+    if(parseOk_ && request_.method() == "POST") {
+        return Lane::BLOCKING;
+    }
+    return Lane::REQUEST;
+}
+
+void HttpConn::MakeResponse(int code){
+    uint64_t begin = NowNs_();
+    if(code != -1) {
+        response_.Init(srcDir, request_.path(), request_.Post_(), false, code);
+    }
+    else if(parseOk_ && request_.path() == "/metrics") {
+        //指标在抓取时才汇总
+        response_.Init(srcDir, request_.path(), request_.Post_(), request_.IsKeepAlive(), 200);
+        response_.MakeGenerated(writeBuff_, "text/plain; version=0.0.4", Metrics::RenderPrometheus());
+        FinishMakeResponse_(begin);
+        return;
+    }
+    else if(parseOk_) {
         //cout<<"request_.path():"<<request_.path().c_str()<<endl;
         //封装响应
         response_.Init(srcDir, request_.path(), request_.Post_(), request_.IsKeepAlive(), 200); //解析成功 开始封装响应
+        response_.SetRange(request_.GetHeader("Range"));
     } 
     else { //返回错误页面
         response_.Init(srcDir, request_.path(), request_.Post_(), false, 400);
     }
 
     response_.MakeResponse(writeBuff_); //响应保存在writeBuff_里面
-    
+    FinishMakeResponse_(begin);
+}
+
+void HttpConn::FinishMakeResponse_(uint64_t buildStartNs) {
+    respondNs_ = NowNs_();
+    Histograms::Record(Stage::BUILD, respondNs_ - buildStartNs);
+    bytesSent_ = 0;
+    responding_ = true;
+    Trace(TraceEvent::BUILD, response_.Code());
+
     /* 响应头 */ //集中写
     iov_[0].iov_base = const_cast<char*>(writeBuff_.Peek()); 
     iov_[0].iov_len = writeBuff_.ReadableBytes(); 
     //cout<<"iov_[0].iov_len "<<iov_[0].iov_len<<endl;
     iovCnt_ = 1;
+    iov_[1].iov_len = 0;
+    fileLeft_ = 0;
 
     /* 文件 */
     if(response_.FileLen() > 0  && response_.File()) {
@@ -119,7 +268,65 @@ bool HttpConn::process(){
         iov_[1].iov_len = response_.FileLen(); //响应体的文件长度
         iovCnt_ = 2; //内存块大小
     }
+    else if(response_.FileLen() > 0 && response_.FileFd() >= 0) {
+        fileOffset_ = response_.FileOffset();
+        fileLeft_ = response_.FileLen();
+    }
+    TRACE_PROBE(webserver, response_ready, fd_, response_.Code(), request_.path().size(), iov_[0].iov_len, response_.FileLen());
     //cout<<"filesize: "<<response_.FileLen()<<","<<iovCnt_<<" to "<<ToWriteBytes()<<endl;
-    return true;
 }
 
+void HttpConn::MarkRequestStart_() {
+    reqStartNs_ = NowNs_();
+    reqWallNs_ = std::chrono::system_clock::now().time_since_epoch().count();
+}
+
+//一个请求结束（响应写完或者连接关闭），下一个请求重新计时
+void HttpConn::FinishRequest_() {
+    responding_ = false;
+    Metrics::AddRequest(response_.Code());
+    uint64_t now = NowNs_();
+    uint64_t requestNs = reqStartNs_ ? now - reqStartNs_ : 0;
+    bool slow = false;
+    if(trace_) {
+        trace_->Record(TraceEvent::DONE, ToWriteBytes() == 0);
+        slow = reqStartNs_ && requestNs >= slowLog->ThresholdNs();
+    }
+    if(accessLog || slow) {
+        char remote[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr_.sin_addr, remote, sizeof(remote)); //inet_ntoa的静态缓冲区不能在多个工作线程中使用
+        std::string method = request_.method();
+        std::string version = request_.version();
+        AccessRecord record;
+        record.remote = remote;
+        record.time = reqWallNs_;
+        record.method = &method;
+        record.target = &request_.target();
+        record.version = &version;
+        record.referer = &request_.GetHeader("Referer");
+        record.userAgent = &request_.GetHeader("User-Agent");
+        record.status = response_.Code();
+        record.bytes = bytesSent_;
+        record.keepAlive = request_.IsKeepAlive();
+        record.requestNs = requestNs;
+        record.parseNs = parseNs_;
+        record.writeNs = now - respondNs_;
+        if(accessLog) { accessLog->Log(record); }
+        if(slow) {
+            Metrics::Add(Counter::SLOW_REQUESTS);
+            slowLog->Log(record, fd_, reqStartNs_, *trace_);
+        }
+    }
+    if(trace_) { trace_->Reset(); }
+    reqStartNs_ = 0;
+    AccountHeap_();
+}
+
+//每个请求结束时估算一次：空闲的长连接保留的是最后一个请求的头部
+void HttpConn::AccountHeap_() {
+    size_t bytes = request_.HeapBytes() + response_.HeapBytes() + (trace_ ? sizeof(ReqTrace) : 0);
+    if(bytes != heapBytes_) {
+        Metrics::Add(Gauge::CONN_HEAP_BYTES, static_cast<int64_t>(bytes) - static_cast<int64_t>(heapBytes_));
+        heapBytes_ = bytes;
+    }
+}
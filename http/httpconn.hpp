@@ -3,6 +3,7 @@
 
 #include <sys/types.h>
 #include <sys/uio.h>     // readv/writev
+#include <sys/sendfile.h> // sendfile
 #include <arpa/inet.h>   // sockaddr_in
 #include <stdlib.h>      
 #include <errno.h>  
@@ -10,6 +11,13 @@
 #include "../buffer/buffer.hpp"
 #include "httprequest.hpp"
 #include "httpresponse.hpp"
+#include "accesslog.hpp"
+#include "slowlog.hpp"
+#include "capture.hpp"
+#include <memory>
+#include "../metrics/metrics.hpp"
+#include "../metrics/histogram.hpp"
+#include "../threadpool/executor.hpp"
 
 class HttpConn {
 public:
@@ -32,36 +40,88 @@ public:
     int GetPort() const;
    
     sockaddr_in GetAddr() const;
+
+    // 连接亲和模式下分配给该连接的工作线程
+    void SetWorker(int worker) { worker_ = worker; }
+    int GetWorker() const { return worker_; }
     
     bool process();
 
+    // process()拆成两步，中间可以把请求交给其他车道处理
+    // 解析请求，缓冲区中没有数据时返回false
+    bool ParseRequest();
+    // 生成响应，code为-1时根据解析结果决定状态码
+    void MakeResponse(int code = -1);
+    // 处理当前请求应该使用的车道
+    Lane HandlerLane() const;
+
     int ToWriteBytes() { 
-        return iov_[0].iov_len + iov_[1].iov_len; 
+        return iov_[0].iov_len + iov_[1].iov_len + fileLeft_; 
     }
 
     bool IsKeepAlive() const {
         return request_.IsKeepAlive();
     }
 
+    // 记录当前请求的生命周期事件，只有启用慢请求日志时才有事件环
+    void Trace(TraceEvent event, int64_t value = 0) {
+        if(trace_) { trace_->Record(event, value); }
+    }
+
+    // 连接建立以来收发的字节数
+    uint64_t BytesIn() const { return bytesIn_; }
+    uint64_t BytesOut() const { return bytesOut_; }
+
+    // 连接对象本身的大小，缓冲区和请求/响应的堆内存另外计入Gauge::BUFFER_BYTES和Gauge::CONN_HEAP_BYTES
+    static constexpr size_t ObjectBytes() { return sizeof(HttpConn); }
+
     static bool isET;
     static const char* srcDir; 
     static std::atomic<int> userCount; 
+    static AccessLog* accessLog; // 为空时不记录访问日志
+    static SlowLog* slowLog;     // 为空时不记录慢请求，也不分配事件环
+    static TrafficCapture* capture; // 为空时不捕获流量
     
 private:
    
     int fd_;
     struct sockaddr_in addr_;
+    int worker_;
 
     bool isClose_; 
     
     int iovCnt_;
     struct iovec iov_[2]; //定义了一个向量元素  分散的内存    用于存放响应数据
+    off_t fileOffset_;    // sendfile模式：下一个要发送的文件偏移
+    size_t fileLeft_;     // sendfile模式：文件中还没有发送的字节数
     
     Buffer readBuff_; // 读（请求）缓冲区 
     Buffer writeBuff_; // 写（响应）缓冲区 
 
     HttpRequest request_; 
     HttpResponse response_; 
+    bool parseOk_; // 请求是否解析成功
+
+    // 当前请求的计时（CheapClock纳秒），用于访问日志和各阶段的延迟直方图
+    static uint64_t NowNs_() { return CheapClock::NowNs(); }
+    void MarkRequestStart_();
+    void FinishMakeResponse_(uint64_t buildStartNs); // 响应头（和文件）放进iov_，开始计时
+    void FinishRequest_();
+    uint64_t acceptNs_;    // 接受连接的时间，读到第一个字节之后清0
+    uint64_t reqStartNs_;  // 收到请求第一个字节的时间，0表示还没有收到
+    uint64_t reqWallNs_;   // 同一时刻的墙上时间
+    uint64_t parseNs_;     // 解析耗时
+    uint64_t respondNs_;   // 生成响应的时间
+    size_t bytesSent_;     // 当前响应已经发送的字节数
+    uint64_t bytesIn_;     // 连接累计读到的字节数
+    uint64_t bytesOut_;    // 连接累计发送的字节数
+    bool responding_;      // 有已经生成、还没有记录访问日志的响应
+
+    uint32_t captureId_; // 捕获文件中的连接编号，0表示该连接没有被抽中
+    std::unique_ptr<ReqTrace> trace_; // 当前请求的事件环，连接对象复用时保留
+
+    void AccountHeap_();   // 请求/响应的堆内存变化计入Gauge::CONN_HEAP_BYTES
+    size_t heapBytes_;     // 上次计入的值
 };
 
 
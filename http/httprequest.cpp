@@ -5,7 +5,7 @@ const std::unordered_set<std::string> HttpRequest::DEFAULT_HTML{
 };
 
 void HttpRequest::Init() {
-    method_ = path_ = version_ = body_ = "";
+    method_ = path_ = version_ = body_ = target_ = "";
     state_ = REQUEST_LINE;
     header_.clear();
     post_.clear();
@@ -16,6 +16,8 @@ bool HttpRequest::parse(Buffer& buff) {
     if(buff.ReadableBytes() <= 0) {
         return false;
     }
+    size_t readable = buff.ReadableBytes();
+    TRACE_PROBE(webserver, parse_start, readable);
     while(buff.ReadableBytes() && state_ != FINISH) {
         //获取一行数据，根据\r\n为结束标志
         const char* lineEnd = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
@@ -26,6 +28,7 @@ bool HttpRequest::parse(Buffer& buff) {
         {
         case REQUEST_LINE:
             if(!ParseRequestLine_(line)) {
+                TRACE_PROBE(webserver, parse_end, false, readable - buff.ReadableBytes(), path_.size(), static_cast<int>(state_));
                 return false;
             }
             ParsePath_(); // 解析URL中的文件路径
@@ -46,7 +49,8 @@ bool HttpRequest::parse(Buffer& buff) {
         buff.RetrieveUntil(lineEnd + 2);  //移动缓冲区的读指针
     }
 
-    std::cout<<"解析结果  method_:"<<method_.c_str()<<" path_:"<< path_.c_str()<<" version_:"<< version_.c_str()<<std::endl;
+    LOG_DEBUG("解析结果  method_:%s path_:%s version_:%s", method_.c_str(), path_.c_str(), version_.c_str());
+    TRACE_PROBE(webserver, parse_end, true, readable - buff.ReadableBytes(), path_.size(), static_cast<int>(state_));
     return true;
 }
 
@@ -66,6 +70,12 @@ std::string HttpRequest::version() const {
     return version_;
 }
 
+const std::string& HttpRequest::GetHeader(const std::string& key) const {
+    static const std::string empty;
+    auto it = header_.find(key);
+    return it == header_.end() ? empty : it->second;
+}
+
 //是否保持 长连接
 bool HttpRequest::IsKeepAlive() const {
     if(header_.count("Connection") == 1) {
@@ -81,11 +91,12 @@ bool HttpRequest::ParseRequestLine_(const std::string& line) {
     if(std::regex_match(line, subMatch, patten)) {  //匹配成功就保存在subMatch里面
         method_ = subMatch[1]; // GET        //match[1]将包含使用第一个捕获组(第一个括号括起的模式部分)捕获的文本等
         path_ = subMatch[2]; //  /请求路径    //同理
+        target_ = path_;
         version_ = subMatch[3]; // 1.1       //同理
         state_ = HEADERS; //状态改变 解析头
         return true;
     }
-    std::cout<<"RequestLine Error"<<std::endl;
+    LOG_WARN("RequestLine Error");
     return false;
 }
 
@@ -106,7 +117,7 @@ void HttpRequest::ParseBody_(const std::string& line) {
     body_ = line;
     ParsePost_();
     state_ = FINISH;
-    std::cout<<"Body:"<<line.c_str()<<" len:"<<line.size()<<std::endl;
+    LOG_DEBUG("Body:%s len:%zu", line.c_str(), line.size());
 }
 
 void HttpRequest::ParsePath_() {
@@ -125,7 +136,7 @@ void HttpRequest::ParsePath_() {
 
 void HttpRequest::ParsePost_(){
     if(method_ == "POST" /*&& header_["Content-Type"] == "application/x-www-form-urlencoded"*/) {
-        std::cout<<"解析POST请求"<<std::endl;
+        LOG_DEBUG("解析POST请求");
         ParseFromUrlencoded_();
         //int len = std::stoi(header_["Content-Length"]);
         //cout<<len<<endl;
@@ -8,6 +8,9 @@
 #include <errno.h>
 
 #include "../buffer/buffer.hpp"
+#include "../log/log.hpp"
+#include "heapsize.hpp"
+#include "../metrics/usdt.hpp"
 
 class HttpRequest
 {
@@ -45,13 +48,23 @@ public:
     // 获取请求URL
     std::string path() const;
     std::string &path();
+    // 请求行中的原始URL（path()是映射之后的文件路径）
+    const std::string &target() const { return target_; }
     // 获取http版本号
     std::string version() const;
+    // 请求头部字段，不存在时返回空字符串
+    const std::string &GetHeader(const std::string &key) const;
     // 是否保持长连接
     bool IsKeepAlive() const;
 
     std::unordered_map<std::string, int> Post_();
 
+    // 请求行、头部和表单在堆上占用的字节数（估算），Init()之后头部的桶数组仍然保留
+    size_t HeapBytes() const {
+        return heapsize::Of(method_) + heapsize::Of(path_) + heapsize::Of(version_) + heapsize::Of(body_) +
+               heapsize::Of(target_) + heapsize::Of(header_) + heapsize::Of(post_);
+    }
+
 private:
     // 解析请求行
     bool ParseRequestLine_(const std::string &line);
@@ -67,6 +80,7 @@ private:
 
     PARSE_STATE state_;
     std::string method_, path_, version_, body_;          // 请求方法、URL、版本号、消息体
+    std::string target_;                                  // 原始URL
     std::unordered_map<std::string, std::string> header_; // 请求头部字段
     std::unordered_map<std::string, int> post_;           // post请求表单数据
 
@@ -1,4 +1,6 @@
 #include "httpresponse.hpp"
+#include <errno.h>
+#include <stdlib.h>
 
 using namespace std;
 
@@ -24,17 +26,22 @@ const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
     { ".js",    "text/javascript "}
 };
 
+bool HttpResponse::useSendfile = false;
+
 const unordered_map<int, string> HttpResponse::CODE_STATUS = {
     { 200, "OK" },          //成功处理请求
+    { 206, "Partial Content" }, //Range请求
     { 400, "Bad Request" }, //无法理解客户端请求
     { 403, "Forbidden" },   //没有权限
-    { 404, "Not Found" }    //为找到请求的资源
+    { 404, "Not Found" },   //为找到请求的资源
+    { 503, "Service Unavailable" } //服务器过载
 };
 
 const unordered_map<int, string> HttpResponse::CODE_PATH = {
     { 400, "/error.html" },
     { 403, "/error.html" },
-    { 404, "/error.html" }
+    { 404, "/error.html" },
+    { 503, "/error.html" }
 };
 
 
@@ -44,6 +51,9 @@ HttpResponse::HttpResponse() {
     isKeepAlive_ = false;
     mmFile_ = nullptr; 
     mmFileStat_ = { 0 };
+    fileFd_ = -1;
+    bodyOffset_ = 0;
+    bodyLen_ = 0;
 }
 
 HttpResponse::~HttpResponse() {
@@ -52,7 +62,7 @@ HttpResponse::~HttpResponse() {
 
 void HttpResponse::Init(const string& srcDir, string& path, std::unordered_map<std::string, int> post_, bool isKeepAlive, int code){
     assert(srcDir != "");
-    if(mmFile_) { UnmapFile(); }  //解除内存映射
+    UnmapFile();  //解除内存映射，关闭上一个响应的文件
 
     code_ = code; //响应状态码
     isKeepAlive_ = isKeepAlive;
@@ -60,6 +70,9 @@ void HttpResponse::Init(const string& srcDir, string& path, std::unordered_map<s
     srcDir_ = srcDir; //当前的工作路径
     mmFile_ = nullptr; 
     mmFileStat_ = { 0 };
+    range_.clear();
+    bodyOffset_ = 0;
+    bodyLen_ = 0;
     post__ = post_;
 }
 
@@ -80,11 +93,26 @@ void HttpResponse::MakeResponse(Buffer& buff) {
     else if(code_ == -1) { //默认是-1
         code_ = 200; 
     }
+    if(code_ == 200 && !range_.empty() && ParseRange_(mmFileStat_.st_size)) {
+        code_ = 206;
+    }
     ErrorHtml_();  //封装错误状态显示
     AddStateLine_(buff); 
     AddHeader_(buff); 
     AddContent_(buff); 
-    cout<<"封装响应完成！"<<endl;
+    LOG_DEBUG("封装响应完成！");
+}
+
+void HttpResponse::MakeGenerated(Buffer& buff, const string& contentType, const string& body) {
+    if(code_ == -1) {
+        code_ = 200;
+    }
+    AddStateLine_(buff);
+    buff.Append("Connection: ");
+    buff.Append(isKeepAlive_ ? "keep-alive\r\n" : "close\r\n");
+    buff.Append("Content-type: " + contentType + "\r\n");
+    buff.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
+    buff.Append(body);
 }
 
 void HttpResponse::UnmapFile() {  
@@ -92,14 +120,62 @@ void HttpResponse::UnmapFile() {
         munmap(mmFile_, mmFileStat_.st_size);  //解除响应文件的内存映射
         mmFile_ = nullptr;
     }
+    if(fileFd_ >= 0) {
+        close(fileFd_);
+        fileFd_ = -1;
+    }
 }
 
 char* HttpResponse::File() {
-    return mmFile_;
+    return mmFile_ ? mmFile_ + bodyOffset_ : nullptr;
 }
 
 size_t HttpResponse::FileLen() const {
-    return mmFileStat_.st_size;
+    return bodyLen_;
+}
+
+//Range中的一个十进制数，只允许数字，超出unsigned long long（ERANGE）时返回false
+static bool ParseRangeNumber(const string& str, unsigned long long& value) {
+    if(str.empty() || str.find_first_not_of("0123456789") != string::npos) {
+        return false;
+    }
+    errno = 0;
+    value = strtoull(str.c_str(), nullptr, 10);
+    return errno != ERANGE;
+}
+
+//Range: bytes=a-b / bytes=a- / bytes=-n，多个范围和超出文件的范围都不支持，返回false时发送整个文件
+bool HttpResponse::ParseRange_(size_t fileSize) {
+    if(range_.compare(0, 6, "bytes=") != 0 || range_.find(',') != string::npos || fileSize == 0) {
+        return false;
+    }
+    size_t dash = range_.find('-', 6);
+    if(dash == string::npos) {
+        return false;
+    }
+    string first = range_.substr(6, dash - 6);
+    string last = range_.substr(dash + 1);
+    unsigned long long a = 0, b = 0;
+    if((!first.empty() && !ParseRangeNumber(first, a)) || (!last.empty() && !ParseRangeNumber(last, b))) {
+        return false; //不是数字或者溢出：忽略Range，不能抛出异常（线程池的任务中没有捕获）
+    }
+    size_t start, end;
+    if(first.empty()) { //最后n个字节
+        if(last.empty()) { return false; }
+        size_t n = std::min<unsigned long long>(b, fileSize);
+        start = fileSize - n;
+        end = fileSize - 1;
+    } else {
+        if(a >= fileSize) { return false; }
+        start = a;
+        end = last.empty() ? fileSize - 1 : std::min<unsigned long long>(b, fileSize - 1);
+    }
+    if(start >= fileSize || start > end) {
+        return false;
+    }
+    bodyOffset_ = start;
+    bodyLen_ = end - start + 1;
+    return true;
 }
 
 void HttpResponse::ErrorContent(Buffer& buff, string message) 
@@ -161,19 +237,33 @@ void HttpResponse::AddContent_(Buffer& buff) {
         return;
     }
 
-    /* 将文件映射到进程的虚拟地址空间，提高文件的访问速度 
-        MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
     //LOG_DEBUG("file path %s", (srcDir_ + path_).data());
-    cout<<"file path "<<(srcDir_ + path_).data()<<endl;
-    void* mmRet =mmap(nullptr, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0); //mmap将一个文件或对象映射到进程的虚拟地址空间
-    if(mmRet == MAP_FAILED) {
-        ErrorContent(buff, "File NotFound!");
-        return; 
+    LOG_DEBUG("file path %s", (srcDir_ + path_).data());
+    if(code_ != 206) {
+        bodyOffset_ = 0;
+        bodyLen_ = mmFileStat_.st_size;
+    }
+    if(useSendfile) {
+        fileFd_ = srcFd; //写完响应头之后由内核从页缓存直接发送，不经过用户态
+    } else {
+        /* 将文件映射到进程的虚拟地址空间，提高文件的访问速度 
+            MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
+        void* mmRet =mmap(nullptr, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0); //mmap将一个文件或对象映射到进程的虚拟地址空间
+        close(srcFd);
+        if(mmRet == MAP_FAILED) {
+            bodyLen_ = 0;
+            ErrorContent(buff, "File NotFound!");
+            return; 
+        }
+        mmFile_ = (char*)mmRet; //指针,映射区域的起始地址
     }
-    mmFile_ = (char*)mmRet; //指针,映射区域的起始地址
 
-    close(srcFd);
-    buff.Append("Content-length: " + to_string(mmFileStat_.st_size) + "\r\n\r\n"); //响应的数据长度大小
+    buff.Append("Accept-Ranges: bytes\r\n");
+    if(code_ == 206) {
+        buff.Append("Content-Range: bytes " + to_string(bodyOffset_) + "-" + to_string(bodyOffset_ + bodyLen_ - 1) +
+                    "/" + to_string(mmFileStat_.st_size) + "\r\n");
+    }
+    buff.Append("Content-length: " + to_string(bodyLen_) + "\r\n\r\n"); //响应的数据长度大小
 }
 
 void HttpResponse::ErrorHtml_() {
@@ -8,6 +8,8 @@
 #include <sys/mman.h> // mmap, munmap
 
 #include "../buffer/buffer.hpp"
+#include "../log/log.hpp"
+#include "heapsize.hpp"
 
 class HttpResponse
 {
@@ -17,13 +19,27 @@ public:
 
     void Init(const std::string &srcDir, std::string &path, std::unordered_map<std::string, int> post_, bool isKeepAlive = false, int code = -1);
     void MakeResponse(Buffer &buff);
-    // 解除内存映射
+    // 请求头中的Range（只支持单个范围 bytes=a-b、a-、-n），无效时忽略，返回整个文件
+    void SetRange(const std::string &range) { range_ = range; }
+    // 由程序生成的响应（如/metrics），body直接写在响应头后面，不映射文件
+    void MakeGenerated(Buffer &buff, const std::string &contentType, const std::string &body);
+    // 解除内存映射，关闭sendfile模式下打开的文件
     void UnmapFile();
-    // 获得文件映射指针(指向起始位置)
+    // 获得文件映射指针(指向响应体的起始位置)，sendfile模式下为空
     char *File();
+    // 响应体在文件中的长度和偏移（Range请求时是文件的一部分）
     size_t FileLen() const;
+    off_t FileOffset() const { return bodyOffset_; }
+    // sendfile模式下响应体所在的文件，-1表示没有
+    int FileFd() const { return fileFd_; }
     void ErrorContent(Buffer &buff, std::string message);
     int Code() const { return code_; }
+    // 路径、Range和表单在堆上占用的字节数（估算）
+    size_t HeapBytes() const {
+        return heapsize::Of(path_) + heapsize::Of(srcDir_) + heapsize::Of(range_) + heapsize::Of(post__);
+    }
+
+    static bool useSendfile; // 文件用sendfile发送，不映射到进程地址空间
 
     void AddPostContent_(Buffer &buff);
 
@@ -36,6 +52,7 @@ private:
     void AddContent_(Buffer &buff);
 
     void ErrorHtml_();
+    bool ParseRange_(size_t fileSize);
     // 获取文件类型
     std::string GetFileType_();
 
@@ -47,6 +64,10 @@ private:
 
     char *mmFile_;           // 文件内存映射的指针，文件映射到进程地址空间的起始地址
     struct stat mmFileStat_; // 文件的元数据(文件的状态信息)
+    int fileFd_;             // sendfile模式下打开的文件
+    std::string range_;      // 请求的Range
+    off_t bodyOffset_;       // 响应体在文件中的偏移
+    size_t bodyLen_;         // 响应体的长度，0表示没有文件作为响应体
 
     std::unordered_map<std::string, int> post__; // post请求表单数据
 
@@ -0,0 +1,72 @@
+#ifndef REQ_TRACE_H
+#define REQ_TRACE_H
+
+#include <cstdint>
+
+#include "../metrics/clock.hpp"
+
+// 请求生命周期中的事件，值的含义见注释
+enum class TraceEvent : uint8_t {
+    ENQUEUE,      // 读/写事件提交到线程池：车道
+    DEQUEUE,      // 工作线程开始处理：车道
+    READ,         // 读到数据：字节数（0表示对端关闭）
+    READ_EAGAIN,  // 读到EAGAIN：缓冲区中还没有解析的字节数
+    PARSE,        // 解析完成：1成功，0失败
+    BUILD,        // 生成响应：状态码
+    WRITE,        // 一次writev/sendmsg/sendfile：字节数
+    WRITE_EAGAIN, // 发送缓冲区满：还没有发送的字节数
+    DONE,         // 请求结束：1响应写完，0连接提前关闭
+    COUNT
+};
+
+// 一个连接的事件环：每个事件只写一次时钟和两个字段，不加锁、不分配内存；
+// 连接同一时刻只由一个线程处理（EPOLLONESHOT，交接经过线程池队列），所以不需要原子操作。
+// 每个请求结束时清空，超过CAPACITY个事件时覆盖最早的
+class ReqTrace {
+public:
+    static const uint32_t CAPACITY = 64; // 2的幂
+
+    struct Entry {
+        uint64_t ns;    // CheapClock::NowNs()
+        int64_t value;
+        TraceEvent event;
+    };
+
+    ReqTrace() : count_(0) {}
+
+    void Record(TraceEvent event, int64_t value) {
+        Entry& entry = entries_[count_++ & (CAPACITY - 1)];
+        entry.ns = CheapClock::NowNs();
+        entry.value = value;
+        entry.event = event;
+    }
+
+    void Reset() { count_ = 0; }
+
+    // 请求开始以来记录的事件数，可能超过CAPACITY
+    uint32_t Count() const { return count_; }
+    // 被覆盖的事件数
+    uint32_t Dropped() const { return count_ > CAPACITY ? count_ - CAPACITY : 0; }
+
+    // 从最早到最新遍历环中的事件
+    template <typename F>
+    void ForEach(F f) const {
+        for(uint32_t i = Dropped(); i < count_; i++) {
+            f(entries_[i & (CAPACITY - 1)]);
+        }
+    }
+
+    static const char* Name(TraceEvent event);
+
+private:
+    Entry entries_[CAPACITY];
+    uint32_t count_;
+};
+
+inline const char* ReqTrace::Name(TraceEvent event) {
+    static const char* const NAMES[] = {"enqueue", "dequeue", "read", "read_eagain", "parse",
+                                        "build", "write", "write_eagain", "done"};
+    return event < TraceEvent::COUNT ? NAMES[static_cast<int>(event)] : "?";
+}
+
+#endif // REQ_TRACE_H
@@ -0,0 +1,64 @@
+#include "slowlog.hpp"
+#include <stdio.h>
+#include <thread>
+
+namespace {
+const char* LaneName(int64_t lane) {
+    static const char* const NAMES[] = {"io", "request", "blocking"};
+    return lane >= 0 && lane < 3 ? NAMES[lane] : "?";
+}
+}
+
+SlowLog::SlowLog(const std::string& fileName, uint64_t thresholdNs, const LogFileOptions& fileOptions)
+    : thresholdNs_(thresholdNs),
+      appender_(fileName, 1024 * 1024, 4, LogOverflow::DROP, 1000, fileOptions),
+      timeFormatter_("%d{%Y-%m-%d %H:%M:%S.%6N}") {
+}
+
+SlowLog::~SlowLog() {
+    appender_.flush();
+}
+
+/*
+ * 2026-10-19 12:00:00.123456 slow 152.301ms fd=9 127.0.0.1 "GET /video/mp4.mp4 HTTP/1.1" 200 1048576 events=12
+ *       -8.1us enqueue      request
+ *       +0.0us read         512
+ *      +35.2us parse        1
+ *  ...
+ * 偏移相对于收到第一个字节的时间，之前的事件（读事件的排队）为负数；环被覆盖时首行带dropped=被丢弃的事件数
+ */
+void SlowLog::Log(const AccessRecord& record, int fd, uint64_t startNs, const ReqTrace& trace) {
+    thread_local std::string out;
+    out.clear();
+    timeFormatter_.format(out, LogLevel::WARN, LogEvent(nullptr, 0, std::thread::id(), std::string(), record.time));
+    char buf[160];
+    snprintf(buf, sizeof(buf), " slow %.3fms fd=%d %s \"", record.requestNs / 1e6, fd, record.remote);
+    out.append(buf);
+    if(record.method->empty()) {
+        out.append(1, '-'); //请求行解析失败
+    } else {
+        out.append(*record.method).append(1, ' ').append(*record.target).append(" HTTP/").append(*record.version);
+    }
+    snprintf(buf, sizeof(buf), "\" %d %zu events=%u", record.status, record.bytes, trace.Count());
+    out.append(buf);
+    if(trace.Dropped()) {
+        snprintf(buf, sizeof(buf), " dropped=%u", trace.Dropped());
+        out.append(buf);
+    }
+    out.append(1, '\n');
+    trace.ForEach([&](const ReqTrace::Entry& entry) {
+        double offsetUs = (static_cast<int64_t>(entry.ns) - static_cast<int64_t>(startNs)) / 1e3;
+        int n = snprintf(buf, sizeof(buf), "  %+12.1fus %-12s ", offsetUs, ReqTrace::Name(entry.event));
+        if(entry.event == TraceEvent::ENQUEUE || entry.event == TraceEvent::DEQUEUE) {
+            snprintf(buf + n, sizeof(buf) - n, "%s\n", LaneName(entry.value));
+        } else {
+            snprintf(buf + n, sizeof(buf) - n, "%lld\n", static_cast<long long>(entry.value));
+        }
+        out.append(buf);
+    });
+    appender_.append(out.data(), out.size());
+}
+
+void SlowLog::Flush() {
+    appender_.flush();
+}
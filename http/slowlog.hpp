@@ -0,0 +1,28 @@
+#ifndef SLOW_LOG_H
+#define SLOW_LOG_H
+
+#include <string>
+
+#include "accesslog.hpp"
+#include "reqtrace.hpp"
+
+// 慢请求日志：收到第一个字节到响应写完超过阈值的请求，把访问记录和连接事件环中的事件一起写出，
+// 其他请求不产生任何输出。慢请求很少，直接格式化后交给AsyncLogAppender（一次加锁），不再按线程攒批
+class SlowLog {
+public:
+    SlowLog(const std::string& fileName, uint64_t thresholdNs, const LogFileOptions& fileOptions = LogFileOptions());
+    ~SlowLog();
+
+    uint64_t ThresholdNs() const { return thresholdNs_; }
+
+    // startNs是请求开始时的CheapClock时间，事件按相对它的偏移输出
+    void Log(const AccessRecord& record, int fd, uint64_t startNs, const ReqTrace& trace);
+    void Flush();
+
+private:
+    uint64_t thresholdNs_;
+    AsyncLogAppender appender_;
+    LogFormatter timeFormatter_;
+};
+
+#endif // SLOW_LOG_H
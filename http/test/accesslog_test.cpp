@@ -0,0 +1,58 @@
+// AccessLog析构时写出所有线程的批量缓冲区：包括仍然存活的线程（这里是主线程）和已经退出的线程
+#include "../accesslog.hpp"
+#include "../../log/log.hpp"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+static int failures = 0;
+
+static size_t countLines(const char *fileName)
+{
+    std::ifstream in(fileName);
+    std::string line;
+    size_t n = 0;
+    while (std::getline(in, line))
+        n++;
+    return n;
+}
+
+static void logRequests(AccessLog &log, int count)
+{
+    std::string method = "GET", target = "/index.html", version = "1.1", referer, userAgent = "accesslog_test";
+    AccessRecord record = {"127.0.0.1", 0, &method, &target, &version, &referer, &userAgent, 200, 1024, true, 1000, 100, 100};
+    for (int i = 0; i < count; i++)
+        log.Log(record);
+}
+
+static void check(const char *name, AccessLog::Format format, int mainCount, int threadCount)
+{
+    const char *fileName = "/tmp/accesslog_test.log";
+    remove(fileName);
+    {
+        // 批量缓冲区和刷新间隔都足够大，只有析构时才会写出
+        AccessLog log(fileName, format, LogFileOptions(), 1024 * 1024, 60 * 1000);
+        logRequests(log, mainCount);
+        std::thread worker([&]() { logRequests(log, threadCount); });
+        worker.join();
+    }
+    size_t lines = countLines(fileName);
+    if (lines != static_cast<size_t>(mainCount + threadCount))
+    {
+        printf("FAIL %s: %zu lines, expected %d\n", name, lines, mainCount + threadCount);
+        failures++;
+    }
+}
+
+int main()
+{
+    Logger::root()->setLevel(LogLevel::INFO);
+    check("main thread only", AccessLog::COMBINED, 5, 0);
+    check("main and exited thread", AccessLog::COMBINED, 5, 7);
+    check("json", AccessLog::JSON, 3, 4);
+    if (failures)
+        return 1;
+    printf("accesslog_test passed\n");
+    return 0;
+}
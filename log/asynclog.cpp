@@ -0,0 +1,147 @@
+#include "asynclog.hpp"
+#include <algorithm>
+#include <string.h>
+
+AsyncLogAppender::AsyncLogAppender(const std::string &fileName, size_t bufferSize, size_t maxBuffers,
+                                   LogOverflow policy, int flushIntervalMs, const LogFileOptions &fileOptions)
+    : m_file(fileName, fileOptions), m_bufferSize(bufferSize), m_maxBuffers(std::max<size_t>(maxBuffers, 2)),
+      m_policy(policy), m_flushIntervalMs(flushIntervalMs), m_allocated(1), m_dropped(0), m_droppedTotal(0),
+      m_flushRequest(0), m_flushDone(0), m_running(true) {
+    m_current.reset(new LogBuffer(m_bufferSize));
+    m_thread = std::thread(&AsyncLogAppender::threadFunc, this);
+}
+
+AsyncLogAppender::~AsyncLogAppender() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_cond.notify_one();
+        m_freeCond.notify_all();
+    }
+    m_thread.join();
+}
+
+void AsyncLogAppender::log(LogLevel::Level level, LogEvent::ptr event) {
+    if (m_formatter) {
+        const std::string &line = formatLine(level, *event);
+        append(line.data(), line.size());
+    }
+}
+
+// 前端：缓冲区有空间时只是一次memcpy；写满时换一个空闲缓冲区并唤醒后台线程
+void AsyncLogAppender::append(const char *data, size_t len) {
+    len = std::min(len, m_bufferSize);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_current->avail() < len) {
+        BufferPtr next = takeFreeBuffer();
+        while (!next) {
+            if (m_policy == LogOverflow::DROP || !m_running) {
+                m_dropped++;
+                m_droppedTotal++;
+                m_cond.notify_one();
+                return;
+            }
+            m_cond.notify_one();
+            m_freeCond.wait(lock);
+            if (m_current->avail() >= len) {
+                break; // 等待期间后台线程已经换上了新的缓冲区
+            }
+            next = takeFreeBuffer();
+        }
+        if (next) {
+            m_full.push_back(std::move(m_current));
+            m_current = std::move(next);
+            m_cond.notify_one();
+        }
+    }
+    m_current->append(data, len);
+}
+
+AsyncLogAppender::BufferPtr AsyncLogAppender::takeFreeBuffer() {
+    if (!m_free.empty()) {
+        BufferPtr buffer = std::move(m_free.back());
+        m_free.pop_back();
+        return buffer;
+    }
+    if (m_allocated < m_maxBuffers) {
+        m_allocated++;
+        return BufferPtr(new LogBuffer(m_bufferSize));
+    }
+    return nullptr;
+}
+
+void AsyncLogAppender::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    uint64_t request = ++m_flushRequest;
+    m_cond.notify_one();
+    m_freeCond.wait(lock, [&]() { return m_flushDone >= request || !m_running; });
+}
+
+// 后台线程：每隔m_flushIntervalMs或者有缓冲区写满时，取走所有待写的缓冲区，在锁外批量写出
+void AsyncLogAppender::threadFunc() {
+    std::vector<BufferPtr> toWrite;
+    bool running = true;
+    while (running) {
+        uint64_t dropped;
+        uint64_t flushRequest;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait_for(lock, std::chrono::milliseconds(m_flushIntervalMs), [this]() {
+                return !m_full.empty() || m_flushRequest > m_flushDone || !m_running;
+            });
+            running = m_running;
+            // 当前缓冲区也一起写出；缓冲区全部用完时留到下一轮，这一轮写完就有空闲缓冲区了
+            bool drained = m_current->size() == 0;
+            if (!drained) {
+                BufferPtr next = takeFreeBuffer();
+                if (next) {
+                    m_full.push_back(std::move(m_current));
+                    m_current = std::move(next);
+                    drained = true;
+                }
+            }
+            for (auto &buffer : m_full) {
+                toWrite.push_back(std::move(buffer));
+            }
+            m_full.clear();
+            dropped = m_dropped;
+            m_dropped = 0;
+            // 当前缓冲区没有写出时不算完成flush，下一轮马上再写
+            flushRequest = drained ? m_flushRequest : m_flushDone;
+            if (!drained) {
+                running = true;
+            }
+        }
+
+        if (dropped > 0) {
+            char msg[64];
+            int n = snprintf(msg, sizeof(msg), "WARN async log dropped %lu messages\n", static_cast<unsigned long>(dropped));
+            m_file.append(msg, n);
+        }
+        writeBuffers(toWrite);
+        m_file.flush();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto &buffer : toWrite) {
+                buffer->reset();
+                m_free.push_back(std::move(buffer));
+            }
+            m_flushDone = std::max(m_flushDone, flushRequest);
+            m_freeCond.notify_all();
+        }
+        toWrite.clear();
+    }
+}
+
+// 多个缓冲区作为一批写入文件（普通文件一次writev，mmap模式是memcpy），滚动只发生在批次之间
+void AsyncLogAppender::writeBuffers(const std::vector<BufferPtr> &buffers) {
+    if (buffers.empty()) {
+        return;
+    }
+    std::vector<struct iovec> iov;
+    for (auto &buffer : buffers) {
+        iov.push_back({const_cast<char *>(buffer->data()), buffer->size()});
+    }
+    m_file.append(iov.data(), static_cast<int>(iov.size()));
+}
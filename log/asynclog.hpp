@@ -0,0 +1,91 @@
+#ifndef ASYNC_LOG_H_
+#define ASYNC_LOG_H_
+
+#include "log.hpp"
+#include "logfile.hpp"
+#include <condition_variable>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+// 日志缓冲区满时的处理策略：丢弃新日志（只计数）；阻塞写日志的线程直到后台线程归还缓冲区
+enum class LogOverflow
+{
+    DROP,
+    BLOCK
+};
+
+// 预先分配的定长日志缓冲区
+class LogBuffer
+{
+public:
+    explicit LogBuffer(size_t capacity) : m_data(new char[capacity]), m_size(0), m_capacity(capacity) {}
+
+    void append(const char *data, size_t len)
+    {
+        memcpy(m_data.get() + m_size, data, len);
+        m_size += len;
+    }
+    size_t avail() const { return m_capacity - m_size; }
+    size_t size() const { return m_size; }
+    const char *data() const { return m_data.get(); }
+    void reset() { m_size = 0; }
+
+private:
+    std::unique_ptr<char[]> m_data;
+    size_t m_size;
+    size_t m_capacity;
+};
+
+// 异步日志输出：前端线程只把格式化好的日志追加到当前缓冲区，后台线程定期（或缓冲区写满时）交换缓冲区，
+// 用一次writev把所有写满的缓冲区写到文件；缓冲区总数有上限，内存占用有界
+class AsyncLogAppender : public LogAppender
+{
+public:
+    using ptr = std::shared_ptr<AsyncLogAppender>;
+
+    // fileName为空或者"-"时输出到标准输出；fileOptions设置文件的滚动、保留个数和mmap写入
+    AsyncLogAppender(const std::string &fileName, size_t bufferSize = 4 * 1024 * 1024, size_t maxBuffers = 8,
+                     LogOverflow policy = LogOverflow::DROP, int flushIntervalMs = 1000,
+                     const LogFileOptions &fileOptions = LogFileOptions());
+    ~AsyncLogAppender();
+
+    void log(LogLevel::Level level, LogEvent::ptr event) override;
+    // 唤醒后台线程，等待当前已经提交的日志全部写出
+    void flush() override;
+
+    // 追加一条已经格式化好的日志
+    void append(const char *data, size_t len);
+    uint64_t getDropped() const { return m_droppedTotal; }
+
+private:
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+
+    void threadFunc();
+    BufferPtr takeFreeBuffer(); // 持有m_mutex
+    void writeBuffers(const std::vector<BufferPtr> &buffers);
+
+    LogFile m_file; // 只由后台线程访问
+    size_t m_bufferSize;
+    size_t m_maxBuffers;
+    LogOverflow m_policy;
+    int m_flushIntervalMs;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;     // 唤醒后台线程
+    std::condition_variable m_freeCond; // 后台线程归还了缓冲区（BLOCK策略）/完成了一次写出（flush）
+    BufferPtr m_current;                // 前端正在写的缓冲区
+    std::vector<BufferPtr> m_full;      // 等待写出的缓冲区
+    std::vector<BufferPtr> m_free;      // 空闲的缓冲区
+    size_t m_allocated;                 // 已经分配的缓冲区数量，不超过m_maxBuffers
+    uint64_t m_dropped;                 // 上次写出之后丢弃的日志条数
+    uint64_t m_droppedTotal;
+    uint64_t m_flushRequest;            // flush请求的序号
+    uint64_t m_flushDone;               // 已经完成的flush序号
+    bool m_running;
+    std::thread m_thread;
+};
+
+#endif // ASYNC_LOG_H_
@@ -0,0 +1,26 @@
+#ifndef BIN_LOG_H_
+#define BIN_LOG_H_
+
+#include <cstdint>
+
+// 二进制日志文件格式（本机字节序），由LogRingBackend写出，logdecode离线解码为文本
+//
+// 文件头：8字节魔数BINLOG_MAGIC
+// 之后是连续的条目，第一个字节为条目类型：
+//   SITE  调用点定义，每个调用点在第一次出现之前写一次
+//         u32 id | u8 level | i32 line | u16 fileLen | file | u16 fmtLen | fmt
+//   EVENT 一条日志，参数保持LogRecord中的打包格式，不做格式化
+//         u32 id | u64 time(ns) | u64 threadId | u16 argSize | args
+//   DROP  环形队列满丢弃的记录数
+//         u64 time(ns) | u64 count
+
+static const char BINLOG_MAGIC[8] = {'W', 'S', 'B', 'L', 'O', 'G', '1', '\n'};
+
+enum BinlogEntry : uint8_t
+{
+    BINLOG_SITE = 'S',
+    BINLOG_EVENT = 'E',
+    BINLOG_DROP = 'D'
+};
+
+#endif // BIN_LOG_H_
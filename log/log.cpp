@@ -1,4 +1,9 @@
 #include "log.hpp"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
 
 // 日志事件实现
 LogEvent::LogEvent(const char* file, int32_t line, std::thread::id threadId, const std::string& content)
@@ -6,6 +11,10 @@ LogEvent::LogEvent(const char* file, int32_t line, std::thread::id threadId, con
     m_time = std::chrono::system_clock::now().time_since_epoch().count();
 }
 
+LogEvent::LogEvent(const char* file, int32_t line, std::thread::id threadId, const std::string& content, uint64_t time)
+    : m_file(file), m_line(line), m_threadId(threadId), m_time(time), m_content(content) {
+}
+
 const char* LogEvent::getFile() const { return m_file; }
 int32_t LogEvent::getLine() const { return m_line; }
 std::thread::id LogEvent::getThreadId() const { return m_threadId; }
@@ -30,73 +39,358 @@ LogFormatter::LogFormatter(const std::string &pattern)
     init();
 }
 
+namespace {
+const char *const LEVEL_NAMES[] = {"UNKNOWN", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+const size_t LEVEL_LENGTHS[] = {7, 5, 4, 4, 5, 5};
+
+void appendUnsigned(std::string &out, uint64_t value) {
+    char buf[20];
+    char *p = buf + sizeof(buf);
+    do {
+        *--p = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    out.append(p, buf + sizeof(buf) - p);
+}
+
+// 每个线程缓存最近渲染过的整秒时间文本，按照(格式化器, 时间格式)直接映射
+struct DateCache {
+    uint64_t formatter = 0;
+    uint32_t index = 0;
+    int64_t second = -1;
+    std::string text;
+    std::vector<size_t> offsets; // 秒以下部分在text中的位置
+};
+const size_t DATE_CACHE_SLOTS = 4;
+thread_local DateCache dateCache[DATE_CACHE_SLOTS];
+}
+
+// 编译日志模板，相邻的普通字符合并为一条LITERAL指令
 void LogFormatter::init() {
-    // 此处可以实现解析 pattern 的逻辑
-    m_items.push_back(std::make_shared<MessageFormatItem>());
-    m_items.push_back(std::make_shared<LevelFormatItem>());
-    m_items.push_back(std::make_shared<ThreadIdFormatItem>());
+    static std::atomic<uint64_t> nextId(1);
+    m_id = nextId.fetch_add(1, std::memory_order_relaxed); // 重新编译后旧的时间缓存失效
+    m_ops.clear();
+    m_literals.clear();
+    m_dates.clear();
+    size_t literalStart = 0;
+    auto flushLiteral = [&]() {
+        if (m_literals.size() > literalStart) {
+            m_ops.push_back({LITERAL, static_cast<uint32_t>(literalStart), static_cast<uint32_t>(m_literals.size() - literalStart)});
+        }
+        literalStart = m_literals.size();
+    };
+    auto pushOp = [&](OpCode code, uint32_t offset) {
+        flushLiteral();
+        m_ops.push_back({code, offset, 0});
+    };
+
+    for (size_t i = 0; i < m_pattern.size(); ++i) {
+        if (m_pattern[i] != '%' || i + 1 == m_pattern.size()) {
+            m_literals.append(1, m_pattern[i]);
+            continue;
+        }
+        char c = m_pattern[++i];
+        switch (c) {
+            case '%': m_literals.append(1, '%'); break;
+            case 'n': m_literals.append(1, '\n'); break;
+            case 'm': pushOp(MESSAGE, 0); break;
+            case 'p': pushOp(LEVEL, 0); break;
+            case 't': pushOp(THREAD_ID, 0); break;
+            case 'f': pushOp(FILE_NAME, 0); break;
+            case 'l': pushOp(LINE, 0); break;
+            case 'd': {
+                std::string spec = "%Y-%m-%d %H:%M:%S";
+                if (i + 1 < m_pattern.size() && m_pattern[i + 1] == '{') {
+                    size_t close = m_pattern.find('}', i + 2);
+                    if (close != std::string::npos) {
+                        spec = m_pattern.substr(i + 2, close - i - 2);
+                        i = close;
+                    }
+                }
+                // 在 %3N/%6N/%9N 处切开
+                DateFormat date;
+                std::string part;
+                for (size_t j = 0; j < spec.size(); ++j) {
+                    if (spec[j] == '%' && j + 2 < spec.size() && spec[j + 2] == 'N' && strchr("369", spec[j + 1])) {
+                        date.parts.push_back(part);
+                        date.digits.push_back(spec[j + 1] - '0');
+                        part.clear();
+                        j += 2;
+                        continue;
+                    }
+                    part.append(1, spec[j]);
+                    if (spec[j] == '%' && j + 1 < spec.size()) {
+                        part.append(1, spec[++j]); // 保持strftime的转换说明完整，"%%3N"不是秒以下部分
+                    }
+                }
+                date.parts.push_back(part);
+                date.digits.push_back(0);
+                pushOp(DATE, static_cast<uint32_t>(m_dates.size()));
+                m_dates.push_back(std::move(date));
+                break;
+            }
+            default:
+                m_literals.append(1, '%');
+                m_literals.append(1, c);
+                break;
+        }
+    }
+    flushLiteral();
 }
 
-std::string LogFormatter::format(LogEvent::ptr event) {
-    std::stringstream ss;
-    for (auto &item : m_items) {
-        item->format(ss, nullptr, LogLevel::DEBUG, event);
+void LogFormatter::appendDate(std::string &out, const DateFormat &date, uint32_t index, uint64_t time) const {
+    int64_t second = static_cast<int64_t>(time / 1000000000);
+    uint32_t nanos = static_cast<uint32_t>(time % 1000000000);
+    DateCache &cache = dateCache[(m_id + index) % DATE_CACHE_SLOTS];
+    if (cache.formatter != m_id || cache.index != index || cache.second != second) {
+        cache.formatter = m_id;
+        cache.index = index;
+        cache.second = second;
+        cache.text.clear();
+        cache.offsets.clear();
+        time_t sec = static_cast<time_t>(second);
+        struct tm tm;
+        localtime_r(&sec, &tm);
+        char buf[128];
+        for (size_t i = 0; i < date.parts.size(); ++i) {
+            if (!date.parts[i].empty()) {
+                size_t n = strftime(buf, sizeof(buf), date.parts[i].c_str(), &tm);
+                cache.text.append(buf, n);
+            }
+            cache.offsets.push_back(cache.text.size());
+            cache.text.append(date.digits[i], '0');
+        }
+    }
+    size_t base = out.size();
+    out.append(cache.text);
+    for (size_t i = 0; i < date.digits.size(); ++i) {
+        int digits = date.digits[i];
+        if (digits == 0) {
+            continue;
+        }
+        uint32_t value = nanos;
+        for (int d = digits; d < 9; ++d) {
+            value /= 10;
+        }
+        char *p = &out[base + cache.offsets[i] + digits];
+        for (int d = 0; d < digits; ++d) {
+            *--p = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
     }
-    return ss.str();
 }
 
+void LogFormatter::format(std::string &out, LogLevel::Level level, const LogEvent &event) const {
+    for (const Op &op : m_ops) {
+        switch (op.code) {
+            case LITERAL: out.append(m_literals, op.offset, op.length); break;
+            case MESSAGE: out.append(event.getContent()); break;
+            case LEVEL: {
+                size_t l = level >= LogLevel::DEBUG && level <= LogLevel::FATAL ? level : 0;
+                out.append(LEVEL_NAMES[l], LEVEL_LENGTHS[l]);
+                break;
+            }
+            case THREAD_ID: {
+                // 与 std::thread::id 的流输出相同（pthread_t 的数值）
+                std::thread::id id = event.getThreadId();
+                uint64_t value = 0;
+                memcpy(&value, &id, std::min(sizeof(id), sizeof(value)));
+                appendUnsigned(out, value);
+                break;
+            }
+            case FILE_NAME: out.append(event.getFile() ? event.getFile() : ""); break;
+            case LINE: {
+                int32_t line = event.getLine();
+                if (line < 0) {
+                    out.append(1, '-');
+                    line = -line;
+                }
+                appendUnsigned(out, static_cast<uint32_t>(line));
+                break;
+            }
+            case DATE: appendDate(out, m_dates[op.offset], op.offset, event.getTime()); break;
+        }
+    }
+}
 
+std::string LogFormatter::format(LogLevel::Level level, LogEvent::ptr event) {
+    std::string out;
+    format(out, level, *event);
+    return out;
+}
 
 // LogAppender 基类实现
 void LogAppender::setFormatter(LogFormatter::ptr val) { m_formatter = val; }
 LogFormatter::ptr LogAppender::getFormatter() const { return m_formatter; }
 
+const std::string &LogAppender::formatLine(LogLevel::Level level, const LogEvent &event) const {
+    thread_local std::string buffer;
+    buffer.clear();
+    m_formatter->format(buffer, level, event);
+    buffer.append(1, '\n');
+    return buffer;
+}
+
 // 控制台Appender实现
 void StdoutLogAppender::log(LogLevel::Level level, LogEvent::ptr event) {
     if (m_formatter) {
-        std::cout << m_formatter->format(event) << std::endl;
+        const std::string &line = formatLine(level, *event);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::cout.write(line.data(), line.size());
     }
 }
 
+void StdoutLogAppender::flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::cout.flush();
+}
+
 // 文件Appender实现
 FileLogAppender::FileLogAppender(const std::string &fileName) : m_fileName(fileName) {
     reOpen();
 }
 
+// 不再每条日志都std::endl刷新，由ofstream的缓冲区攒够之后再写文件
 void FileLogAppender::log(LogLevel::Level level, LogEvent::ptr event) {
     if (m_formatter) {
-        m_fileStream << m_formatter->format(event) << std::endl;
+        const std::string &line = formatLine(level, *event);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fileStream.write(line.data(), line.size());
     }
 }
 
+void FileLogAppender::flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fileStream.flush();
+}
+
 bool FileLogAppender::reOpen() {
+    std::lock_guard<std::mutex> lock(m_mutex);
     if (m_fileStream.is_open()) {
         m_fileStream.close();
     }
-    m_fileStream.open(m_fileName);
+    m_fileStream.open(m_fileName, std::ios::app);
     return m_fileStream.is_open();
 }
 
 // Logger 实现
-Logger::Logger(const std::string &name) : m_name(name), m_level(LogLevel::DEBUG) {}
+Logger::Logger(const std::string &name)
+    : m_name(name), m_level(LogLevel::DEBUG), m_appenders(nullptr), m_readers(0), m_ring(nullptr) {
+    publishAppenders(new AppenderList());
+}
+
+// 先停止后台线程，把环形队列中剩余的记录输出
+Logger::~Logger() {
+    m_ring = nullptr;
+    m_ringOwner.reset();
+}
+
+void Logger::enableRing(size_t ringCapacity, const std::string &binaryFile) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_ringOwner) {
+        return;
+    }
+    m_ringOwner.reset(new LogRingBackend(this, ringCapacity, binaryFile));
+    m_ring = m_ringOwner.get();
+}
 
 void Logger::log(LogLevel::Level level, LogEvent::ptr event) {
     if (level >= m_level) {
-        for (auto &appender : m_appenders) {
+        const AppenderList *appenders = enterAppenders();
+        for (auto &appender : *appenders) {
             appender->log(level, event);
         }
+        leaveAppenders();
     }
 }
 
+void Logger::logf(LogLevel::Level level, const char *file, int32_t line, const char *fmt, ...) {
+    if (level < m_level) {
+        return;
+    }
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    std::string content;
+    if (n < 0) {
+        return;
+    } else if (static_cast<size_t>(n) < sizeof(buf)) {
+        content.assign(buf, n);
+    } else {
+        // 栈上的缓冲区放不下，按实际长度再格式化一次
+        content.resize(n);
+        va_start(args, fmt);
+        vsnprintf(&content[0], n + 1, fmt, args);
+        va_end(args);
+    }
+    log(level, std::make_shared<LogEvent>(file, line, std::this_thread::get_id(), content));
+}
+
 void Logger::debug(LogEvent::ptr event) { log(LogLevel::DEBUG, event); }
 void Logger::info(LogEvent::ptr event) { log(LogLevel::INFO, event); }
 void Logger::warn(LogEvent::ptr event) { log(LogLevel::WARN, event); }
 void Logger::error(LogEvent::ptr event) { log(LogLevel::ERROR, event); }
 void Logger::fatal(LogEvent::ptr event) { log(LogLevel::FATAL, event); }
 
-void Logger::addAppender(LogAppender::ptr appender) { m_appenders.push_back(appender); }
-void Logger::delAppender(LogAppender::ptr appender) { m_appenders.remove(appender); }
+// 先登记读者再读指针，与发布者的“先写指针再检查读者数”配对（都是seq_cst）：
+// 发布者看到读者数为0时，之后进入的读者一定读到新列表
+const Logger::AppenderList *Logger::enterAppenders() {
+    m_readers.fetch_add(1, std::memory_order_seq_cst);
+    return m_appenders.load(std::memory_order_seq_cst);
+}
+
+void Logger::publishAppenders(AppenderList *appenders) {
+    m_appenderLists.emplace_back(appenders);
+    m_appenders.store(appenders, std::memory_order_seq_cst);
+    if (m_readers.load(std::memory_order_seq_cst) == 0) {
+        m_appenderLists.erase(m_appenderLists.begin(), m_appenderLists.end() - 1);
+    }
+}
+
+void Logger::addAppender(LogAppender::ptr appender) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto appenders = new AppenderList(*m_appenders.load(std::memory_order_relaxed));
+    appenders->push_back(appender);
+    publishAppenders(appenders);
+}
+
+// 被删除的appender可能仍被未回收的旧列表引用，先把它已缓冲的输出刷出去
+void Logger::delAppender(LogAppender::ptr appender) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto appenders = new AppenderList(*m_appenders.load(std::memory_order_relaxed));
+    appenders->remove(appender);
+    publishAppenders(appenders);
+    appender->flush();
+}
+
+void Logger::clearAppenders() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    AppenderList removed(*m_appenders.load(std::memory_order_relaxed));
+    publishAppenders(new AppenderList());
+    for (auto &appender : removed) {
+        appender->flush();
+    }
+}
+
+void Logger::flush() {
+    if (LogRingBackend *backend = ringBackend()) {
+        backend->flush();
+    }
+    const AppenderList *appenders = enterAppenders();
+    for (auto &appender : *appenders) {
+        appender->flush();
+    }
+    leaveAppenders();
+}
 
-LogLevel::Level Logger::getLevel() const { return m_level; }
 void Logger::setLevel(LogLevel::Level val) { m_level = val; }
 
+Logger::ptr Logger::makeRoot() {
+    auto root = std::make_shared<Logger>("root");
+    auto appender = std::make_shared<StdoutLogAppender>();
+    appender->setFormatter(std::make_shared<LogFormatter>("%p %t %m"));
+    root->addAppender(appender);
+    return root;
+}
@@ -10,10 +10,13 @@
 #include <vector>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <atomic>
 
 
 // 前置声明
 class Logger;
+class LogRingBackend;
 
 // 日志事件
 class LogEvent
@@ -22,6 +25,8 @@ public:
     using ptr = std::shared_ptr<LogEvent>;
 
     LogEvent(const char *file, int32_t line, std::thread::id threadId, const std::string &content);
+    // time为事件发生的时间（由后台线程输出的日志，事件发生时间早于构造LogEvent的时间）
+    LogEvent(const char *file, int32_t line, std::thread::id threadId, const std::string &content, uint64_t time);
 
     const char *getFile() const;
     int32_t getLine() const;
@@ -53,55 +58,53 @@ public:
     static std::string toString(Level level);
 };
 
-// 日志格式化
+// 日志格式化：模板在构造时编译成一个扁平的指令列表，格式化时依次执行，直接追加到字符缓冲区
+// %m 日志内容  %p 级别  %t 线程id  %f 文件名  %l 行号  %n 换行  %% 百分号
+// %d{格式} 时间，格式为strftime格式，另外支持 %3N/%6N/%9N 毫秒/微秒/纳秒，省略时为 %Y-%m-%d %H:%M:%S
 class LogFormatter
 {
 public:
     using ptr = std::shared_ptr<LogFormatter>;
     LogFormatter(const std::string &pattern);
 
-    std::string format(LogEvent::ptr event);
+    std::string format(LogLevel::Level level, LogEvent::ptr event);
+    // 追加到out，调用方可以复用同一个缓冲区
+    void format(std::string &out, LogLevel::Level level, const LogEvent &event) const;
 
-    class FormatItem
-    {
-    public:
-        using ptr = std::shared_ptr<FormatItem>;
-        virtual ~FormatItem() {}
-        virtual void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) = 0;
-    };
-    // 日志格式化项实现
-    class MessageFormatItem : public LogFormatter::FormatItem
+    void init(); // 编译日志模板
+
+private:
+    enum OpCode : uint8_t
     {
-    public:
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
-        {
-            os << event->getContent();
-        }
+        LITERAL,
+        MESSAGE,
+        LEVEL,
+        THREAD_ID,
+        FILE_NAME,
+        LINE,
+        DATE
     };
-
-    class LevelFormatItem : public LogFormatter::FormatItem
+    // 一条指令：LITERAL为m_literals中的一段，DATE为m_dates的下标
+    struct Op
     {
-    public:
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
-        {
-            os << LogLevel::toString(level);
-        }
+        OpCode code;
+        uint32_t offset;
+        uint32_t length;
     };
-
-    class ThreadIdFormatItem : public LogFormatter::FormatItem
+    // %d{...}按秒之内不变的部分和秒以下的部分拆开：整秒部分每秒渲染一次缓存起来，秒以下的部分每次改写对应位置的数字
+    struct DateFormat
     {
-    public:
-        void format(std::ostream &os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
-        {
-            os << event->getThreadId();
-        }
+        std::vector<std::string> parts; // strftime片段
+        std::vector<int> digits;        // 每个片段之后秒以下部分的位数，0表示没有
     };
 
-    void init(); // 解析日志模板
+    void appendDate(std::string &out, const DateFormat &date, uint32_t index, uint64_t time) const;
 
-private:
-    std::string m_pattern;                // 日志格式模板
-    std::vector<FormatItem::ptr> m_items; // 日志格式解析后的格式化项
+    std::string m_pattern;           // 日志格式模板
+    uint64_t m_id;                   // 全局唯一的编号，作为每线程时间缓存的键（地址可能被重新分配的格式化器复用）
+    std::vector<Op> m_ops;           // 编译后的指令
+    std::string m_literals;          // 所有普通字符
+    std::vector<DateFormat> m_dates; // 时间格式
 };
 
 // 日志输出目标 基类
@@ -111,11 +114,16 @@ public:
     using ptr = std::shared_ptr<LogAppender>;
     virtual ~LogAppender() {}
     virtual void log(LogLevel::Level level, LogEvent::ptr event) = 0;
+    // 把已经缓存的日志写出
+    virtual void flush() {}
 
     void setFormatter(LogFormatter::ptr val);
     LogFormatter::ptr getFormatter() const;
 
 protected:
+    // 用格式化器把一条日志（加上换行）格式化到当前线程复用的缓冲区中，不再每条日志分配字符串
+    const std::string &formatLine(LogLevel::Level level, const LogEvent &event) const;
+
     LogFormatter::ptr m_formatter;
 };
 
@@ -125,6 +133,10 @@ class StdoutLogAppender : public LogAppender
 public:
     using ptr = std::shared_ptr<StdoutLogAppender>;
     void log(LogLevel::Level level, LogEvent::ptr event) override;
+    void flush() override;
+
+private:
+    std::mutex m_mutex;
 };
 
 // 输出到文件的Appender
@@ -135,11 +147,13 @@ public:
     FileLogAppender(const std::string &fileName);
 
     void log(LogLevel::Level level, LogEvent::ptr event) override;
+    void flush() override;
     bool reOpen();
 
 private:
     std::string m_fileName;
     std::ofstream m_fileStream;
+    std::mutex m_mutex;
 };
 
 // 日志器
@@ -148,8 +162,11 @@ class Logger
 public:
     using ptr = std::shared_ptr<Logger>;
     Logger(const std::string &name = "root");
+    ~Logger();
 
     void log(LogLevel::Level level, LogEvent::ptr event);
+    // printf风格的日志，级别低于日志器级别时不格式化
+    void logf(LogLevel::Level level, const char *file, int32_t line, const char *fmt, ...) __attribute__((format(printf, 5, 6)));
     void debug(LogEvent::ptr event);
     void info(LogEvent::ptr event);
     void warn(LogEvent::ptr event);
@@ -158,14 +175,102 @@ public:
 
     void addAppender(LogAppender::ptr appender);
     void delAppender(LogAppender::ptr appender);
+    void clearAppenders();
+    void flush();
 
-    LogLevel::Level getLevel() const;
+    LogLevel::Level getLevel() const { return m_level.load(std::memory_order_relaxed); }
     void setLevel(LogLevel::Level val);
+    // 日志宏在打包参数之前调用，关闭的级别只有一次原子读和比较
+    bool isEnabled(LogLevel::Level level) const { return m_level.load(std::memory_order_relaxed) <= level; }
+
+    // 开启每线程环形队列：LOG_*宏只把参数打包进当前线程的无锁队列，由后台线程按照时间戳归并后格式化输出
+    // ringCapacity为每个线程的队列能容纳的记录数，队列满时丢弃新记录
+    // binaryFile不为空时后台线程不格式化，把记录以二进制写入该文件（不经过appender），用logdecode解码
+    void enableRing(size_t ringCapacity = 1024, const std::string &binaryFile = "");
+    LogRingBackend *ringBackend() const { return m_ring.load(std::memory_order_acquire); }
+
+    // 全局的root日志器，默认输出到控制台；内联在调用点，初始化之后只剩一次静态变量的检查
+    static const ptr &root()
+    {
+        static const ptr logger = makeRoot();
+        return logger;
+    }
 
 private:
+    static ptr makeRoot();
+
+    using AppenderList = std::list<LogAppender::ptr>;
+
+    // 发布新的appender列表并回收旧列表，调用者持有m_mutex
+    void publishAppenders(AppenderList *appenders);
+    // 读者进出计数，包围对m_appenders的读取和遍历
+    const AppenderList *enterAppenders();
+    void leaveAppenders() { m_readers.fetch_sub(1, std::memory_order_release); }
+
     std::string m_name;
-    LogLevel::Level m_level;
-    std::list<LogAppender::ptr> m_appenders;
+    std::atomic<LogLevel::Level> m_level;
+    // 写时复制：修改时加锁复制列表并原子地发布，输出时只读取当前列表的指针，不加锁。
+    // 读者遍历期间m_readers不为0；发布新列表时若没有读者，之前的旧列表就可以释放，否则留到下一次发布
+    std::atomic<const AppenderList *> m_appenders;
+    std::atomic<int> m_readers;
+    std::vector<std::unique_ptr<const AppenderList>> m_appenderLists; // 当前列表（最后一个）和未释放的旧列表，由m_mutex保护
+    std::mutex m_mutex;
+    std::unique_ptr<LogRingBackend> m_ringOwner;
+    std::atomic<LogRingBackend *> m_ring;
 };
 
+#include "logring.hpp"
+
+// 编译期的最低日志级别（1 DEBUG ... 5 FATAL），低于它的LOG_*宏展开为空语句，参数不求值，也不生成LogSite
+// 例如发布版本编译时加上 -DLOG_MIN_LEVEL=2 去掉所有DEBUG日志
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 1
+#endif
+
+// 输出到root日志器的printf风格日志宏，调用点的格式串等信息放在静态的LogSite中
+// 运行时级别关闭时在求值参数之前返回
+// 只允许整数、浮点数、指针、C字符串和std::string作为参数
+#define LOG_LEVEL(lvl, fmt, ...)                                                  \
+    do                                                                            \
+    {                                                                             \
+        static const LogSite logSite_ = {lvl, __FILE__, __LINE__, fmt};           \
+        if (false)                                                                \
+            logFormatCheck(fmt, ##__VA_ARGS__);                                   \
+        if (__builtin_expect(Logger::root()->isEnabled(lvl), 0))                  \
+            logRecord(*Logger::root(), logSite_, ##__VA_ARGS__);                  \
+    } while (0)
+// 编译期关闭的级别：仍然检查格式串（只在不求值的分支中引用参数，不会产生未使用变量的警告）
+#define LOG_DISABLED(fmt, ...)                                                    \
+    do                                                                            \
+    {                                                                             \
+        if (false)                                                                \
+            logFormatCheck(fmt, ##__VA_ARGS__);                                   \
+    } while (0)
+
+#if LOG_MIN_LEVEL <= 1
+#define LOG_DEBUG(fmt, ...) LOG_LEVEL(LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) LOG_DISABLED(fmt, ##__VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL <= 2
+#define LOG_INFO(fmt, ...) LOG_LEVEL(LogLevel::INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) LOG_DISABLED(fmt, ##__VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL <= 3
+#define LOG_WARN(fmt, ...) LOG_LEVEL(LogLevel::WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) LOG_DISABLED(fmt, ##__VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL <= 4
+#define LOG_ERROR(fmt, ...) LOG_LEVEL(LogLevel::ERROR, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) LOG_DISABLED(fmt, ##__VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL <= 5
+#define LOG_FATAL(fmt, ...) LOG_LEVEL(LogLevel::FATAL, fmt, ##__VA_ARGS__)
+#else
+#define LOG_FATAL(fmt, ...) LOG_DISABLED(fmt, ##__VA_ARGS__)
+#endif
+
 #endif // LOG_H_
@@ -0,0 +1,288 @@
+#include "logfile.hpp"
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const size_t DEFAULT_SEGMENT = 64 * 1024 * 1024; // mmap模式下没有设置滚动大小时每次预分配的大小
+
+int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t pageSize() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+}
+
+LogFile::LogFile(const std::string &fileName, const LogFileOptions &options)
+    : m_fileName(fileName), m_options(options), m_fd(STDOUT_FILENO), m_ownFd(false), m_written(0), m_nextRoll(0),
+      m_rolls(0), m_capacity(0), m_window(nullptr), m_windowStart(0), m_windowSize(0), m_dirtyStart(0), m_lastSyncMs(0) {
+    if (m_fileName.empty() || m_fileName == "-") {
+        m_fileName.clear();
+        return;
+    }
+    m_options.maxFiles = std::max(m_options.maxFiles, 0);
+    m_options.mmapWindow = std::max((m_options.mmapWindow + pageSize() - 1) / pageSize() * pageSize(), pageSize());
+    if (m_options.rollInterval > 0) {
+        m_nextRoll = nextRollTime(time(nullptr));
+    }
+    if (!open()) {
+        m_fd = STDERR_FILENO;
+    }
+}
+
+LogFile::~LogFile() {
+    close();
+}
+
+bool LogFile::open() {
+    int flags = m_options.useMmap ? O_RDWR | O_CREAT | O_CLOEXEC : O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+    m_fd = ::open(m_fileName.c_str(), flags, 0644);
+    if (m_fd < 0) {
+        std::cerr << "open log file " << m_fileName << " failed: " << strerror(errno) << std::endl;
+        m_options.useMmap = false;
+        return false;
+    }
+    m_ownFd = true;
+    struct stat st;
+    m_written = fstat(m_fd, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+    if (m_options.useMmap) {
+        m_capacity = m_written;
+        m_written = findDataEnd();
+        m_dirtyStart = m_written;
+        m_lastSyncMs = nowMs();
+        if (!reserve(m_written + 1) || !mapWindow(m_written)) {
+            // 文件系统不支持时退回普通的write
+            std::cerr << "mmap log file " << m_fileName << " failed, fall back to write" << std::endl;
+            ::close(m_fd);
+            m_options.useMmap = false;
+            return open();
+        }
+    }
+    return true;
+}
+
+void LogFile::close() {
+    if (!m_ownFd) {
+        return;
+    }
+    if (m_window) {
+        msync(m_window, m_windowSize, MS_ASYNC);
+        munmap(m_window, m_windowSize);
+        m_window = nullptr;
+    }
+    if (m_options.useMmap) {
+        // 去掉预分配但没有写入的部分
+        if (ftruncate(m_fd, m_written) != 0) {
+            std::cerr << "truncate log file " << m_fileName << " failed: " << strerror(errno) << std::endl;
+        }
+        m_capacity = 0;
+    }
+    ::close(m_fd);
+    m_fd = STDERR_FILENO;
+    m_ownFd = false;
+}
+
+time_t LogFile::nextRollTime(time_t now) const {
+    // 按本地时间对齐，每天/每小时的滚动点落在整点上
+    struct tm tm;
+    localtime_r(&now, &tm);
+    time_t local = now + tm.tm_gmtoff;
+    return (local / m_options.rollInterval + 1) * m_options.rollInterval - tm.tm_gmtoff;
+}
+
+void LogFile::rollIfNeeded(size_t incoming) {
+    if (m_fileName.empty() || m_written == 0) {
+        return;
+    }
+    bool bySize = m_options.rollSize > 0 && m_written + incoming > m_options.rollSize;
+    bool byTime = m_nextRoll > 0 && time(nullptr) >= m_nextRoll;
+    if (bySize || byTime) {
+        roll();
+    }
+}
+
+// file -> file.1 -> file.2 ... -> file.maxFiles，超出的删除；在同一个线程内完成，滚动时不会丢日志
+void LogFile::roll() {
+    if (m_fileName.empty()) {
+        return;
+    }
+    close();
+    if (m_options.maxFiles == 0) {
+        ::unlink(m_fileName.c_str());
+    } else {
+        ::unlink((m_fileName + "." + std::to_string(m_options.maxFiles)).c_str());
+        for (int i = m_options.maxFiles - 1; i >= 1; i--) {
+            std::string from = m_fileName + "." + std::to_string(i);
+            ::rename(from.c_str(), (m_fileName + "." + std::to_string(i + 1)).c_str());
+        }
+        ::rename(m_fileName.c_str(), (m_fileName + ".1").c_str());
+    }
+    m_rolls++;
+    if (m_options.rollInterval > 0) {
+        m_nextRoll = nextRollTime(time(nullptr));
+    }
+    if (!open()) {
+        m_fd = STDERR_FILENO;
+    }
+}
+
+void LogFile::append(const char *data, size_t len) {
+    struct iovec iov = {const_cast<char *>(data), len};
+    append(&iov, 1);
+}
+
+// 一批缓冲区中放不进当前文件的部分写到滚动之后的新文件，每次滚动之间的缓冲区仍然一次写出
+void LogFile::append(const struct iovec *iov, int count) {
+    int first = 0;
+    while (first < count) {
+        size_t total = iov[first].iov_len;
+        int last = first + 1;
+        while (last < count && (m_options.rollSize == 0 || m_written + total + iov[last].iov_len <= m_options.rollSize)) {
+            total += iov[last].iov_len;
+            last++;
+        }
+        if (total > 0) {
+            rollIfNeeded(total);
+            write(iov + first, last - first, total);
+        }
+        first = last;
+    }
+}
+
+void LogFile::write(const struct iovec *iov, int count, size_t total) {
+    if (m_options.useMmap && m_ownFd) {
+        if (!reserve(m_written + total)) {
+            return; // 磁盘空间不足等情况，丢弃这一批
+        }
+        for (int i = 0; i < count; i++) {
+            writeMmap(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+        }
+        return;
+    }
+    writeFd(iov, count);
+    m_written += total;
+}
+
+// 一次writev写出多个缓冲区，处理部分写
+void LogFile::writeFd(const struct iovec *src, int count) {
+    struct iovec iov[IOV_MAX];
+    int first = 0;
+    while (first < count) {
+        int n = std::min(count - first, IOV_MAX);
+        std::copy(src + first, src + first + n, iov);
+        int done = 0;
+        while (done < n) {
+            ssize_t ret = ::writev(m_fd, iov + done, n - done);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return; // 日志写不出去时放弃这一批
+            }
+            while (done < n && static_cast<size_t>(ret) >= iov[done].iov_len) {
+                ret -= iov[done].iov_len;
+                done++;
+            }
+            if (done < n) {
+                iov[done].iov_base = static_cast<char *>(iov[done].iov_base) + ret;
+                iov[done].iov_len -= ret;
+            }
+        }
+        first += n;
+    }
+}
+
+void LogFile::writeMmap(const char *data, size_t len) {
+    while (len > 0) {
+        if (m_written >= m_windowStart + m_windowSize && !mapWindow(m_written)) {
+            return;
+        }
+        size_t offset = m_written - m_windowStart;
+        size_t n = std::min(len, m_windowSize - offset);
+        memcpy(m_window + offset, data, n);
+        data += n;
+        len -= n;
+        m_written += n;
+    }
+}
+
+// 文件按段预分配：fallocate分配磁盘块（失败时用ftruncate扩展成稀疏文件）
+bool LogFile::reserve(size_t end) {
+    if (end <= m_capacity) {
+        return true;
+    }
+    size_t segment = m_options.rollSize > 0 ? m_options.rollSize : DEFAULT_SEGMENT;
+    size_t capacity = std::max(m_capacity + segment, end);
+    capacity = (capacity + pageSize() - 1) / pageSize() * pageSize();
+    if (fallocate(m_fd, 0, m_capacity, capacity - m_capacity) != 0 && ftruncate(m_fd, capacity) != 0) {
+        return false;
+    }
+    m_capacity = capacity;
+    return true;
+}
+
+// 把包含offset的窗口映射进来，换下的窗口先交给内核回写
+bool LogFile::mapWindow(size_t offset) {
+    if (m_window) {
+        msync(m_window, m_windowSize, MS_ASYNC);
+        munmap(m_window, m_windowSize);
+        m_window = nullptr;
+    }
+    size_t start = offset / pageSize() * pageSize();
+    if (start >= m_capacity) {
+        return false; // 调用方已经用reserve分配到要写入的位置
+    }
+    size_t size = std::min(m_options.mmapWindow, m_capacity - start);
+    void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, start);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    m_window = static_cast<char *>(addr);
+    m_windowStart = start;
+    m_windowSize = size;
+    m_dirtyStart = std::max(m_dirtyStart, start);
+    return true;
+}
+
+size_t LogFile::findDataEnd() {
+    char buf[4096];
+    size_t end = m_capacity;
+    while (end > 0) {
+        size_t n = std::min(end, sizeof(buf));
+        if (pread(m_fd, buf, n, end - n) != static_cast<ssize_t>(n)) {
+            return end;
+        }
+        for (size_t i = n; i > 0; i--) {
+            if (buf[i - 1] != '\0') {
+                return end - n + i;
+            }
+        }
+        end -= n;
+    }
+    return 0;
+}
+
+void LogFile::flush() {
+    if (!m_window) {
+        return;
+    }
+    int64_t now = nowMs();
+    if (now - m_lastSyncMs < m_options.msyncIntervalMs || m_written <= m_dirtyStart) {
+        return;
+    }
+    size_t start = std::max(m_dirtyStart, m_windowStart) / pageSize() * pageSize();
+    msync(m_window + (start - m_windowStart), m_written - start, MS_ASYNC);
+    m_dirtyStart = m_written;
+    m_lastSyncMs = now;
+}
@@ -0,0 +1,69 @@
+#ifndef LOG_FILE_H_
+#define LOG_FILE_H_
+
+#include <cstdint>
+#include <string>
+#include <sys/uio.h>
+
+// 日志文件的滚动和写入方式
+struct LogFileOptions
+{
+    size_t rollSize = 0;                 // 当前文件超过该大小时滚动，0表示不按大小滚动
+    int rollInterval = 0;                // 按墙上时间滚动的间隔（秒，对齐到整点，如3600每小时），0表示不按时间滚动
+    int maxFiles = 8;                    // 保留的历史文件个数：file.1（最新）... file.N，更早的删除
+    bool useMmap = false;                // 预分配文件并通过mmap窗口写入，稳定状态下没有write系统调用
+    size_t mmapWindow = 8 * 1024 * 1024; // mmap窗口大小
+    int msyncIntervalMs = 1000;          // mmap模式下两次msync的最小间隔
+};
+
+// 后台线程使用的日志文件（不加锁）：写入、按大小/时间滚动、删除超出保留个数的历史文件
+// fileName为空或者"-"时写标准输出，不滚动
+class LogFile
+{
+public:
+    LogFile(const std::string &fileName, const LogFileOptions &options = LogFileOptions());
+    ~LogFile();
+
+    LogFile(const LogFile &) = delete;
+    LogFile &operator=(const LogFile &) = delete;
+
+    // 写入一批完整的日志，滚动只发生在iovec之间（每个iovec只包含完整的日志，一条日志不会被拆到两个文件）
+    void append(const struct iovec *iov, int count);
+    void append(const char *data, size_t len);
+    // 到了间隔时把mmap窗口中的脏页交给内核回写
+    void flush();
+    // 立即滚动
+    void roll();
+
+    uint64_t getRolls() const { return m_rolls; }
+
+private:
+    bool open();
+    void close();
+    void rollIfNeeded(size_t incoming);
+    void write(const struct iovec *iov, int count, size_t total);
+    void writeFd(const struct iovec *iov, int count);
+    void writeMmap(const char *data, size_t len);
+    bool reserve(size_t end); // mmap模式：保证文件已经分配到end
+    bool mapWindow(size_t offset);
+    size_t findDataEnd();     // mmap模式：上次没有正常关闭时，跳过预分配文件末尾的0
+    time_t nextRollTime(time_t now) const;
+
+    std::string m_fileName;
+    LogFileOptions m_options;
+    int m_fd;
+    bool m_ownFd;
+    size_t m_written;    // 当前文件已经写入的字节数
+    time_t m_nextRoll;   // 按时间滚动的下一个时间点，0表示不按时间滚动
+    uint64_t m_rolls;
+
+    // mmap模式
+    size_t m_capacity;   // 文件已经分配的大小
+    char *m_window;      // 当前映射的窗口
+    size_t m_windowStart;
+    size_t m_windowSize;
+    size_t m_dirtyStart; // 上次msync之后写入的起点（文件偏移）
+    int64_t m_lastSyncMs;
+};
+
+#endif // LOG_FILE_H_
@@ -0,0 +1,385 @@
+#include "logring.hpp"
+#include "binlog.hpp"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <queue>
+
+const uint64_t REORDER_WINDOW_NS = 2000000; // 只输出2ms之前的记录，等待时间戳更早、还没有发布的记录
+const int MAX_IDLE_MS = 16;                 // 没有日志时轮询间隔的上限
+const size_t BINARY_FLUSH_BYTES = 1 << 20;  // 二进制输出攒够该大小先写一次
+
+// 按照单个转换说明格式化一个参数，追加到out
+template <typename T>
+static void appendFormatted(std::string &out, const std::string &spec, T value)
+{
+    char buf[128];
+    int n = snprintf(buf, sizeof(buf), spec.c_str(), value);
+    if (n < 0)
+        return;
+    if (static_cast<size_t>(n) < sizeof(buf))
+    {
+        out.append(buf, n);
+        return;
+    }
+    size_t old = out.size();
+    out.resize(old + n + 1);
+    snprintf(&out[old], n + 1, spec.c_str(), value);
+    out.resize(old + n);
+}
+
+std::string formatLogArgs(const char *fmt, const char *args, size_t size)
+{
+    std::string out;
+    size_t pos = 0;
+    const char *p = fmt;
+    while (*p)
+    {
+        if (*p != '%')
+        {
+            const char *next = strchr(p, '%');
+            size_t len = next ? static_cast<size_t>(next - p) : strlen(p);
+            out.append(p, len);
+            p += len;
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            out.append(1, '%');
+            p += 2;
+            continue;
+        }
+        // 解析转换说明：标志、宽度、精度保留，长度修饰符去掉，按照参数实际打包的类型重新选择
+        std::string spec = "%";
+        p++;
+        while (*p && strchr("-+ #0", *p))
+            spec.append(1, *p++);
+        while (*p && (isdigit(static_cast<unsigned char>(*p)) || *p == '.'))
+            spec.append(1, *p++);
+        while (*p && strchr("hlLqjzt", *p))
+            p++;
+        char conv = *p;
+        if (!conv)
+            break;
+        p++;
+
+        if (pos >= size)
+            continue; // 参数不够（打包时被截断）
+        char tag = args[pos++];
+        switch (tag)
+        {
+        case LogRecord::INT:
+        case LogRecord::UINT:
+        {
+            uint64_t raw;
+            memcpy(&raw, args + pos, sizeof(raw));
+            pos += sizeof(raw);
+            if (conv == 'c')
+                appendFormatted(out, spec + "c", static_cast<int>(raw));
+            else if (strchr("feEgGaA", conv))
+                appendFormatted(out, spec + conv, tag == LogRecord::INT ? static_cast<double>(static_cast<int64_t>(raw)) : static_cast<double>(raw));
+            else if (strchr("uxXo", conv))
+                appendFormatted(out, spec + "ll" + conv, static_cast<unsigned long long>(raw));
+            else if (tag == LogRecord::INT)
+                appendFormatted(out, spec + "lld", static_cast<long long>(raw));
+            else
+                appendFormatted(out, spec + "llu", static_cast<unsigned long long>(raw));
+            break;
+        }
+        case LogRecord::DOUBLE:
+        {
+            double value;
+            memcpy(&value, args + pos, sizeof(value));
+            pos += sizeof(value);
+            appendFormatted(out, spec + (strchr("feEgGaA", conv) ? conv : 'g'), value);
+            break;
+        }
+        case LogRecord::POINTER:
+        {
+            uint64_t raw;
+            memcpy(&raw, args + pos, sizeof(raw));
+            pos += sizeof(raw);
+            appendFormatted(out, spec + "p", reinterpret_cast<void *>(static_cast<uintptr_t>(raw)));
+            break;
+        }
+        case LogRecord::STRING:
+        {
+            uint16_t len;
+            memcpy(&len, args + pos, sizeof(len));
+            pos += sizeof(len);
+            if (spec.size() == 1)
+                out.append(args + pos, len); // 没有宽度和精度，直接拷贝
+            else
+                appendFormatted(out, spec + "s", std::string(args + pos, len).c_str());
+            pos += len;
+            break;
+        }
+        default:
+            pos = size; // 无法识别的类型，后面的参数都不再解析
+            break;
+        }
+    }
+    return out;
+}
+
+LogRing::LogRing(size_t capacity)
+{
+    size_t cap = 2;
+    while (cap < capacity)
+        cap <<= 1;
+    m_capacity = cap;
+    m_mask = cap - 1;
+    m_records.reset(new LogRecord[cap]);
+}
+
+namespace
+{
+// 线程退出时把它的环形队列标记为关闭，后台线程输出完剩余记录后释放
+struct ThreadRing
+{
+    LogRingBackend *owner = nullptr;
+    std::shared_ptr<LogRing> ring;
+    ~ThreadRing()
+    {
+        if (ring)
+            ring->closed.store(true, std::memory_order_release);
+    }
+};
+thread_local ThreadRing tlsRing;
+} // namespace
+
+LogRingBackend::LogRingBackend(Logger *logger, size_t ringCapacity, const std::string &binaryFile)
+    : m_logger(logger), m_ringCapacity(ringCapacity), m_flushRequest(0), m_flushDone(0), m_running(true), m_binFd(-1)
+{
+    if (!binaryFile.empty())
+    {
+        m_binFd = ::open(binaryFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (m_binFd < 0)
+            std::cerr << "open binary log " << binaryFile << " failed: " << strerror(errno) << std::endl;
+        else
+            putBinary(BINLOG_MAGIC, sizeof(BINLOG_MAGIC));
+    }
+    m_thread = std::thread(&LogRingBackend::threadFunc, this);
+}
+
+LogRingBackend::~LogRingBackend()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_cond.notify_all();
+    }
+    m_thread.join();
+    if (m_binFd >= 0)
+    {
+        flushBinary();
+        ::close(m_binFd);
+    }
+}
+
+LogRing *LogRingBackend::threadRing()
+{
+    if (tlsRing.owner == this)
+        return tlsRing.ring.get();
+    auto ring = std::make_shared<LogRing>(m_ringCapacity);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_rings.push_back(ring);
+    }
+    if (tlsRing.ring)
+        tlsRing.ring->closed.store(true, std::memory_order_release);
+    tlsRing.owner = this;
+    tlsRing.ring = ring;
+    return ring.get();
+}
+
+void LogRingBackend::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    uint64_t request = ++m_flushRequest;
+    m_cond.notify_all();
+    m_cond.wait(lock, [&]() { return m_flushDone >= request || !m_running; });
+}
+
+void LogRingBackend::threadFunc()
+{
+    int idleMs = 1;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        bool running = m_running;
+        uint64_t flushRequest = m_flushRequest;
+        bool force = !running || flushRequest > m_flushDone;
+        lock.unlock();
+
+        uint64_t cutoff = UINT64_MAX;
+        if (!force)
+            cutoff = std::chrono::system_clock::now().time_since_epoch().count() - REORDER_WINDOW_NS;
+        size_t n = drain(cutoff);
+
+        lock.lock();
+        if (force)
+        {
+            m_flushDone = flushRequest;
+            m_cond.notify_all();
+        }
+        if (!running)
+            break;
+        // 有日志时每毫秒轮询一次，空闲时逐渐拉长间隔
+        idleMs = n > 0 ? 1 : std::min(idleMs * 2, MAX_IDLE_MS);
+        m_cond.wait_for(lock, std::chrono::milliseconds(idleMs), [&]() { return !m_running || m_flushRequest > m_flushDone; });
+    }
+}
+
+// 多路归并：每个队列的记录本身按时间有序，每次取出各队列队首中时间戳最小的一条
+size_t LogRingBackend::drain(uint64_t cutoff)
+{
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        rings = m_rings;
+    }
+
+    for (auto &ring : rings)
+    {
+        uint64_t dropped = ring->takeDropped();
+        if (dropped > 0)
+        {
+            ring->markDroppedSeen(dropped);
+            emitDropped(dropped);
+        }
+    }
+
+    using Entry = std::pair<uint64_t, size_t>; // 队首记录的时间戳，队列下标
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    std::vector<size_t> left(rings.size());
+    std::vector<bool> closed(rings.size());
+    for (size_t i = 0; i < rings.size(); i++)
+    {
+        // 先读closed再读available：线程退出前发布的记录都能看到
+        closed[i] = rings[i]->closed.load(std::memory_order_acquire);
+        left[i] = rings[i]->available();
+        if (left[i] > 0)
+            heap.push(Entry(rings[i]->front().time, i));
+    }
+
+    size_t count = 0;
+    while (!heap.empty())
+    {
+        size_t i = heap.top().second;
+        uint64_t time = heap.top().first;
+        heap.pop();
+        if (time > cutoff)
+            continue; // 这个队列剩下的记录都更晚，留到下一轮
+        emit(rings[i]->front());
+        rings[i]->pop();
+        count++;
+        if (--left[i] > 0)
+            heap.push(Entry(rings[i]->front().time, i));
+    }
+
+    if (m_binFd >= 0)
+        flushBinary();
+
+    // 释放已经退出的线程的空队列
+    bool removed = false;
+    for (size_t i = 0; i < rings.size(); i++)
+    {
+        if (closed[i] && rings[i]->available() == 0)
+            removed = true;
+    }
+    if (removed)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < rings.size(); i++)
+        {
+            if (closed[i] && rings[i]->available() == 0)
+                m_rings.erase(std::find(m_rings.begin(), m_rings.end(), rings[i]));
+        }
+    }
+    return count;
+}
+
+void LogRingBackend::emit(const LogRecord &record)
+{
+    if (m_binFd >= 0)
+    {
+        emitBinary(record);
+        return;
+    }
+    const LogSite *site = record.site;
+    m_logger->log(site->level, std::make_shared<LogEvent>(site->file, site->line, record.threadId,
+                                                          formatLogArgs(site->fmt, record.args, record.argSize), record.time));
+}
+
+void LogRingBackend::emitDropped(uint64_t dropped)
+{
+    if (m_binFd < 0)
+    {
+        m_logger->log(LogLevel::WARN, std::make_shared<LogEvent>(__FILE__, __LINE__, std::this_thread::get_id(),
+                                                                 "log ring full, dropped " + std::to_string(dropped) + " records"));
+        return;
+    }
+    uint64_t time = std::chrono::system_clock::now().time_since_epoch().count();
+    putEntry(BINLOG_DROP);
+    putBinary(&time, sizeof(time));
+    putBinary(&dropped, sizeof(dropped));
+}
+
+// 热路径上只有参数的memcpy，格式串和文件名只在调用点第一次出现时写一次
+void LogRingBackend::emitBinary(const LogRecord &record)
+{
+    static_assert(sizeof(std::thread::id) == sizeof(uint64_t), "thread id is written as u64");
+    const LogSite *site = record.site;
+    auto it = m_siteIds.find(site);
+    if (it == m_siteIds.end())
+    {
+        uint32_t id = static_cast<uint32_t>(m_siteIds.size());
+        it = m_siteIds.emplace(site, id).first;
+        uint8_t level = static_cast<uint8_t>(site->level);
+        uint16_t fileLen = static_cast<uint16_t>(strlen(site->file));
+        uint16_t fmtLen = static_cast<uint16_t>(strlen(site->fmt));
+        putEntry(BINLOG_SITE);
+        putBinary(&id, sizeof(id));
+        putBinary(&level, sizeof(level));
+        putBinary(&site->line, sizeof(site->line));
+        putBinary(&fileLen, sizeof(fileLen));
+        putBinary(site->file, fileLen);
+        putBinary(&fmtLen, sizeof(fmtLen));
+        putBinary(site->fmt, fmtLen);
+    }
+    if (site->level < m_logger->getLevel())
+        return;
+    putEntry(BINLOG_EVENT);
+    putBinary(&it->second, sizeof(it->second));
+    putBinary(&record.time, sizeof(record.time));
+    putBinary(&record.threadId, sizeof(record.threadId));
+    putBinary(&record.argSize, sizeof(record.argSize));
+    putBinary(record.args, record.argSize);
+    if (m_binBuf.size() >= BINARY_FLUSH_BYTES)
+        flushBinary();
+}
+
+void LogRingBackend::putEntry(uint8_t type)
+{
+    m_binBuf.push_back(static_cast<char>(type));
+}
+
+void LogRingBackend::flushBinary()
+{
+    size_t offset = 0;
+    while (offset < m_binBuf.size())
+    {
+        ssize_t n = ::write(m_binFd, m_binBuf.data() + offset, m_binBuf.size() - offset);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break; // 写不出去时放弃这一批
+        }
+        offset += n;
+    }
+    m_binBuf.clear();
+}
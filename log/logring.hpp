@@ -0,0 +1,240 @@
+#ifndef LOG_RING_H_
+#define LOG_RING_H_
+
+#include "log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// 日志调用点：每个LOG_*宏展开处一个静态对象，它的地址就是格式id
+struct LogSite
+{
+    LogLevel::Level level;
+    const char *file;
+    int32_t line;
+    const char *fmt;
+};
+
+// 定长的二进制日志记录：时间戳、调用点、线程id和按类型打包的参数，参数在后台线程才格式化
+struct LogRecord
+{
+    static constexpr size_t SIZE = 256;
+    static constexpr size_t HEADER = sizeof(uint64_t) + sizeof(const LogSite *) + sizeof(std::thread::id) + sizeof(uint16_t);
+    static constexpr size_t ARG_CAPACITY = SIZE - HEADER;
+
+    // 参数类型标记
+    enum Tag : uint8_t
+    {
+        INT = 'i',
+        UINT = 'u',
+        DOUBLE = 'd',
+        STRING = 's', // 后跟uint16长度和字节内容，超长时截断
+        POINTER = 'p'
+    };
+
+    uint64_t time;           // 纳秒时间戳（system_clock）
+    const LogSite *site;     // 格式id
+    std::thread::id threadId;
+    uint16_t argSize;        // args中已经使用的字节数
+    char args[ARG_CAPACITY];
+
+    void reset(const LogSite *s)
+    {
+        time = std::chrono::system_clock::now().time_since_epoch().count();
+        site = s;
+        threadId = std::this_thread::get_id();
+        argSize = 0;
+    }
+
+    void putRaw(Tag tag, const void *data, size_t len)
+    {
+        if (argSize + 1 + len > ARG_CAPACITY)
+            return; // 放不下的参数丢弃，格式化时输出为空
+        args[argSize++] = static_cast<char>(tag);
+        memcpy(args + argSize, data, len);
+        argSize += len;
+    }
+
+    void putString(const char *str, size_t len)
+    {
+        if (argSize + 1 + sizeof(uint16_t) > ARG_CAPACITY)
+            return;
+        len = std::min(len, ARG_CAPACITY - argSize - 1 - sizeof(uint16_t));
+        uint16_t len16 = static_cast<uint16_t>(len);
+        args[argSize++] = static_cast<char>(STRING);
+        memcpy(args + argSize, &len16, sizeof(len16));
+        argSize += sizeof(len16);
+        memcpy(args + argSize, str, len);
+        argSize += len;
+    }
+
+    template <typename T>
+    void put(const T &value)
+    {
+        using U = typename std::decay<T>::type;
+        if constexpr (std::is_same<U, char *>::value || std::is_same<U, const char *>::value)
+        {
+            const char *str = value; // 字符串字面量以数组传入，先转成指针再判空
+            if (!str)
+                str = "(null)";
+            putString(str, strlen(str));
+        }
+        else if constexpr (std::is_same<U, std::string>::value)
+        {
+            putString(value.data(), value.size());
+        }
+        else if constexpr (std::is_floating_point<U>::value)
+        {
+            double v = value;
+            putRaw(DOUBLE, &v, sizeof(v));
+        }
+        else if constexpr (std::is_pointer<U>::value)
+        {
+            uint64_t v = reinterpret_cast<uintptr_t>(value);
+            putRaw(POINTER, &v, sizeof(v));
+        }
+        else if constexpr (std::is_enum<U>::value)
+        {
+            int64_t v = static_cast<int64_t>(value);
+            putRaw(INT, &v, sizeof(v));
+        }
+        else if constexpr (std::is_signed<U>::value)
+        {
+            int64_t v = value;
+            putRaw(INT, &v, sizeof(v));
+        }
+        else
+        {
+            static_assert(std::is_unsigned<U>::value, "unsupported log argument type");
+            uint64_t v = value;
+            putRaw(UINT, &v, sizeof(v));
+        }
+    }
+};
+
+static_assert(sizeof(LogRecord) == LogRecord::SIZE, "LogRecord must stay fixed-size");
+
+// 按照printf格式串把打包的参数格式化为文本
+std::string formatLogArgs(const char *fmt, const char *args, size_t size);
+
+// 单生产者单消费者环形队列，生产者是写日志的线程，消费者是后台线程
+class LogRing
+{
+public:
+    explicit LogRing(size_t capacity);
+
+    // 生产者：取得下一个空闲槽位，队列满时返回nullptr（计入丢弃数量）
+    LogRecord *claim()
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache >= m_capacity)
+        {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache >= m_capacity)
+            {
+                m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        return &m_records[tail & m_mask];
+    }
+    // 生产者：发布claim得到的记录
+    void publish() { m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // 消费者
+    size_t available() const { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_relaxed); }
+    const LogRecord &front(size_t offset = 0) const { return m_records[(m_head.load(std::memory_order_relaxed) + offset) & m_mask]; }
+    void pop() { m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    uint64_t takeDropped() { return m_dropped.load(std::memory_order_relaxed) - m_droppedSeen; }
+    void markDroppedSeen(uint64_t n) { m_droppedSeen += n; }
+
+    std::atomic<bool> closed{false}; // 所属线程已经退出
+
+private:
+    std::unique_ptr<LogRecord[]> m_records;
+    size_t m_capacity;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_head{0}; // 消费者位置
+    uint64_t m_droppedSeen = 0;                // 消费者已经报告过的丢弃数量
+    alignas(64) std::atomic<size_t> m_tail{0}; // 生产者位置
+    size_t m_headCache = 0;                    // 生产者缓存的消费者位置，减少对m_head所在缓存行的访问
+    std::atomic<uint64_t> m_dropped{0};
+};
+
+// 后台线程：轮询所有线程的环形队列，按照时间戳归并之后交给Logger的appender输出
+// 指定了二进制日志文件时不做格式化，直接把记录原样写入文件（格式见binlog.hpp），由logdecode离线解码
+class LogRingBackend
+{
+public:
+    LogRingBackend(Logger *logger, size_t ringCapacity, const std::string &binaryFile = "");
+    ~LogRingBackend();
+
+    // 当前线程的环形队列，第一次调用时注册（只有这一次加锁和分配内存）
+    LogRing *threadRing();
+    // 等待已经写入的记录全部输出
+    void flush();
+
+private:
+    void threadFunc();
+    // 输出所有时间戳不晚于cutoff的记录，返回输出的条数
+    size_t drain(uint64_t cutoff);
+    void emit(const LogRecord &record);
+    void emitBinary(const LogRecord &record);
+    void emitDropped(uint64_t dropped);
+    void putBinary(const void *data, size_t len) { m_binBuf.insert(m_binBuf.end(), static_cast<const char *>(data), static_cast<const char *>(data) + len); }
+    void putEntry(uint8_t type);
+    void flushBinary();
+
+    Logger *m_logger;
+    size_t m_ringCapacity;
+    std::mutex m_mutex; // 保护m_rings和flush请求
+    std::condition_variable m_cond;
+    std::vector<std::shared_ptr<LogRing>> m_rings;
+    uint64_t m_flushRequest;
+    uint64_t m_flushDone;
+    bool m_running;
+    std::thread m_thread;
+
+    int m_binFd;                                         // 二进制日志文件，-1表示输出文本
+    std::vector<char> m_binBuf;                          // 一轮归并的输出，结束时一次write
+    std::unordered_map<const LogSite *, uint32_t> m_siteIds; // 已经写出定义的调用点
+};
+
+// 写一条日志：开启了环形队列时只把参数打包进当前线程的队列，否则在当前线程直接格式化输出
+template <typename... Args>
+void logRecord(Logger &logger, const LogSite &site, const Args &...args)
+{
+    LogRingBackend *backend = logger.ringBackend();
+    if (backend)
+    {
+        LogRing *ring = backend->threadRing();
+        LogRecord *record = ring->claim();
+        if (!record)
+            return;
+        record->reset(&site);
+        (record->put(args), ...);
+        ring->publish();
+        return;
+    }
+    LogRecord record;
+    record.reset(&site);
+    (record.put(args), ...);
+    logger.log(site.level, std::make_shared<LogEvent>(site.file, site.line, record.threadId,
+                                                      formatLogArgs(site.fmt, record.args, record.argSize), record.time));
+}
+
+// 只用于编译期检查格式串和参数是否匹配，从不调用
+inline void logFormatCheck(const char *, ...) __attribute__((format(printf, 1, 2)));
+inline void logFormatCheck(const char *, ...) {}
+
+#endif // LOG_RING_H_
@@ -0,0 +1,85 @@
+// Logger的appender列表：多个线程输出日志的同时反复增删appender，不崩溃、不丢失已发布的appender；
+// 没有读者时发布新列表会释放旧列表，被删除的appender只剩测试持有的引用，并且删除时被flush
+#include "../log.hpp"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+class CountAppender : public LogAppender
+{
+public:
+    void log(LogLevel::Level, LogEvent::ptr) override { logged++; }
+    void flush() override { flushed++; }
+
+    std::atomic<unsigned long long> logged{0};
+    std::atomic<int> flushed{0};
+};
+
+static void runChurn(int threads, int rounds)
+{
+    auto logger = std::make_shared<Logger>("appender_test");
+    auto stable = std::make_shared<CountAppender>();
+    logger->addAppender(stable);
+
+    std::atomic<bool> stop(false);
+    std::atomic<unsigned long long> written(0);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; t++)
+    {
+        writers.emplace_back([&]() {
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                logger->log(LogLevel::INFO, std::make_shared<LogEvent>(__FILE__, __LINE__, std::this_thread::get_id(), "x"));
+                written++;
+            }
+        });
+    }
+
+    std::vector<std::shared_ptr<CountAppender>> removed;
+    for (int i = 0; i < rounds; i++)
+    {
+        auto appender = std::make_shared<CountAppender>();
+        logger->addAppender(appender);
+        std::this_thread::yield();
+        logger->delAppender(appender);
+        removed.push_back(appender);
+    }
+    stop = true;
+    for (auto &writer : writers)
+        writer.join();
+
+    check(stable->logged == written, "stable appender receives every record");
+    bool flushed = true;
+    for (auto &appender : removed)
+        flushed = flushed && appender->flushed == 1;
+    check(flushed, "removed appender is flushed");
+
+    // 写线程都已退出，这次发布时没有读者，之前的旧列表全部释放
+    logger->delAppender(stable);
+    bool released = stable.use_count() == 1;
+    for (auto &appender : removed)
+        released = released && appender.use_count() == 1;
+    check(released, "old appender lists are released when no reader is active");
+}
+
+int main()
+{
+    runChurn(1, 2000);
+    runChurn(4, 2000);
+    if (failures)
+        return 1;
+    printf("appender_test passed\n");
+    return 0;
+}
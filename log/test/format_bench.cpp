@@ -0,0 +1,67 @@
+// 日志格式化吞吐量测试：编译后的LogFormatter与逐项写入stringstream、每条日志调用strftime的实现对比
+#include "../log.hpp"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+
+static const long ROUNDS = 2000000;
+static const char *PATTERN = "%d{%Y-%m-%d %H:%M:%S.%6N} %p %t %f:%l %m%n";
+
+// 对照组：每条日志都构造stringstream，用strftime渲染完整的时间
+static std::string naiveFormat(LogLevel::Level level, const LogEvent &event)
+{
+    std::stringstream ss;
+    time_t sec = static_cast<time_t>(event.getTime() / 1000000000);
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    char buf[64];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    ss << buf << '.' << std::setw(6) << std::setfill('0') << event.getTime() % 1000000000 / 1000 << ' '
+       << LogLevel::toString(level) << ' ' << event.getThreadId() << ' ' << event.getFile() << ':' << event.getLine()
+       << ' ' << event.getContent() << '\n';
+    return ss.str();
+}
+
+template <typename Fn>
+static void report(const char *name, Fn &&fn)
+{
+    size_t bytes = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (long i = 0; i < ROUNDS; i++)
+        bytes += fn(i);
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+    printf("%-36s %8.1f ns/op %8.2f Mlines/s %8.1f MB/s\n", name, ns / ROUNDS, ROUNDS / ns * 1000, bytes / ns * 1000);
+}
+
+int main()
+{
+    // 时间戳每条前进1微秒，200万条日志跨越2秒，整秒部分的缓存基本都能命中
+    uint64_t start = std::chrono::system_clock::now().time_since_epoch().count();
+    LogEvent event(__FILE__, __LINE__, std::this_thread::get_id(), "GET /index.html HTTP/1.1 200 1024 bytes", start);
+    LogFormatter formatter(PATTERN);
+
+    std::string sample;
+    formatter.format(sample, LogLevel::INFO, event);
+    printf("pattern: %s\nsample:  %s", PATTERN, sample.c_str());
+
+    report("stringstream + strftime", [&](long i) {
+        LogEvent e(__FILE__, __LINE__, event.getThreadId(), event.getContent(), start + i * 1000);
+        return naiveFormat(LogLevel::INFO, e).size();
+    });
+
+    report("LogFormatter::format (string)", [&](long i) {
+        LogEvent e(__FILE__, __LINE__, event.getThreadId(), event.getContent(), start + i * 1000);
+        return formatter.format(LogLevel::INFO, std::make_shared<LogEvent>(e)).size();
+    });
+
+    std::string buffer;
+    report("LogFormatter::format (reused buf)", [&](long i) {
+        LogEvent e(__FILE__, __LINE__, event.getThreadId(), event.getContent(), start + i * 1000);
+        buffer.clear();
+        formatter.format(buffer, LogLevel::INFO, e);
+        return buffer.size();
+    });
+    return 0;
+}
@@ -0,0 +1,70 @@
+// 日志宏的开销测试：编译期去掉的级别、运行时关闭的级别与实际写入环形队列的对比
+// 本文件以 LOG_MIN_LEVEL=2 编译，LOG_DEBUG 在编译期被去掉；root日志器的级别设为WARN，LOG_INFO 在运行时关闭
+#define LOG_MIN_LEVEL 2
+#include "../log.hpp"
+#include <chrono>
+#include <cstdio>
+
+static const long ROUNDS = 100000000;
+static const long ENABLED_ROUNDS = 1000000;
+
+static long evaluated = 0;
+
+// 代价较高的参数：如果日志宏在判断级别之前求值参数，evaluated会增加
+__attribute__((noinline)) static long expensive(long i)
+{
+    evaluated++;
+    return i * 31;
+}
+
+template <typename Fn>
+static void report(const char *name, long ops, Fn &&fn)
+{
+    long before = evaluated;
+    auto begin = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+    printf("%-36s %8.2f ns/op %10ld args evaluated\n", name, ns / ops, evaluated - before);
+}
+
+int main()
+{
+    Logger::ptr logger = Logger::root();
+    logger->clearAppenders(); // 只测量前端的开销
+    logger->setLevel(LogLevel::WARN);
+    logger->enableRing(1 << 16);
+
+    // 空循环：asm volatile阻止编译器把循环整个删掉
+    report("empty loop", ROUNDS, []() {
+        for (long i = 0; i < ROUNDS; i++)
+            asm volatile("" ::: "memory");
+    });
+
+    report("LOG_DEBUG (compiled out)", ROUNDS, []() {
+        for (long i = 0; i < ROUNDS; i++)
+        {
+            LOG_DEBUG("value %ld %s", expensive(i), "debug");
+            asm volatile("" ::: "memory");
+        }
+    });
+
+    report("LOG_INFO (disabled at runtime)", ROUNDS, []() {
+        for (long i = 0; i < ROUNDS; i++)
+        {
+            LOG_INFO("value %ld %s", expensive(i), "info");
+            asm volatile("" ::: "memory");
+        }
+    });
+
+    // 打开的级别：参数打包进当前线程的环形队列（队列满时丢弃，同样计入耗时）
+    report("LOG_WARN (enabled, ring)", ENABLED_ROUNDS, []() {
+        for (long i = 0; i < ENABLED_ROUNDS; i++)
+        {
+            LOG_WARN("value %ld %s", expensive(i), "warn");
+            asm volatile("" ::: "memory");
+        }
+    });
+    logger->flush();
+    return 0;
+}
@@ -0,0 +1,153 @@
+// LogRing的正确性：单生产者单消费者并发时记录按顺序到达、不重复，被丢弃的数量准确；
+// 以及经过LogRingBackend输出时，每个线程的记录保持顺序，收到的条数加上报告的丢弃数等于写入的条数
+#include "../logring.hpp"
+#include <cstdio>
+#include <map>
+#include <thread>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// 生产者把序号写进time字段；双方不定期让出CPU（单核上也能交替执行），让队列时满时空
+static void runRing(const char *name, size_t capacity, uint64_t items)
+{
+    LogRing ring(capacity);
+    std::atomic<bool> producerDone(false);
+    uint64_t claimFailures = 0;
+
+    std::thread producer([&]() {
+        for (uint64_t seq = 1; seq <= items; seq++)
+        {
+            LogRecord *record = ring.claim();
+            if (!record)
+            {
+                claimFailures++;
+                std::this_thread::yield();
+                continue;
+            }
+            record->time = seq;
+            record->argSize = static_cast<uint16_t>(seq & 0xff);
+            ring.publish();
+            if (seq % 97 == 0)
+                std::this_thread::yield();
+        }
+        producerDone.store(true, std::memory_order_release);
+    });
+
+    uint64_t received = 0, last = 0, dropped = 0;
+    bool ordered = true, intact = true;
+    for (uint64_t spin = 0;; spin++)
+    {
+        bool done = producerDone.load(std::memory_order_acquire);
+        size_t n = ring.available();
+        for (size_t i = 0; i < n; i++)
+        {
+            const LogRecord &record = ring.front();
+            ordered = ordered && record.time > last;
+            intact = intact && record.argSize == (record.time & 0xff);
+            last = record.time;
+            received++;
+            ring.pop();
+        }
+        uint64_t d = ring.takeDropped();
+        ring.markDroppedSeen(d);
+        dropped += d;
+        if (done && n == 0 && ring.available() == 0)
+            break;
+        if (spin % 7 == 0)
+            std::this_thread::yield();
+    }
+    producer.join();
+    dropped += ring.takeDropped();
+
+    bool ok = ordered && intact && received + dropped == items && dropped == claimFailures;
+    if (!ok)
+        printf("%s: received %llu dropped %llu claim failures %llu ordered %d intact %d\n", name,
+               static_cast<unsigned long long>(received), static_cast<unsigned long long>(dropped),
+               static_cast<unsigned long long>(claimFailures), ordered, intact);
+    check(ok, name);
+}
+
+// 收集后台线程输出的日志：每个线程的序号，以及丢弃报告中的数量
+class CollectAppender : public LogAppender
+{
+public:
+    void log(LogLevel::Level, LogEvent::ptr event) override
+    {
+        int thread = 0;
+        unsigned long long seq = 0, dropped = 0;
+        const std::string &content = event->getContent();
+        if (sscanf(content.c_str(), "t%d seq %llu", &thread, &seq) == 2)
+        {
+            if (seq <= last[thread])
+                ordered = false;
+            last[thread] = seq;
+            received++;
+        }
+        else if (sscanf(content.c_str(), "log ring full, dropped %llu records", &dropped) == 1)
+        {
+            this->dropped += dropped;
+        }
+    }
+
+    std::map<int, unsigned long long> last;
+    unsigned long long received = 0;
+    unsigned long long dropped = 0;
+    bool ordered = true;
+};
+
+static void runBackend(size_t capacity, int threads, unsigned long long perThread)
+{
+    auto logger = std::make_shared<Logger>("ring_test");
+    auto appender = std::make_shared<CollectAppender>();
+    logger->addAppender(appender);
+    logger->enableRing(capacity);
+
+    static const LogSite site = {LogLevel::INFO, __FILE__, __LINE__, "t%d seq %llu"};
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; t++)
+    {
+        writers.emplace_back([&, t]() {
+            for (unsigned long long seq = 1; seq <= perThread; seq++)
+            {
+                logRecord(*logger, site, t, seq);
+                if (seq % 16 == 0)
+                    std::this_thread::yield();
+            }
+        });
+    }
+    for (auto &writer : writers)
+        writer.join();
+    logger->flush();
+
+    unsigned long long total = threads * perThread;
+    bool ok = appender->ordered && appender->received + appender->dropped == total;
+    if (!ok)
+        printf("backend: received %llu dropped %llu of %llu ordered %d\n", appender->received, appender->dropped,
+               total, appender->ordered);
+    check(ok, "backend per-thread order and drop count");
+}
+
+int main()
+{
+    for (int round = 0; round < 3; round++)
+    {
+        runRing("ring capacity 2", 2, 200000);
+        runRing("ring capacity 64", 64, 500000);
+        runRing("ring capacity 4096", 4096, 500000);
+    }
+    runBackend(64, 3, 50000);
+    runBackend(16384, 2, 10000);
+    if (failures)
+        return 1;
+    printf("logring_test passed\n");
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "../binlog.hpp"
+#include "../logring.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * 二进制日志解码：./bin/logdecode 日志文件 [输出文件]
+ * 输出格式：时间 级别 线程id 文件:行号 消息
+ */
+
+namespace
+{
+struct Site
+{
+    LogLevel::Level level;
+    int32_t line;
+    std::string file;
+    std::string fmt;
+};
+
+class Reader
+{
+public:
+    Reader(const std::vector<char> &data, size_t pos) : m_data(data), m_pos(pos) {}
+
+    bool eof() const { return m_pos >= m_data.size(); }
+    template <typename T>
+    bool get(T &value)
+    {
+        if (m_data.size() - m_pos < sizeof(T))
+            return false;
+        memcpy(&value, m_data.data() + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+        return true;
+    }
+    bool getBytes(size_t len, const char *&bytes)
+    {
+        if (m_data.size() - m_pos < len)
+            return false;
+        bytes = m_data.data() + m_pos;
+        m_pos += len;
+        return true;
+    }
+    bool getString(std::string &str)
+    {
+        uint16_t len;
+        const char *bytes;
+        if (!get(len) || !getBytes(len, bytes))
+            return false;
+        str.assign(bytes, len);
+        return true;
+    }
+    size_t pos() const { return m_pos; }
+
+private:
+    const std::vector<char> &m_data;
+    size_t m_pos;
+};
+
+void formatTime(uint64_t ns, char *buf, size_t size)
+{
+    time_t sec = static_cast<time_t>(ns / 1000000000);
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    size_t n = strftime(buf, size, "%Y-%m-%d %H:%M:%S", &tm);
+    snprintf(buf + n, size - n, ".%06llu", static_cast<unsigned long long>(ns % 1000000000 / 1000));
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s binlog [output]\n", argv[0]);
+        return 1;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (!in)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    std::vector<char> data;
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+        data.insert(data.end(), chunk, chunk + n);
+    fclose(in);
+
+    FILE *out = stdout;
+    if (argc > 2 && !(out = fopen(argv[2], "w")))
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    if (data.size() < sizeof(BINLOG_MAGIC) || memcmp(data.data(), BINLOG_MAGIC, sizeof(BINLOG_MAGIC)) != 0)
+    {
+        fprintf(stderr, "%s: not a binary log file\n", argv[1]);
+        return 1;
+    }
+
+    std::unordered_map<uint32_t, Site> sites;
+    Reader reader(data, sizeof(BINLOG_MAGIC));
+    uint64_t events = 0;
+    char timeBuf[64];
+    bool truncated = false;
+    while (!reader.eof() && !truncated)
+    {
+        uint8_t type;
+        reader.get(type);
+        switch (type)
+        {
+        case BINLOG_SITE:
+        {
+            uint32_t id;
+            uint8_t level;
+            Site site;
+            if (!reader.get(id) || !reader.get(level) || !reader.get(site.line) || !reader.getString(site.file) || !reader.getString(site.fmt))
+            {
+                truncated = true;
+                break;
+            }
+            site.level = static_cast<LogLevel::Level>(level);
+            sites[id] = std::move(site);
+            break;
+        }
+        case BINLOG_EVENT:
+        {
+            uint32_t id;
+            uint64_t time, threadId;
+            uint16_t argSize;
+            const char *args;
+            if (!reader.get(id) || !reader.get(time) || !reader.get(threadId) || !reader.get(argSize) || !reader.getBytes(argSize, args))
+            {
+                truncated = true;
+                break;
+            }
+            auto it = sites.find(id);
+            if (it == sites.end())
+            {
+                fprintf(stderr, "unknown site id %u at offset %zu\n", id, reader.pos());
+                continue;
+            }
+            const Site &site = it->second;
+            formatTime(time, timeBuf, sizeof(timeBuf));
+            std::string message = formatLogArgs(site.fmt.c_str(), args, argSize);
+            fprintf(out, "%s %s %llu %s:%d %s\n", timeBuf, LogLevel::toString(site.level).c_str(),
+                    static_cast<unsigned long long>(threadId), site.file.c_str(), site.line, message.c_str());
+            events++;
+            break;
+        }
+        case BINLOG_DROP:
+        {
+            uint64_t time, count;
+            if (!reader.get(time) || !reader.get(count))
+            {
+                truncated = true;
+                break;
+            }
+            formatTime(time, timeBuf, sizeof(timeBuf));
+            fprintf(out, "%s WARN log ring full, dropped %llu records\n", timeBuf, static_cast<unsigned long long>(count));
+            break;
+        }
+        default:
+            fprintf(stderr, "bad entry type 0x%02x at offset %zu\n", type, reader.pos() - 1);
+            return 1;
+        }
+    }
+    if (truncated)
+        fprintf(stderr, "warning: truncated entry at end of file (server still running or crashed?)\n");
+    if (out != stdout)
+        fclose(out);
+    fprintf(stderr, "%llu events, %zu sites\n", static_cast<unsigned long long>(events), sites.size());
+    return 0;
+}
@@ -1,9 +1,124 @@
 #include <unistd.h>
+#include <getopt.h>
 #include "server/webserver.hpp"
 
+/*
+ * ./bin/server [-t 线程数] [-a] [-r reactor的CPU] [-w 工作线程的CPU] [-i] 端口
+ *   -a  连接亲和模式
+ *   -r  reactor线程绑定的CPU，如 0
+ *   -w  工作线程绑定的CPU，如 1-11 或 auto
+ *   -i  工作线程不使用reactor所在的CPU
+ *   -c  协程模式（需要 make CORO=1 编译）
+ *   -l  日志文件，默认输出到标准输出
+ *   -v  输出DEBUG级别的日志
+ *   -b  二进制日志文件，日志不格式化直接写入，用 bin/logdecode 解码
+ *   -R  日志文件超过多少MB时滚动   -T  每隔多少秒滚动（对齐到整点）
+ *   -K  保留的历史日志文件个数（默认8） -M  预分配日志文件并通过mmap写入
+ *   -A  访问日志文件（NCSA combined格式，追加耗时字段），滚动设置与-R/-T/-K/-M相同
+ *   -J  访问日志使用JSON格式
+ *   -e  触发模式：0 监听和连接都是LT，1 连接ET，2 监听ET，3 都是ET（默认）
+ *   -s  文件用sendfile发送（默认mmap+writev）
+ *   -n  同时保持的连接数上限（默认65536），需要时提高文件描述符的软限制
+ *   -S  慢请求日志文件：超过阈值的请求连同连接的事件（排队、读、解析、写、EAGAIN）一起写入
+ *   -L  慢请求的阈值，毫秒（默认100，可以是小数）
+ *   -C  流量捕获文件：抽中的连接读到的原始请求字节和相对时间，用 bin/replay 重放
+ *   -P  捕获的连接比例（默认1，即全部）  -Z  捕获文件的上限，MB（默认1024）
+ */
 int main(int argc,char* argv[]){
-    int port = std::stoi(argv[1]);
-    WebServer server(port,3); /* 端口 ET模式 */
+    int threadNum = 12;
+    int trigMode = 3;
+    int maxConns = 0; /* 0表示使用默认值 */
+    bool connAffinity = false; /* 连接亲和模式 */
+    Placement placement;
+    bool coroutine = false; /* 协程模式 */
+    std::string logFile;
+    std::string binaryLogFile;
+    LogFileOptions logFileOptions;
+    std::string accessLogFile;
+    AccessLog::Format accessLogFormat = AccessLog::COMBINED;
+    std::string slowLogFile;
+    double slowMs = 100;
+    std::string captureFile;
+    double captureRate = 1;
+    uint64_t captureMB = 1024;
+    LogLevel::Level logLevel = LogLevel::INFO;
+    int opt;
+    while((opt = getopt(argc, argv, "t:ar:w:icl:vb:R:T:K:MA:Je:sn:S:L:C:P:Z:")) != -1) {
+        switch(opt) {
+        case 't': threadNum = std::stoi(optarg); break;
+        case 'a': connAffinity = true; break;
+        case 'r': placement.reactorCpus = optarg; break;
+        case 'w': placement.workerCpus = optarg; break;
+        case 'i': placement.isolateAcceptor = true; break;
+        case 'c': coroutine = true; break;
+        case 'l': logFile = optarg; break;
+        case 'v': logLevel = LogLevel::DEBUG; break;
+        case 'b': binaryLogFile = optarg; break;
+        case 'R': logFileOptions.rollSize = std::stoul(optarg) * 1024 * 1024; break;
+        case 'T': logFileOptions.rollInterval = std::stoi(optarg); break;
+        case 'K': logFileOptions.maxFiles = std::stoi(optarg); break;
+        case 'M': logFileOptions.useMmap = true; break;
+        case 'A': accessLogFile = optarg; break;
+        case 'J': accessLogFormat = AccessLog::JSON; break;
+        case 'e': trigMode = std::stoi(optarg); break;
+        case 's': HttpResponse::useSendfile = true; break;
+        case 'n': maxConns = std::stoi(optarg); break;
+        case 'S': slowLogFile = optarg; break;
+        case 'L': slowMs = std::stod(optarg); break;
+        case 'C': captureFile = optarg; break;
+        case 'P': captureRate = std::stod(optarg); break;
+        case 'Z': captureMB = std::stoull(optarg); break;
+        default: return 1;
+        }
+    }
+    if(threadNum < 1) {
+        fprintf(stderr, "thread count must be at least 1\n");
+        return 1;
+    }
+    if(optind >= argc) {
+        fprintf(stderr, "usage: %s [-t threads] [-a] [-r cpus] [-w cpus|auto] [-i] [-c] [-l logfile] [-v] [-b binlog] [-R MB] [-T seconds] [-K files] [-M] [-A accesslog] [-J] [-e trigmode] [-s] [-n maxconns] [-S slowlog] [-L ms] [-C capture] [-P rate] [-Z MB] port\n", argv[0]);
+        return 1;
+    }
+    int port = std::stoi(argv[optind]);
+    /* 服务器的诊断信息都经过root日志器，由后台线程批量写出 */
+    Logger::ptr logger = Logger::root();
+    AsyncLogAppender::ptr appender = std::make_shared<AsyncLogAppender>(logFile, 4 * 1024 * 1024, 8, LogOverflow::DROP, 1000, logFileOptions);
+    appender->setFormatter(std::make_shared<LogFormatter>("%d{%Y-%m-%d %H:%M:%S.%6N} %p %t %m"));
+    logger->clearAppenders();
+    logger->addAppender(appender);
+    logger->setLevel(logLevel);
+    logger->enableRing(1024, binaryLogFile); /* 工作线程只把参数写入自己的无锁环形队列 */
+    std::unique_ptr<AccessLog> accessLog;
+    if(!accessLogFile.empty()) {
+        accessLog.reset(new AccessLog(accessLogFile, accessLogFormat, logFileOptions));
+        HttpConn::accessLog = accessLog.get();
+    }
+    std::unique_ptr<SlowLog> slowLog;
+    if(!slowLogFile.empty()) {
+        slowLog.reset(new SlowLog(slowLogFile, static_cast<uint64_t>(slowMs * 1e6), logFileOptions));
+        HttpConn::slowLog = slowLog.get();
+    }
+    std::unique_ptr<TrafficCapture> capture;
+    if(!captureFile.empty()) {
+        if(captureRate <= 0 || captureRate > 1) {
+            fprintf(stderr, "capture rate must be in (0, 1]\n");
+            return 1;
+        }
+        capture.reset(new TrafficCapture(captureFile, captureRate, captureMB << 20));
+        HttpConn::capture = capture.get();
+    }
+    WebServer server(port,trigMode,threadNum,connAffinity,placement); /* 端口 触发模式 */
+    if(maxConns > 0) {
+        server.SetMaxConns(maxConns);
+    }
+    if(coroutine) {
+#ifdef USE_CORO
+        server.EnableCoroutine();
+#else
+        fprintf(stderr, "coroutine mode is not compiled in, rebuild with: make CORO=1\n");
+        return 1;
+#endif
+    }
     server._Start();
     return 0;
 }
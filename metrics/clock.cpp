@@ -0,0 +1,29 @@
+#include "clock.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+// 用CLOCK_MONOTONIC校准TSC的频率：忙等5ms，clock_gettime本身的抖动（几十纳秒）带来的误差在1e-5量级
+CheapClock::Calibration CheapClock::Calibrate_() {
+    Calibration calib = {false, 0, 0, 1.0};
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    // CPUID 0x80000007 EDX bit 8：TSC频率恒定且在深度睡眠中不停，各核之间同步
+    if(__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8))) {
+        uint64_t startNs = MonotonicNs();
+        uint64_t startTsc = __rdtsc();
+        uint64_t endNs;
+        do {
+            endNs = MonotonicNs();
+        } while(endNs - startNs < 5000000);
+        uint64_t endTsc = __rdtsc();
+        if(endTsc > startTsc) {
+            calib.useTsc = true;
+            calib.baseTsc = endTsc;
+            calib.baseNs = endNs;
+            calib.nsPerTick = static_cast<double>(endNs - startNs) / static_cast<double>(endTsc - startTsc);
+        }
+    }
+#endif
+    return calib;
+}
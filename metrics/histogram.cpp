@@ -0,0 +1,164 @@
+#include "histogram.hpp"
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+thread_local Histograms::Shard* Histograms::tlsShard_ = nullptr;
+
+namespace {
+const int STAGE_COUNT = static_cast<int>(Stage::COUNT);
+
+const char* STAGE_NAMES[STAGE_COUNT] = {"first_byte", "queue_wait", "parse", "build", "write"};
+
+// 与Metrics相同：退出的线程把计数并入retired，分片放回空闲列表复用
+struct HistogramRegistry {
+    std::mutex mutex;
+    std::vector<void*> shards;
+    std::vector<void*> freeShards;
+    HistogramSnapshot retired[STAGE_COUNT] = {};
+};
+
+HistogramRegistry& GetRegistry() {
+    static HistogramRegistry* registry = new HistogramRegistry(); // 不析构：其他线程退出时可能还会访问
+    return *registry;
+}
+
+void AppendSeconds(std::string& out, uint64_t ns) {
+    char value[32];
+    snprintf(value, sizeof(value), "%.9f", ns / 1e9);
+    out.append(value);
+}
+}
+
+// 线程退出时归还分片
+struct HistogramShardGuard {
+    Histograms::Shard* shard = nullptr;
+    ~HistogramShardGuard() {
+        if(shard) { Histograms::ReleaseShard_(shard); }
+    }
+};
+static thread_local HistogramShardGuard shardGuard;
+
+Histograms::Shard* Histograms::RegisterShard_() {
+    HistogramRegistry& registry = GetRegistry();
+    Shard* shard;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        if(!registry.freeShards.empty()) {
+            shard = static_cast<Shard*>(registry.freeShards.back());
+            registry.freeShards.pop_back();
+        } else {
+            shard = new Shard(); // 值初始化，计数全为0
+            registry.shards.push_back(shard);
+        }
+    }
+    tlsShard_ = shard;
+    shardGuard.shard = shard;
+    return shard;
+}
+
+void Histograms::ReleaseShard_(Shard* shard) {
+    HistogramRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for(int s = 0; s < STAGE_COUNT; s++) {
+        HistogramSnapshot& retired = registry.retired[s];
+        for(int i = 0; i < hdr::BUCKETS; i++) {
+            uint64_t n = shard->counts[s][i].exchange(0, std::memory_order_relaxed);
+            retired.counts[i] += n;
+            retired.count += n;
+        }
+        retired.sumNs += shard->sumNs[s].exchange(0, std::memory_order_relaxed);
+        uint64_t max = shard->maxNs[s].exchange(0, std::memory_order_relaxed);
+        if(max > retired.maxNs) { retired.maxNs = max; }
+    }
+    registry.freeShards.push_back(shard);
+    tlsShard_ = nullptr;
+}
+
+// 只读各线程的计数，写入的线程不受影响；读到的是各个桶近似同一时刻的值
+void Histograms::Snapshot(Stage stage, HistogramSnapshot& out) {
+    int s = static_cast<int>(stage);
+    HistogramRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    out = registry.retired[s];
+    for(void* p : registry.shards) {
+        Shard* shard = static_cast<Shard*>(p);
+        for(int i = 0; i < hdr::BUCKETS; i++) {
+            uint64_t n = shard->counts[s][i].load(std::memory_order_relaxed);
+            out.counts[i] += n;
+            out.count += n;
+        }
+        out.sumNs += shard->sumNs[s].load(std::memory_order_relaxed);
+        uint64_t max = shard->maxNs[s].load(std::memory_order_relaxed);
+        if(max > out.maxNs) { out.maxNs = max; }
+    }
+}
+
+// 与HdrHistogram相同，返回分位数所在桶能记录的最大值，不超过实际的最大值
+uint64_t HistogramSnapshot::Percentile(double q) const {
+    if(count == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(q * count + 0.5);
+    if(target < 1) { target = 1; }
+    if(target > count) { target = count; }
+    uint64_t seen = 0;
+    for(int i = 0; i < hdr::BUCKETS; i++) {
+        seen += counts[i];
+        if(seen >= target) {
+            uint64_t upper = hdr::BucketUpper(i);
+            return upper < maxNs ? upper : maxNs;
+        }
+    }
+    return maxNs;
+}
+
+const char* Histograms::StageName(Stage stage) {
+    return STAGE_NAMES[static_cast<int>(stage)];
+}
+
+void Histograms::RenderPrometheus(std::string& out) {
+    static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+    std::vector<HistogramSnapshot> snapshots(STAGE_COUNT); // 每个约9KB，不放在栈上
+    for(int s = 0; s < STAGE_COUNT; s++) {
+        Snapshot(static_cast<Stage>(s), snapshots[s]);
+    }
+    out.append("# HELP http_stage_duration_seconds Request lifecycle stage latency\n");
+    out.append("# TYPE http_stage_duration_seconds summary\n");
+    char line[128];
+    for(int s = 0; s < STAGE_COUNT; s++) {
+        const HistogramSnapshot& snap = snapshots[s];
+        for(double q : QUANTILES) {
+            snprintf(line, sizeof(line), "http_stage_duration_seconds{stage=\"%s\",quantile=\"%g\"} ", STAGE_NAMES[s], q);
+            out.append(line);
+            AppendSeconds(out, snap.Percentile(q));
+            out.append(1, '\n');
+        }
+        snprintf(line, sizeof(line), "http_stage_duration_seconds_sum{stage=\"%s\"} ", STAGE_NAMES[s]);
+        out.append(line);
+        AppendSeconds(out, snap.sumNs);
+        snprintf(line, sizeof(line), "\nhttp_stage_duration_seconds_count{stage=\"%s\"} %llu\n", STAGE_NAMES[s],
+                 static_cast<unsigned long long>(snap.count));
+        out.append(line);
+    }
+    out.append("# HELP http_stage_duration_max_seconds Largest observed stage latency\n");
+    out.append("# TYPE http_stage_duration_max_seconds gauge\n");
+    for(int s = 0; s < STAGE_COUNT; s++) {
+        snprintf(line, sizeof(line), "http_stage_duration_max_seconds{stage=\"%s\"} ", STAGE_NAMES[s]);
+        out.append(line);
+        AppendSeconds(out, snapshots[s].maxNs);
+        out.append(1, '\n');
+    }
+}
+
+std::string Histograms::Summary(Stage stage) {
+    std::vector<HistogramSnapshot> snap(1);
+    Snapshot(stage, snap[0]);
+    const HistogramSnapshot& h = snap[0];
+    char line[256];
+    snprintf(line, sizeof(line), "%-10s count=%llu mean=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus",
+             STAGE_NAMES[static_cast<int>(stage)], static_cast<unsigned long long>(h.count),
+             h.count ? h.sumNs / 1e3 / h.count : 0.0, h.Percentile(0.5) / 1e3, h.Percentile(0.9) / 1e3,
+             h.Percentile(0.99) / 1e3, h.Percentile(0.999) / 1e3, h.maxNs / 1e3);
+    return line;
+}
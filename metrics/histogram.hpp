@@ -0,0 +1,105 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "clock.hpp"
+
+// 请求生命周期中的各个阶段
+enum class Stage {
+    FIRST_BYTE,  // 接受连接到读到第一个字节
+    QUEUE_WAIT,  // 任务在线程池队列中等待
+    PARSE,       // 解析请求
+    BUILD,       // 生成响应（stat、mmap、拼响应头）
+    WRITE,       // 生成响应之后到写完
+    COUNT
+};
+
+// 对数-线性（HDR风格）的桶：小于2^SUB_BITS纳秒的值每纳秒一个桶，之后每个2的幂区间再等分成2^SUB_BITS个桶，
+// 相对误差不超过1/2^SUB_BITS（约3%）；超过2^MAX_BITS纳秒（约18分钟）的值记在最后一个桶
+namespace hdr {
+const int SUB_BITS = 5;
+const int SUB_COUNT = 1 << SUB_BITS;
+const int MAX_BITS = 40;
+const int BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+inline int BucketIndex(uint64_t ns) {
+    if(ns < static_cast<uint64_t>(SUB_COUNT)) {
+        return static_cast<int>(ns);
+    }
+    if(ns >= (1ULL << MAX_BITS)) {
+        return BUCKETS - 1;
+    }
+    int exp = 63 - __builtin_clzll(ns); // 最高位，不小于SUB_BITS
+    int shift = exp - SUB_BITS;
+    return (shift + 1) * SUB_COUNT + static_cast<int>((ns >> shift) - SUB_COUNT);
+}
+
+// 桶中能够记录的最大值
+inline uint64_t BucketUpper(int index) {
+    if(index < SUB_COUNT) {
+        return index;
+    }
+    int shift = index / SUB_COUNT - 1;
+    uint64_t low = static_cast<uint64_t>(SUB_COUNT + index % SUB_COUNT) << shift;
+    return low + (1ULL << shift) - 1;
+}
+}
+
+// 合并之后的一个阶段的直方图
+struct HistogramSnapshot {
+    uint64_t counts[hdr::BUCKETS];
+    uint64_t count;
+    uint64_t sumNs;
+    uint64_t maxNs;
+
+    // q在[0, 1]之间，返回纳秒；没有样本时返回0
+    uint64_t Percentile(double q) const;
+};
+
+// 各阶段的延迟直方图：每个线程一份计数（单写者，普通的加法），读取时才合并所有线程，记录不加锁、不分配内存
+class Histograms {
+public:
+    static void Record(Stage stage, uint64_t ns) {
+        Shard* shard = tlsShard_ ? tlsShard_ : RegisterShard_();
+        int s = static_cast<int>(stage);
+        Bump_(shard->counts[s][hdr::BucketIndex(ns)], 1);
+        Bump_(shard->sumNs[s], ns);
+        if(ns > shard->maxNs[s].load(std::memory_order_relaxed)) {
+            shard->maxNs[s].store(ns, std::memory_order_relaxed);
+        }
+    }
+    // 记录从startNs（CheapClock::NowNs()）到现在的耗时
+    static void RecordSince(Stage stage, uint64_t startNs) {
+        uint64_t now = CheapClock::NowNs();
+        Record(stage, now > startNs ? now - startNs : 0);
+    }
+
+    static void Snapshot(Stage stage, HistogramSnapshot& out);
+    static const char* StageName(Stage stage);
+
+    // Prometheus summary格式（分位数、_sum、_count），注册为/metrics的一部分
+    static void RenderPrometheus(std::string& out);
+    // 一个阶段的一行可读摘要：样本数、平均值、p50/p90/p99/p99.9/最大值
+    static std::string Summary(Stage stage);
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> counts[static_cast<int>(Stage::COUNT)][hdr::BUCKETS];
+        std::atomic<uint64_t> sumNs[static_cast<int>(Stage::COUNT)];
+        std::atomic<uint64_t> maxNs[static_cast<int>(Stage::COUNT)];
+    };
+
+    static void Bump_(std::atomic<uint64_t>& slot, uint64_t n) {
+        slot.store(slot.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    static Shard* RegisterShard_();
+    static void ReleaseShard_(Shard* shard);
+
+    static thread_local Shard* tlsShard_;
+    friend struct HistogramShardGuard;
+};
+
+#endif // LATENCY_HISTOGRAM_H
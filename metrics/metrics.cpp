@@ -0,0 +1,229 @@
+#include "metrics.hpp"
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+thread_local Metrics::Shard* Metrics::tlsShard_ = nullptr;
+
+namespace {
+const int COUNTER_COUNT = static_cast<int>(Counter::COUNT);
+const int GAUGE_COUNT = static_cast<int>(Gauge::COUNT);
+
+// 指标的名字、说明和标签，同名的指标连续排列，只输出一次HELP/TYPE
+struct Desc {
+    const char* name;
+    const char* help;
+    const char* labels;
+};
+
+const Desc COUNTER_DESC[COUNTER_COUNT] = {
+    {"http_requests_total", "HTTP responses by status code", "code=\"200\""},
+    {"http_requests_total", "HTTP responses by status code", "code=\"400\""},
+    {"http_requests_total", "HTTP responses by status code", "code=\"403\""},
+    {"http_requests_total", "HTTP responses by status code", "code=\"404\""},
+    {"http_requests_total", "HTTP responses by status code", "code=\"503\""},
+    {"http_requests_total", "HTTP responses by status code", "code=\"other\""},
+    {"http_received_bytes_total", "Bytes read from client sockets", ""},
+    {"http_sent_bytes_total", "Bytes written to client sockets", ""},
+    {"http_connections_accepted_total", "Accepted client connections", ""},
+    {"http_connections_closed_total", "Closed client connections", ""},
+    {"http_slow_requests_total", "Requests slower than the slow log threshold", ""},
+    {"http_conn_pauses_total", "Reads/writes paused because the thread pool rejected the task", ""},
+};
+
+const Desc GAUGE_DESC[GAUGE_COUNT] = {
+    {"http_connections_active", "Open client connections", ""},
+    {"http_buffer_bytes", "Memory held by connection read/write buffers", ""},
+    {"http_conn_objects", "Allocated connection objects, kept for reuse after close", ""},
+    {"http_conn_heap_bytes", "Heap held by request/response strings and maps of connections", ""},
+};
+
+struct Callback {
+    std::string name;
+    std::string help;
+    std::string labels;
+    const char* type;
+    std::function<double()> value;
+};
+
+// 所有分片。退出的线程把分片的值并入retired，分片放回空闲列表给新线程复用，
+// 线程池伸缩时分片数量不会无限增长
+struct Registry {
+    std::mutex mutex;
+    std::vector<void*> shards;
+    std::vector<void*> freeShards;
+    uint64_t retiredCounters[COUNTER_COUNT] = {};
+    int64_t retiredGauges[GAUGE_COUNT] = {};
+    std::vector<Callback> callbacks;
+    std::vector<std::function<void(std::string&)>> renderers;
+};
+
+Registry& GetRegistry() {
+    static Registry* registry = new Registry(); // 不析构：其他线程退出时可能还会访问
+    return *registry;
+}
+
+void AppendHeader(std::string& out, const std::string& name, const std::string& help, const char* type) {
+    out.append("# HELP ").append(name).append(1, ' ').append(help).append(1, '\n');
+    out.append("# TYPE ").append(name).append(1, ' ').append(type).append(1, '\n');
+}
+
+void AppendSample(std::string& out, const std::string& name, const std::string& labels, const char* value) {
+    out.append(name);
+    if(!labels.empty()) {
+        out.append(1, '{').append(labels).append(1, '}');
+    }
+    out.append(1, ' ').append(value).append(1, '\n');
+}
+}
+
+// 线程退出时归还分片
+struct ShardGuard {
+    Metrics::Shard* shard = nullptr;
+    ~ShardGuard() {
+        if(shard) { Metrics::ReleaseShard_(shard); }
+    }
+};
+static thread_local ShardGuard shardGuard;
+
+Metrics::Shard* Metrics::RegisterShard_() {
+    Registry& registry = GetRegistry();
+    Shard* shard;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        if(!registry.freeShards.empty()) {
+            shard = static_cast<Shard*>(registry.freeShards.back());
+            registry.freeShards.pop_back();
+        } else {
+            shard = new Shard();
+            for(auto& counter : shard->counters) { counter.store(0, std::memory_order_relaxed); }
+            for(auto& gauge : shard->gauges) { gauge.store(0, std::memory_order_relaxed); }
+            registry.shards.push_back(shard);
+        }
+    }
+    tlsShard_ = shard;
+    shardGuard.shard = shard;
+    return shard;
+}
+
+void Metrics::ReleaseShard_(Shard* shard) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for(int i = 0; i < COUNTER_COUNT; i++) {
+        registry.retiredCounters[i] += shard->counters[i].exchange(0, std::memory_order_relaxed);
+    }
+    for(int i = 0; i < GAUGE_COUNT; i++) {
+        registry.retiredGauges[i] += shard->gauges[i].exchange(0, std::memory_order_relaxed);
+    }
+    registry.freeShards.push_back(shard);
+    tlsShard_ = nullptr;
+}
+
+void Metrics::AddRequest(int status) {
+    switch(status) {
+    case 200: Add(Counter::REQUESTS_200); break;
+    case 400: Add(Counter::REQUESTS_400); break;
+    case 403: Add(Counter::REQUESTS_403); break;
+    case 404: Add(Counter::REQUESTS_404); break;
+    case 503: Add(Counter::REQUESTS_503); break;
+    default: Add(Counter::REQUESTS_OTHER); break;
+    }
+}
+
+uint64_t Metrics::Get(Counter counter) {
+    int i = static_cast<int>(counter);
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    uint64_t sum = registry.retiredCounters[i];
+    for(void* p : registry.shards) {
+        sum += static_cast<Shard*>(p)->counters[i].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+int64_t Metrics::Get(Gauge gauge) {
+    int i = static_cast<int>(gauge);
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    int64_t sum = registry.retiredGauges[i];
+    for(void* p : registry.shards) {
+        sum += static_cast<Shard*>(p)->gauges[i].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void Metrics::RegisterGauge(const std::string& name, const std::string& help, const std::string& labels,
+                            std::function<double()> value) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.callbacks.push_back({name, help, labels, "gauge", std::move(value)});
+}
+
+void Metrics::RegisterCounter(const std::string& name, const std::string& help, const std::string& labels,
+                              std::function<double()> value) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.callbacks.push_back({name, help, labels, "counter", std::move(value)});
+}
+
+void Metrics::RegisterRenderer(std::function<void(std::string&)> renderer) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.renderers.push_back(std::move(renderer));
+}
+
+std::string Metrics::RenderPrometheus() {
+    uint64_t counters[COUNTER_COUNT];
+    int64_t gauges[GAUGE_COUNT];
+    std::vector<Callback> callbacks;
+    std::vector<std::function<void(std::string&)>> renderers;
+    Registry& registry = GetRegistry();
+    {
+        // 只在这里持有注册表的锁：写入指标的线程不加锁，不受影响
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for(int i = 0; i < COUNTER_COUNT; i++) { counters[i] = registry.retiredCounters[i]; }
+        for(int i = 0; i < GAUGE_COUNT; i++) { gauges[i] = registry.retiredGauges[i]; }
+        for(void* p : registry.shards) {
+            Shard* shard = static_cast<Shard*>(p);
+            for(int i = 0; i < COUNTER_COUNT; i++) { counters[i] += shard->counters[i].load(std::memory_order_relaxed); }
+            for(int i = 0; i < GAUGE_COUNT; i++) { gauges[i] += shard->gauges[i].load(std::memory_order_relaxed); }
+        }
+        callbacks = registry.callbacks;
+        renderers = registry.renderers;
+    }
+
+    std::string out;
+    char value[32];
+    const char* last = "";
+    for(int i = 0; i < COUNTER_COUNT; i++) {
+        const Desc& desc = COUNTER_DESC[i];
+        if(std::string(last) != desc.name) {
+            AppendHeader(out, desc.name, desc.help, "counter");
+            last = desc.name;
+        }
+        snprintf(value, sizeof(value), "%llu", static_cast<unsigned long long>(counters[i]));
+        AppendSample(out, desc.name, desc.labels, value);
+    }
+    for(int i = 0; i < GAUGE_COUNT; i++) {
+        const Desc& desc = GAUGE_DESC[i];
+        AppendHeader(out, desc.name, desc.help, "gauge");
+        snprintf(value, sizeof(value), "%lld", static_cast<long long>(gauges[i]));
+        AppendSample(out, desc.name, desc.labels, value);
+    }
+    // 同名的指标必须连续输出，按第一次注册的顺序分组
+    std::vector<bool> done(callbacks.size(), false);
+    for(size_t i = 0; i < callbacks.size(); i++) {
+        if(done[i]) { continue; }
+        AppendHeader(out, callbacks[i].name, callbacks[i].help, callbacks[i].type);
+        for(size_t j = i; j < callbacks.size(); j++) {
+            if(done[j] || callbacks[j].name != callbacks[i].name) { continue; }
+            snprintf(value, sizeof(value), "%.17g", callbacks[j].value());
+            AppendSample(out, callbacks[j].name, callbacks[j].labels, value);
+            done[j] = true;
+        }
+    }
+    for(auto& renderer : renderers) {
+        renderer(out);
+    }
+    return out;
+}
@@ -0,0 +1,82 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// 计数器：只增不减
+enum class Counter {
+    REQUESTS_200,
+    REQUESTS_400,
+    REQUESTS_403,
+    REQUESTS_404,
+    REQUESTS_503,
+    REQUESTS_OTHER,
+    BYTES_IN,
+    BYTES_OUT,
+    ACCEPTS,
+    CLOSES,
+    SLOW_REQUESTS,
+    CONN_PAUSES,
+    COUNT
+};
+
+// 仪表：可增可减，各线程分片中保存的是增量，求和之后才是当前值
+enum class Gauge {
+    ACTIVE_CONNS,
+    BUFFER_BYTES,
+    CONN_OBJECTS,    // HttpConn对象，连接关闭后对象留给复用同一个fd的连接
+    CONN_HEAP_BYTES, // 连接的请求/响应中字符串和哈希表占用的堆内存
+    COUNT
+};
+
+// 指标：每个线程一个按缓存行对齐的分片，热路径上只对自己的分片做一次普通的加法（单写者，没有lock前缀的原子指令），
+// 不同线程之间没有缓存行的争用；只有抓取（/metrics）时才遍历所有分片求和，抓取只读分片，不影响写入
+class Metrics {
+public:
+    static void Add(Counter counter, uint64_t n = 1) {
+        std::atomic<uint64_t>& slot = LocalShard_()->counters[static_cast<int>(counter)];
+        slot.store(slot.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    static void Add(Gauge gauge, int64_t delta) {
+        std::atomic<int64_t>& slot = LocalShard_()->gauges[static_cast<int>(gauge)];
+        slot.store(slot.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+    // 按响应状态码计数
+    static void AddRequest(int status);
+
+    // 汇总所有线程的分片
+    static uint64_t Get(Counter counter);
+    static int64_t Get(Gauge gauge);
+
+    // 抓取时才求值的指标（如线程池队列长度），labels形如 lane="io"，可以为空
+    static void RegisterGauge(const std::string& name, const std::string& help, const std::string& labels,
+                              std::function<double()> value);
+    static void RegisterCounter(const std::string& name, const std::string& help, const std::string& labels,
+                                std::function<double()> value);
+    // 其他模块（如直方图）追加到抓取结果中的文本
+    static void RegisterRenderer(std::function<void(std::string&)> renderer);
+
+    // Prometheus文本格式
+    static std::string RenderPrometheus();
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> counters[static_cast<int>(Counter::COUNT)];
+        std::atomic<int64_t> gauges[static_cast<int>(Gauge::COUNT)];
+    };
+
+    static Shard* LocalShard_() {
+        Shard* shard = tlsShard_;
+        return shard ? shard : RegisterShard_();
+    }
+    static Shard* RegisterShard_();
+    static void ReleaseShard_(Shard* shard);
+
+    static thread_local Shard* tlsShard_;
+    friend struct ShardGuard;
+};
+
+#endif // METRICS_H
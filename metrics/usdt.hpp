@@ -0,0 +1,88 @@
+#ifndef USDT_PROBES_H
+#define USDT_PROBES_H
+
+// USDT静态探针：TRACE_PROBE(提供者, 名字, 参数1, ... 参数6)。
+// 默认编译为空；make USDT=1 时在该位置放一条nop，并在ELF的.note.stapsdt段中记录探针的位置和参数所在的寄存器/内存，
+// 没有附加的时候只多执行一条nop，参数也只是保留在寄存器中；bpftrace/perf/bcc附加时才把nop换成断点：
+//   bpftrace -e 'usdt:./bin/server:webserver:response_ready { @[arg1] = count(); }'
+//   readelf -n bin/server    # 列出所有探针
+// 有<sys/sdt.h>（systemtap-sdt-dev）时使用它，否则使用下面与它格式相同的实现（GCC/Clang，x86-64和AArch64）
+#ifdef USE_USDT
+
+#define USDT_NARG_(_1, _2, _3, _4, _5, _6, N, ...) N
+#define USDT_NARG(...) USDT_NARG_(__VA_ARGS__, 6, 5, 4, 3, 2, 1)
+#define USDT_CAT_(a, b) a##b
+#define USDT_CAT(a, b) USDT_CAT_(a, b)
+#define TRACE_PROBE(provider, name, ...) USDT_CAT(USDT_PROBE_, USDT_NARG(__VA_ARGS__))(provider, name, __VA_ARGS__)
+
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define USDT_PROBE_1(p, n, a1) STAP_PROBE1(p, n, a1)
+#define USDT_PROBE_2(p, n, a1, a2) STAP_PROBE2(p, n, a1, a2)
+#define USDT_PROBE_3(p, n, a1, a2, a3) STAP_PROBE3(p, n, a1, a2, a3)
+#define USDT_PROBE_4(p, n, a1, a2, a3, a4) STAP_PROBE4(p, n, a1, a2, a3, a4)
+#define USDT_PROBE_5(p, n, a1, a2, a3, a4, a5) STAP_PROBE5(p, n, a1, a2, a3, a4, a5)
+#define USDT_PROBE_6(p, n, a1, a2, a3, a4, a5, a6) STAP_PROBE6(p, n, a1, a2, a3, a4, a5, a6)
+
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+#include <type_traits>
+
+// 参数描述 "大小@位置"，有符号的类型大小为负数：%n输出常量的相反数
+#define USDT_SIZE_(x) ((std::is_signed<typename std::decay<decltype(x)>::type>::value ? 1 : -1) * static_cast<int>(sizeof(x)))
+#define USDT_FMT_(i) "%n[s" #i "]@%[a" #i "]"
+#define USDT_OP_(i, x) [s##i] "n"(USDT_SIZE_(x)), [a##i] "nor"(x)
+
+// 与sys/sdt.h相同的note格式：探针地址、基准地址（用于prelink之后修正）、信号量（不使用）、提供者、名字、参数
+#define USDT_ASM_(provider, name, args, ...)                                                   \
+    __asm__ __volatile__("990: nop\n"                                                          \
+                         ".pushsection .note.stapsdt,\"?\",\"note\"\n"                         \
+                         ".balign 4\n"                                                         \
+                         ".4byte 992f-991f, 994f-993f, 3\n"                                    \
+                         "991: .asciz \"stapsdt\"\n"                                           \
+                         "992: .balign 4\n"                                                    \
+                         "993: .8byte 990b\n"                                                  \
+                         ".8byte _.stapsdt.base\n"                                             \
+                         ".8byte 0\n"                                                          \
+                         ".asciz \"" #provider "\"\n"                                          \
+                         ".asciz \"" #name "\"\n"                                              \
+                         ".asciz \"" args "\"\n"                                               \
+                         "994: .balign 4\n"                                                    \
+                         ".popsection\n"                                                       \
+                         ".ifndef _.stapsdt.base\n"                                            \
+                         ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+                         ".weak _.stapsdt.base\n"                                              \
+                         ".hidden _.stapsdt.base\n"                                            \
+                         "_.stapsdt.base: .space 1\n"                                          \
+                         ".size _.stapsdt.base, 1\n"                                           \
+                         ".popsection\n"                                                       \
+                         ".endif\n"                                                            \
+                         :                                                                     \
+                         : __VA_ARGS__)
+
+#define USDT_PROBE_1(p, n, a1) USDT_ASM_(p, n, USDT_FMT_(1), USDT_OP_(1, a1))
+#define USDT_PROBE_2(p, n, a1, a2) \
+    USDT_ASM_(p, n, USDT_FMT_(1) " " USDT_FMT_(2), USDT_OP_(1, a1), USDT_OP_(2, a2))
+#define USDT_PROBE_3(p, n, a1, a2, a3) \
+    USDT_ASM_(p, n, USDT_FMT_(1) " " USDT_FMT_(2) " " USDT_FMT_(3), USDT_OP_(1, a1), USDT_OP_(2, a2), USDT_OP_(3, a3))
+#define USDT_PROBE_4(p, n, a1, a2, a3, a4)                                                     \
+    USDT_ASM_(p, n, USDT_FMT_(1) " " USDT_FMT_(2) " " USDT_FMT_(3) " " USDT_FMT_(4), USDT_OP_(1, a1), \
+              USDT_OP_(2, a2), USDT_OP_(3, a3), USDT_OP_(4, a4))
+#define USDT_PROBE_5(p, n, a1, a2, a3, a4, a5)                                                 \
+    USDT_ASM_(p, n, USDT_FMT_(1) " " USDT_FMT_(2) " " USDT_FMT_(3) " " USDT_FMT_(4) " " USDT_FMT_(5), \
+              USDT_OP_(1, a1), USDT_OP_(2, a2), USDT_OP_(3, a3), USDT_OP_(4, a4), USDT_OP_(5, a5))
+#define USDT_PROBE_6(p, n, a1, a2, a3, a4, a5, a6)                                             \
+    USDT_ASM_(p, n, USDT_FMT_(1) " " USDT_FMT_(2) " " USDT_FMT_(3) " " USDT_FMT_(4) " " USDT_FMT_(5) " " USDT_FMT_(6), \
+              USDT_OP_(1, a1), USDT_OP_(2, a2), USDT_OP_(3, a3), USDT_OP_(4, a4), USDT_OP_(5, a5), USDT_OP_(6, a6))
+
+#else
+#error "USDT probes need <sys/sdt.h> (systemtap-sdt-dev) on this platform"
+#endif
+
+#else
+// 不求值参数，只保留类型检查，只在探针中使用的变量也不会产生未使用的警告
+template <typename... T>
+inline void UsdtUnused_(const T&...) {}
+#define TRACE_PROBE(provider, name, ...) do { if(false) { UsdtUnused_(__VA_ARGS__); } } while(0)
+#endif
+
+#endif // USDT_PROBES_H
@@ -0,0 +1,138 @@
+#include "coroutine.hpp"
+
+#ifdef USE_CORO
+
+#include <chrono>
+#include <new>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+thread_local FramePool::FreeNode* FramePool::freeList_[FramePool::CLASS_COUNT];
+
+void* FramePool::Allocate(size_t size) {
+    if(size > MAX_POOLED) { return ::operator new(size); }
+    size_t cls = (size - 1) / ALIGN;
+    FreeNode* node = freeList_[cls];
+    if(node) {
+        freeList_[cls] = node->next;
+        return node;
+    }
+    return ::operator new((cls + 1) * ALIGN);
+}
+
+void FramePool::Free(void* ptr, size_t size) {
+    if(size > MAX_POOLED) {
+        ::operator delete(ptr);
+        return;
+    }
+    size_t cls = (size - 1) / ALIGN;
+    FreeNode* node = static_cast<FreeNode*>(ptr);
+    node->next = freeList_[cls];
+    freeList_[cls] = node;
+}
+
+static int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CoScheduler::CoScheduler(Epoller* epoller, uint32_t connEvent) :
+    epoller_(epoller), connEvent_(connEvent), nextSeq_(0) {
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(wakeFd_ >= 0);
+    epoller_->AddFd(wakeFd_, EPOLLIN);
+}
+
+CoScheduler::~CoScheduler() {
+    epoller_->DelFd(wakeFd_);
+    close(wakeFd_);
+}
+
+/* 登记等待并重新注册EPOLLONESHOT事件，事件到来时由OnEvent恢复 */
+void CoScheduler::Arm_(int fd, uint32_t events, int timeoutMs, std::coroutine_handle<> handle, bool* result) {
+    uint64_t seq = ++nextSeq_;
+    int64_t deadline = timeoutMs >= 0 ? NowMs() + timeoutMs : -1;
+    waiters_[fd] = Waiter{handle, result, seq, deadline};
+    if(deadline >= 0) {
+        timers_.push(Timer{deadline, fd, seq});
+        CompactTimers_();
+    }
+    epoller_->ModFd(fd, connEvent_ | events);
+}
+
+/* 每次等待都会压入一个定时器，已经恢复的等待留下的定时器过多时重建堆 */
+void CoScheduler::CompactTimers_() {
+    if(timers_.size() <= 2 * waiters_.size() + 1024) { return; }
+    std::vector<Timer> live;
+    live.reserve(waiters_.size());
+    for(auto& entry : waiters_) {
+        if(entry.second.deadline >= 0) {
+            live.push_back(Timer{entry.second.deadline, entry.first, entry.second.seq});
+        }
+    }
+    timers_ = decltype(timers_)(std::greater<Timer>(), std::move(live));
+}
+
+void CoScheduler::Resume_(int fd, bool ok) {
+    auto it = waiters_.find(fd);
+    if(it == waiters_.end()) { return; }
+    Waiter waiter = it->second;
+    waiters_.erase(it);
+    *waiter.result = ok;
+    waiter.handle.resume();
+}
+
+void CoScheduler::OnEvent(int fd, uint32_t events) {
+    Resume_(fd, !(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)));
+}
+
+void CoScheduler::Post(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard<std::mutex> lock(readyMtx_);
+        ready_.push_back(handle);
+    }
+    uint64_t one = 1;
+    ssize_t ret = ::write(wakeFd_, &one, sizeof(one));
+    (void)ret;
+}
+
+void CoScheduler::OnWake() {
+    uint64_t count;
+    ssize_t ret = ::read(wakeFd_, &count, sizeof(count));
+    (void)ret;
+    std::vector<std::coroutine_handle<>> ready;
+    {
+        std::lock_guard<std::mutex> lock(readyMtx_);
+        ready.swap(ready_);
+    }
+    for(auto handle : ready) {
+        handle.resume();
+    }
+}
+
+/* 定时器对应的等待已经结束：fd上没有等待，或者已经是之后的一次等待 */
+bool CoScheduler::IsStale_(const Timer& timer) const {
+    auto it = waiters_.find(timer.fd);
+    return it == waiters_.end() || it->second.seq != timer.seq;
+}
+
+/* 先弹出堆顶过期的定时器，否则已经恢复的等待会让epoll_wait提前醒来 */
+int CoScheduler::NextTimeout() {
+    while(!timers_.empty() && IsStale_(timers_.top())) { timers_.pop(); }
+    if(timers_.empty()) { return -1; }
+    int64_t left = timers_.top().deadline - NowMs();
+    return left > 0 ? static_cast<int>(left) : 0;
+}
+
+void CoScheduler::ExpireTimers() {
+    int64_t now = NowMs();
+    while(!timers_.empty() && timers_.top().deadline <= now) {
+        Timer timer = timers_.top();
+        timers_.pop();
+        if(!IsStale_(timer)) {
+            Resume_(timer.fd, false);
+        }
+    }
+}
+
+#endif // USE_CORO
@@ -0,0 +1,136 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+/* 协程模式（make CORO=1，需要C++20）：每个连接是一个协程，在reactor线程上co_await读写就绪 */
+#ifdef USE_CORO
+
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#include "epoller.hpp"
+#include "../threadpool/executor.hpp"
+
+/* 协程帧的内存池：按64字节分档的空闲链表，只在reactor线程上分配和释放，不需要加锁 */
+class FramePool {
+public:
+    static void* Allocate(size_t size);
+    static void Free(void* ptr, size_t size);
+
+private:
+    static const size_t ALIGN = 64;
+    static const size_t MAX_POOLED = 4096; // 超过该大小的帧直接使用operator new
+    static const size_t CLASS_COUNT = MAX_POOLED / ALIGN;
+
+    struct FreeNode { FreeNode* next; };
+    static thread_local FreeNode* freeList_[CLASS_COUNT];
+};
+
+/* 连接协程的返回类型：创建后立即运行，结束时自动销毁协程帧，不需要调用者持有句柄 */
+struct ConnTask {
+    struct promise_type {
+        ConnTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size) { return FramePool::Allocate(size); }
+        static void operator delete(void* ptr, size_t size) { FramePool::Free(ptr, size); }
+    };
+};
+
+/* 协程调度器：记录每个文件描述符上等待的协程，epoll事件、超时或取消时在reactor线程上恢复它 */
+class CoScheduler {
+public:
+    CoScheduler(Epoller* epoller, uint32_t connEvent);
+    ~CoScheduler();
+
+    /* 等待可读/可写，结果为false表示连接出错、超时或被取消 */
+    struct IoAwaiter {
+        CoScheduler* scheduler;
+        int fd;
+        uint32_t events;
+        int timeoutMs;
+        bool ok = false;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { scheduler->Arm_(fd, events, timeoutMs, handle, &ok); }
+        bool await_resume() const noexcept { return ok; }
+    };
+
+    /* 把func交给执行器的车道执行，完成后回到reactor线程继续；结果为false表示车道已满，func没有执行 */
+    template <typename F>
+    struct OffloadAwaiter {
+        CoScheduler* scheduler;
+        Executor* executor;
+        Lane lane;
+        F func;
+        bool posted = false;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            posted = executor->post(lane, [this, handle]() {
+                func();
+                scheduler->Post(handle); //之后不能再访问this，协程可能已经恢复
+            });
+            return posted; //提交失败时不挂起
+        }
+        bool await_resume() const noexcept { return posted; }
+    };
+
+    IoAwaiter Readable(int fd, int timeoutMs) { return IoAwaiter{this, fd, EPOLLIN, timeoutMs}; }
+    IoAwaiter Writable(int fd, int timeoutMs) { return IoAwaiter{this, fd, EPOLLOUT, timeoutMs}; }
+    template <typename F>
+    OffloadAwaiter<F> Offload(Executor& executor, Lane lane, F func) {
+        return OffloadAwaiter<F>{this, &executor, lane, std::move(func)};
+    }
+
+    /* 以下接口只在reactor线程调用 */
+    int WakeFd() const { return wakeFd_; }
+    void OnEvent(int fd, uint32_t events); //fd上有事件，恢复等待的协程
+    void OnWake();                         //恢复其他线程交回来的协程
+    int NextTimeout();                     //距离最近的超时还有多少毫秒，没有定时器时返回-1
+    void ExpireTimers();                   //恢复所有已经超时的协程
+
+    /* 任意线程：把协程交回reactor线程恢复 */
+    void Post(std::coroutine_handle<> handle);
+
+private:
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        bool* result;
+        uint64_t seq;
+        int64_t deadline; // -1表示不超时
+    };
+    struct Timer {
+        int64_t deadline;
+        int fd;
+        uint64_t seq;
+        bool operator>(const Timer& other) const { return deadline > other.deadline; }
+    };
+
+    void Arm_(int fd, uint32_t events, int timeoutMs, std::coroutine_handle<> handle, bool* result);
+    void Resume_(int fd, bool ok);
+    void CompactTimers_();
+    bool IsStale_(const Timer& timer) const;
+
+    Epoller* epoller_;
+    uint32_t connEvent_;
+    uint64_t nextSeq_;
+    std::unordered_map<int, Waiter> waiters_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_; //过期的定时器按seq判断，惰性删除
+
+    int wakeFd_; //eventfd，工作线程交回协程时唤醒epoll_wait
+    std::mutex readyMtx_;
+    std::vector<std::coroutine_handle<>> ready_;
+};
+
+#endif // USE_CORO
+
+#endif // COROUTINE_H
@@ -2,14 +2,45 @@
 
 using namespace std;
 
+int WebServer::dumpFd_ = -1;
+
 WebServer::WebServer(
-	int port, int trigMode) :
-	port_(port), isClose_(false),
-	threadpool_(new Threadpool()), epoller_(new Epoller())
+	int port, int trigMode, int threadNum, bool connAffinity, const Placement& placement) :
+	port_(port), isClose_(false), idleFd_(-1), maxConns_(MAX_FD), threadNum_(std::max(threadNum, 1)), connAffinity_(connAffinity), nextWorker_(0),
+	executor_(new Executor()), epoller_(new Epoller()), pauseWarnNs_(0), pausesSinceWarn_(0)
 {
-    threadpool_->setMode(Mode::VARIABLE);
-    threadpool_->setThreadCountThreshold(24);
-    threadpool_->start(12);
+    std::vector<int> workerCpus = resolveWorkerCpus(placement); //工作线程绑定CPU
+    /* 请求处理车道和IO车道：处理每个连接的读写事件 */
+    for(Lane lane : {Lane::REQUEST, Lane::IO}) {
+        Threadpool& pool = executor_->lane(lane);
+        if(connAffinity_) {
+            //亲和模式需要每个工作线程有自己的队列
+            pool.setMode(Mode::STEALING);
+            pool.setAffinitySpill(AFFINITY_SPILL);
+        } else {
+            pool.setMode(Mode::VARIABLE);
+            pool.setThreadCountThreshold(threadNum_ * 2);
+        }
+        pool.setTaskQueueThreshold(MAX_TASK_QUEUE);
+        pool.setOverloadPolicy(Overload::REJECT); //队列满时不排队，暂停该连接的读写
+        pool.setCpuPlacement(workerCpus);
+    }
+    executor_->setConcurrency(Lane::REQUEST, threadNum_);
+    executor_->setConcurrency(Lane::IO, std::max(threadNum_ / 2, 2));
+    /* 阻塞车道：并发数量小、优先级低，CPU密集的请求再多也只占用这几个线程 */
+    Threadpool& blocking = executor_->lane(Lane::BLOCKING);
+    blocking.setMode(Mode::FIXED);
+    blocking.setTaskQueueThreshold(MAX_TASK_QUEUE);
+    blocking.setOverloadPolicy(Overload::REJECT);
+    blocking.setCpuPlacement(workerCpus);
+    executor_->setPriority(Lane::BLOCKING, BLOCKING_NICE);
+    executor_->setConcurrency(Lane::BLOCKING, std::max(threadNum_ / 4, 2));
+    executor_->start();
+    RegisterMetrics_();
+    //当前线程就是reactor线程，在工作线程创建之后再绑定，避免工作线程继承reactor的CPU掩码
+    if(!placement.reactorCpus.empty() && !pinCurrentThread(Topology::parseCpuList(placement.reactorCpus))) {
+        LOG_ERROR("Pin reactor to cpu %s failed!", placement.reactorCpus.c_str());
+    }
 	srcDir_ = getcwd(nullptr, 256); //获取当前的工作路径
 	assert(srcDir_);
 	strncat(srcDir_, "/resources/", 16); //c语言追加字符串函数
@@ -19,26 +50,181 @@ WebServer::WebServer(
 	InitEventMode_(trigMode);//设置ET模式
     //初始化套接字
     if(!InitSocket_()) { isClose_ = true;}
+    signal(SIGPIPE, SIG_IGN); //客户端在响应写完之前关闭连接时，writev/sendfile返回EPIPE，不终止进程
+    InitDumpSignal_();
+    RaiseFdLimit_();
+    idleFd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+void WebServer::SetMaxConns(int maxConns) {
+    maxConns_ = maxConns;
+    RaiseFdLimit_();
+}
+
+/* 默认的软限制（通常1024）远小于连接数上限：提高到上限需要的数量，硬限制不够时按硬限制减少上限 */
+void WebServer::RaiseFdLimit_() {
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+        return;
+    }
+    rlim_t want = static_cast<rlim_t>(maxConns_) + RESERVED_FDS;
+    if(limit.rlim_cur < want) {
+        limit.rlim_cur = limit.rlim_max == RLIM_INFINITY ? want : std::min(want, limit.rlim_max);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if(limit.rlim_cur < want) {
+        maxConns_ = static_cast<int>(limit.rlim_cur) - RESERVED_FDS;
+        LOG_WARN("RLIMIT_NOFILE hard limit is %d, max connections reduced to %d", (int)limit.rlim_max, maxConns_);
+    }
+}
+
+/* 文件描述符用完（EMFILE）时监听套接字一直可读，LT模式下reactor会空转：用预留的描述符接受连接并立即关闭 */
+bool WebServer::RejectOverLimit_() {
+    if(idleFd_ < 0) {
+        return false;
+    }
+    close(idleFd_);
+    int fd = accept(listenFd_, nullptr, nullptr);
+    if(fd >= 0) {
+        close(fd);
+    }
+    idleFd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    LOG_WARN("Out of file descriptors, connection rejected!");
+    return fd >= 0;
+}
+
+namespace {
+/* 进程的常驻内存：/proc/self/statm的第二个字段（页） */
+double ResidentBytes() {
+    long pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if(statm) {
+        if(fscanf(statm, "%*s %ld", &pages) != 1) { pages = 0; }
+        fclose(statm);
+    }
+    return static_cast<double>(pages) * sysconf(_SC_PAGESIZE);
+}
+
+/* malloc已经分配出去的字节数（所有arena） */
+double HeapInUseBytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return static_cast<double>(mallinfo2().uordblks);
+#elif defined(__GLIBC__)
+    return static_cast<double>(static_cast<unsigned int>(mallinfo().uordblks));
+#else
+    return 0;
+#endif
+}
+
+/* 连接占用的内存：对象、读写缓冲区、请求/响应的堆内存 */
+double ConnMemoryBytes() {
+    return static_cast<double>(Metrics::Get(Gauge::CONN_OBJECTS)) * HttpConn::ObjectBytes() +
+           Metrics::Get(Gauge::BUFFER_BYTES) + Metrics::Get(Gauge::CONN_HEAP_BYTES);
+}
+}
+
+//各车道线程池的状态在抓取/metrics时才读取；WebServer与进程同生命周期
+void WebServer::RegisterMetrics_() {
+    for(Lane lane : {Lane::IO, Lane::REQUEST, Lane::BLOCKING}) {
+        Threadpool* pool = &executor_->lane(lane);
+        std::string labels = std::string("lane=\"") + Executor::laneName(lane) + "\"";
+        Metrics::RegisterGauge("threadpool_queue_depth", "Tasks waiting in the lane queue", labels,
+                               [pool] { return static_cast<double>(pool->queuedTasks()); });
+        Metrics::RegisterGauge("threadpool_threads", "Worker threads in the lane", labels,
+                               [pool] { return static_cast<double>(pool->threadCount()); });
+        Metrics::RegisterGauge("threadpool_idle_threads", "Idle worker threads in the lane", labels,
+                               [pool] { return static_cast<double>(pool->idleThreadCount()); });
+        Metrics::RegisterCounter("threadpool_rejected_total", "Tasks rejected because the lane queue was full", labels,
+                                 [pool] { return static_cast<double>(pool->rejectedTasks()); });
+    }
+    Metrics::RegisterGauge("http_connections_max", "Connection limit", "",
+                           [this] { return static_cast<double>(maxConns_); });
+    Metrics::RegisterGauge("http_conn_memory_bytes", "Connection objects, buffers and request/response heap", "",
+                           ConnMemoryBytes);
+    Metrics::RegisterGauge("process_resident_memory_bytes", "Resident set size", "", ResidentBytes);
+    Metrics::RegisterGauge("process_heap_bytes", "Bytes allocated by malloc", "", HeapInUseBytes);
+    Metrics::RegisterRenderer(Histograms::RenderPrometheus);
+}
+
+/* kill -USR1 输出各阶段的延迟直方图和连接的内存统计：信号可能落在任意线程上，处理函数只写eventfd（异步信号安全），由reactor线程输出 */
+void WebServer::InitDumpSignal_() {
+    dumpFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(dumpFd_ < 0) {
+        LOG_ERROR("Create dump eventfd error!");
+        return;
+    }
+    epoller_->AddFd(dumpFd_, EPOLLIN);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = OnDumpSignal_;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, nullptr);
+}
+
+void WebServer::OnDumpSignal_(int) {
+    int savedErrno = errno;
+    uint64_t one = 1;
+    ssize_t ret = ::write(dumpFd_, &one, sizeof(one));
+    (void)ret;
+    errno = savedErrno;
+}
+
+void WebServer::DumpStats_() {
+    uint64_t count;
+    ssize_t ret = ::read(dumpFd_, &count, sizeof(count));
+    (void)ret;
+    LOG_INFO("Stage latency histograms (clock: %s):", CheapClock::Source());
+    for(int s = 0; s < static_cast<int>(Stage::COUNT); s++) {
+        LOG_INFO("%s", Histograms::Summary(static_cast<Stage>(s)).c_str());
+    }
+    int64_t objects = Metrics::Get(Gauge::CONN_OBJECTS);
+    LOG_INFO("Connections: active=%lld objects=%lld max=%d, memory: object=%zuB buffers=%lldB heap=%lldB "
+             "per object=%.0fB, process rss=%.1fMB heap=%.1fMB",
+             (long long)Metrics::Get(Gauge::ACTIVE_CONNS), (long long)objects, maxConns_, HttpConn::ObjectBytes(),
+             (long long)Metrics::Get(Gauge::BUFFER_BYTES), (long long)Metrics::Get(Gauge::CONN_HEAP_BYTES),
+             objects > 0 ? ConnMemoryBytes() / objects : 0.0, ResidentBytes() / 1048576, HeapInUseBytes() / 1048576);
 }
 
 WebServer::~WebServer() {
     close(listenFd_);
+    if(idleFd_ >= 0) { close(idleFd_); }
+    if(dumpFd_ >= 0) {
+        signal(SIGUSR1, SIG_DFL);
+        close(dumpFd_);
+        dumpFd_ = -1;
+    }
     isClose_ = true;
     free(srcDir_);   //动态分配的
 }
 
 void WebServer::_Start() {
     int timeMS = -1;  /* epoll wait的timeout == -1 无事件将阻塞 */
-    if(!isClose_) { cout << "========== Server start =========="<<endl; }
+    if(!isClose_) { LOG_INFO("========== Server start =========="); }
     while(!isClose_) {
+        /* 有暂停的连接时定时醒来重新提交任务 */
+        timeMS = pausedConns_.empty() ? -1 : PAUSE_RETRY_MS;
+#ifdef USE_CORO
+        if(scheduler_) { timeMS = scheduler_->NextTimeout(); } /* 最近的协程超时 */
+#endif
         int eventCnt = epoller_->Wait(timeMS);//返回值是 检测到有多少个事件发生 
         //cout<<"eventCnt:"<<eventCnt<<endl;
         for(int i = 0; i < eventCnt; i++) {
             /* 处理事件 */
             int fd = epoller_->GetEventFd(i); 
             uint32_t events = epoller_->GetEvents(i);
+            if(fd == dumpFd_) {
+                DumpStats_();
+                continue;
+            }
+#ifdef USE_CORO
+            if(scheduler_ && fd != listenFd_) {
+                DealCoEvent_(fd, events);
+                continue;
+            }
+#endif
             
-            cout<<"判断事件的文件描述符"<<endl;
+            LOG_DEBUG("判断事件的文件描述符 fd:%d events:%u", fd, events);
             if(fd == listenFd_) {    //新的请求建立连接
                 DealListen_();
             }
@@ -55,9 +241,13 @@ void WebServer::_Start() {
                 DealWrite_(&users_[fd]);
             } 
             else {
-                cout<<"Unexpected event"<<endl;
+                LOG_ERROR("Unexpected event");
             }
         }
+        ResumePaused_();
+#ifdef USE_CORO
+        if(scheduler_) { scheduler_->ExpireTimers(); }
+#endif
     }
 }
 
@@ -65,7 +255,7 @@ void WebServer::_Start() {
 bool WebServer::InitSocket_() {
     struct sockaddr_in addr;
     if(port_ > 65535 || port_ < 1024) {
-        cout<<"Port:"<<port_<<"error!"<<endl;
+        LOG_ERROR("Port:%d error!", port_);
         return false;
     }
     addr.sin_family = AF_INET;
@@ -74,7 +264,7 @@ bool WebServer::InitSocket_() {
 
     listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
     if(listenFd_ < 0) {
-        cout<<"Create socket error!"<<" "<<port_<<endl;
+        LOG_ERROR("Create socket error! %d", port_);
         return false;
     }
 
@@ -84,34 +274,34 @@ bool WebServer::InitSocket_() {
     /* 只有最后一个套接字会正常接收数据。 */
     ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int)); //设置端口复用
     if(ret == -1) {
-        cout<<"set socket setsockopt error !"<<endl;
+        LOG_ERROR("set socket setsockopt error !");
         close(listenFd_);
         return false;
     }
 
     ret = bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr));
     if(ret < 0) {
-        cout<<"Bind Port:"<<port_<<"error!"<<endl;
+        LOG_ERROR("Bind Port:%d error!", port_);
         close(listenFd_);
         return false;
     }
 
-    ret = listen(listenFd_, 6);
+    ret = listen(listenFd_, LISTEN_BACKLOG);
     if(ret < 0) {
-        cout<<"Listen Port:"<<port_<<"error!"<<endl;
+        LOG_ERROR("Listen Port:%d error!", port_);
         close(listenFd_);
         return false;
     }
 
     ret = epoller_->AddFd(listenFd_,  listenEvent_ | EPOLLIN); //读
     if(ret == 0) { 
-        cout<<"Add listen error!"<<endl;
+        LOG_ERROR("Add listen error!");
         close(listenFd_);
         return false;
     }
 
     SetFdNonblock(listenFd_); //设置文件描述符非阻塞（epoll）
-    cout<<"Server Port:"<<port_<<endl;
+    LOG_INFO("Server Port:%d", port_);
     return true;
 }
 
@@ -143,53 +333,152 @@ void WebServer::InitEventMode_(int trigMode) {
 void WebServer::AddClient_(int fd, sockaddr_in addr) {
     assert(fd > 0);
     users_[fd].init(fd, addr);//用户数加一，地址，文件描述符，检查缓冲区...
+    //轮询分配工作线程：读写都在请求处理车道上执行，按该车道自己的线程数取模
+    users_[fd].SetWorker(nextWorker_++ % executor_->concurrency(Lane::REQUEST));
+    TRACE_PROBE(webserver, conn_accept, fd, ntohl(addr.sin_addr.s_addr), ntohs(addr.sin_port), HttpConn::userCount.load());
     epoller_->AddFd(fd, EPOLLIN | connEvent_); //向epoll中添加连接的文件描述符（读事件）
     SetFdNonblock(fd); 
-    cout<<"AddClient_ "<<users_[fd].GetFd() <<" in!"<<endl;
+    LOG_DEBUG("AddClient_ %d in!", users_[fd].GetFd());
+#ifdef USE_CORO
+    if(scheduler_) { HandleConn_(&users_[fd]); } /* 协程运行到第一次等待可读时返回 */
+#endif
 }
 
 void WebServer::DealListen_() {
-    cout<<"开始处理监听"<<endl;
+    LOG_DEBUG("开始处理监听");
     struct sockaddr_in addr; 
     socklen_t len = sizeof(addr);
     do {
         int fd = accept(listenFd_, (struct sockaddr *)&addr, &len);
-        if(fd <= 0) { return;} //
-        else if(HttpConn::userCount >= MAX_FD) {
-            SendError_(fd, "Server busy!");
-            cout<<"Clients is full!"<<endl;
+        if(fd <= 0) {
+            if((errno == EMFILE || errno == ENFILE) && RejectOverLimit_()) { continue; } //ET模式下继续处理剩下的连接
             return;
         }
+        else if(HttpConn::userCount >= maxConns_) {
+            SendError_(fd, "Server busy!");
+            LOG_WARN("Clients is full!");
+            continue; //ET模式下继续拒绝队列中剩下的连接，否则它们要等到下一个连接到来才会被处理
+        }
         AddClient_(fd, addr); //添加客户端
     } while(listenEvent_ & EPOLLET); //ET模式 
 }
 
 void WebServer::DealRead_(HttpConn* client) {
-    cout<<"开始处理读事件"<<endl;
+    LOG_DEBUG("开始处理读事件");
     assert(client);
     //由线程池中的工作线程处理事件————Reactor模式
-    threadpool_->submitTask(std::bind(&WebServer::OnRead_, this, client)); //读事件
+    if(!SubmitRead_(client)) { //读事件
+        PauseConn_(client, false);
+    }
 }
 
 void WebServer::DealWrite_(HttpConn* client) {
-    cout<<"开始处理写事件"<<endl;
+    LOG_DEBUG("开始处理写事件");
     assert(client);
     //由线程池中的工作线程处理事件————Reactor模式
-    threadpool_->submitTask(std::bind(&WebServer::OnWrite_, this, client)); //写事件
+    if(!SubmitWrite_(client)) { //写事件
+        PauseConn_(client, true);
+    }
+}
+
+/* 读事件交给请求处理车道：读取、解析并处理请求 */
+/* 亲和模式下交给连接分配的工作线程，连接的缓冲区和请求/响应对象留在同一个核的缓存中 */
+bool WebServer::SubmitRead_(HttpConn* client) {
+    client->Trace(TraceEvent::ENQUEUE, static_cast<int>(Lane::REQUEST)); //提交之前记录，任务可能立刻在其他线程开始执行
+    if(connAffinity_) {
+        return executor_->postTo(Lane::REQUEST, client->GetWorker(), [this, client, queued = CheapClock::NowNs()] {
+            Histograms::RecordSince(Stage::QUEUE_WAIT, queued);
+            client->Trace(TraceEvent::DEQUEUE, static_cast<int>(Lane::REQUEST));
+            OnRead_(client);
+        });
+    }
+    return executor_->post(Lane::REQUEST, [this, client, queued = CheapClock::NowNs()] {
+        Histograms::RecordSince(Stage::QUEUE_WAIT, queued);
+        client->Trace(TraceEvent::DEQUEUE, static_cast<int>(Lane::REQUEST));
+        OnRead_(client);
+    });
+}
+
+/* 写事件交给IO车道，大文件的发送交给阻塞车道，避免占住IO车道的线程 */
+/* 亲和模式下写事件和读事件一样交给请求处理车道上连接分配的工作线程，连接不在线程之间来回迁移 */
+bool WebServer::SubmitWrite_(HttpConn* client) {
+    if(connAffinity_) {
+        client->Trace(TraceEvent::ENQUEUE, static_cast<int>(Lane::REQUEST));
+        return executor_->postTo(Lane::REQUEST, client->GetWorker(), [this, client, queued = CheapClock::NowNs()] {
+            Histograms::RecordSince(Stage::QUEUE_WAIT, queued);
+            client->Trace(TraceEvent::DEQUEUE, static_cast<int>(Lane::REQUEST));
+            OnWrite_(client);
+        });
+    }
+    if(client->ToWriteBytes() > BIG_WRITE_BYTES) {
+        client->Trace(TraceEvent::ENQUEUE, static_cast<int>(Lane::BLOCKING));
+        return executor_->post(Lane::BLOCKING, [this, client, queued = CheapClock::NowNs()] {
+            Histograms::RecordSince(Stage::QUEUE_WAIT, queued);
+            client->Trace(TraceEvent::DEQUEUE, static_cast<int>(Lane::BLOCKING));
+            OnWrite_(client);
+        });
+    }
+    client->Trace(TraceEvent::ENQUEUE, static_cast<int>(Lane::IO));
+    return executor_->post(Lane::IO, [this, client, queued = CheapClock::NowNs()] {
+        Histograms::RecordSince(Stage::QUEUE_WAIT, queued);
+        client->Trace(TraceEvent::DEQUEUE, static_cast<int>(Lane::IO));
+        OnWrite_(client);
+    });
+}
+
+/* 线程池过载：EPOLLONESHOT已经解除了该连接的监听，暂时不再读取，稍后重新提交 */
+/* 过载时每个事件都可能暂停，暂停次数计入指标，警告按时间间隔合并输出 */
+void WebServer::PauseConn_(HttpConn* client, bool isWrite) {
+    Metrics::Add(Counter::CONN_PAUSES);
+    pausesSinceWarn_++;
+    uint64_t now = CheapClock::NowNs();
+    if(now - pauseWarnNs_ >= PAUSE_WARN_INTERVAL_NS) {
+        LOG_WARN("Threadpool overloaded, paused %llu client events (last client %d)",
+                 static_cast<unsigned long long>(pausesSinceWarn_), client->GetFd());
+        pauseWarnNs_ = now;
+        pausesSinceWarn_ = 0;
+    }
+    pausedConns_.emplace_back(client, isWrite);
+}
+
+/* 连接的任务提交到的队列：亲和模式下是分配的工作线程，否则是车道 */
+int WebServer::PauseKey_(HttpConn* client, bool isWrite) const {
+    if(connAffinity_) { return client->GetWorker(); }
+    if(!isWrite) { return static_cast<int>(Lane::REQUEST); }
+    return static_cast<int>(client->ToWriteBytes() > BIG_WRITE_BYTES ? Lane::BLOCKING : Lane::IO);
+}
+
+/* 某个队列拒绝之后，同一队列上后面的连接保持顺序等待下一次，其他队列上的连接继续提交 */
+void WebServer::ResumePaused_() {
+    if(pausedConns_.empty()) { return; }
+    std::vector<int> failed;
+    size_t kept = 0;
+    for(size_t i = 0; i < pausedConns_.size(); i++) {
+        HttpConn* client = pausedConns_[i].first;
+        bool isWrite = pausedConns_[i].second;
+        int key = PauseKey_(client, isWrite);
+        if(std::find(failed.begin(), failed.end(), key) == failed.end()) {
+            if(isWrite ? SubmitWrite_(client) : SubmitRead_(client)) { continue; }
+            failed.push_back(key);
+        }
+        pausedConns_[kept++] = pausedConns_[i];
+    }
+    pausedConns_.resize(kept);
 }
 
 void WebServer::SendError_(int fd, const char*info) {
     assert(fd > 0);
     int ret = send(fd, info, strlen(info), 0);
     if(ret < 0) {
-        cout<<"send error to client"<<fd<<" error!"<<endl;
+        LOG_WARN("send error to client %d error!", fd);
     }
     close(fd);
 }
 
 void WebServer::CloseConn_(HttpConn* client) {
     assert(client);
-    cout<<"Client:"<<client->GetFd()<<" quit!"<<endl;
+    LOG_DEBUG("Client:%d quit!", client->GetFd());
+    TRACE_PROBE(webserver, conn_close, client->GetFd(), client->BytesIn(), client->BytesOut(), HttpConn::userCount.load());
     epoller_->DelFd(client->GetFd());
     client->Close();
 }
@@ -229,11 +518,28 @@ void WebServer::OnWrite_(HttpConn* client){
 }
 
 void WebServer::OnProcess(HttpConn* client){
-    if(client->process()) { //解析完请求，并且响应封装好了
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT); //修改文件描述符 改为 写事件
-    } else {
+    if(!client->ParseRequest()) {
         epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN); //读事件 
+        return;
+    }
+    /* 由请求决定处理车道，CPU密集的请求交给阻塞车道，其余的在当前线程直接处理 */
+    if(client->HandlerLane() == Lane::BLOCKING) {
+        client->Trace(TraceEvent::ENQUEUE, static_cast<int>(Lane::BLOCKING));
+        if(!executor_->post(Lane::BLOCKING, [this, client, queued = CheapClock::NowNs()] {
+                Histograms::RecordSince(Stage::QUEUE_WAIT, queued);
+                client->Trace(TraceEvent::DEQUEUE, static_cast<int>(Lane::BLOCKING));
+                OnRespond_(client);
+            })) {
+            OnRespond_(client, 503); //阻塞车道已满，直接返回服务器繁忙
+        }
+        return;
     }
+    OnRespond_(client);
+}
+
+void WebServer::OnRespond_(HttpConn* client, int code){
+    client->MakeResponse(code); //响应封装好了
+    epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT); //修改文件描述符 改为 写事件
 }
 
 int WebServer::SetFdNonblock(int fd){
@@ -243,3 +549,51 @@ int WebServer::SetFdNonblock(int fd){
     flag |= O_NONBLOCK;
     return fcntl(fd, F_SETFL, flag);
 }
+
+#ifdef USE_CORO
+void WebServer::EnableCoroutine() {
+    scheduler_.reset(new CoScheduler(epoller_.get(), connEvent_));
+}
+
+void WebServer::DealCoEvent_(int fd, uint32_t events) {
+    if(fd == scheduler_->WakeFd()) {
+        scheduler_->OnWake(); //阻塞车道处理完的连接回到reactor线程
+    } else {
+        scheduler_->OnEvent(fd, events);
+    }
+}
+
+/* 一个连接的完整处理流程：等待可读→读取→解析→生成响应→写完→（keep-alive）继续等待可读
+ * 状态保存在协程帧中，每一步之间不需要重新提交线程池任务；超时或出错时协程以失败的结果恢复并关闭连接 */
+ConnTask WebServer::HandleConn_(HttpConn* client) {
+    int fd = client->GetFd();
+    bool alive = true;
+    while(alive) {
+        if(!co_await scheduler_->Readable(fd, CONN_TIMEOUT_MS)) { break; }
+        int readErrno = 0;
+        ssize_t ret = client->read(&readErrno);
+        if(ret <= 0 && readErrno != EAGAIN) { break; }
+        /* 缓冲区中可能有多个流水线请求 */
+        while(alive && client->ParseRequest()) {
+            if(client->HandlerLane() == Lane::BLOCKING) {
+                client->Trace(TraceEvent::ENQUEUE, static_cast<int>(Lane::BLOCKING));
+                bool done = co_await scheduler_->Offload(*executor_, Lane::BLOCKING, [client] {
+                    client->Trace(TraceEvent::DEQUEUE, static_cast<int>(Lane::BLOCKING));
+                    client->MakeResponse();
+                });
+                if(!done) { client->MakeResponse(503); } //阻塞车道已满，直接返回服务器繁忙
+            } else {
+                client->MakeResponse();
+            }
+            while(alive && client->ToWriteBytes() > 0) {
+                int writeErrno = 0;
+                if(client->write(&writeErrno) <= 0) { //返回0说明没有写出任何字节，不能再原地重试
+                    alive = writeErrno == EAGAIN && co_await scheduler_->Writable(fd, CONN_TIMEOUT_MS);
+                }
+            }
+            alive = alive && client->IsKeepAlive();
+        }
+    }
+    CloseConn_(client);
+}
+#endif
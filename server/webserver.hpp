@@ -1,8 +1,10 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
+#include <algorithm>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <fcntl.h>
 #include <unistd.h>
 #include <assert.h>
@@ -10,51 +12,110 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <malloc.h>
 
 #include "epoller.hpp"
-#include "../threadpool/threadpool.hpp"
+#include "../threadpool/executor.hpp"
+#include "../threadpool/placement.hpp"
+#include "../log/log.hpp"
+#include "../log/asynclog.hpp"
 #include "../http/httpconn.hpp"
+#include "../metrics/metrics.hpp"
+#include "../metrics/histogram.hpp"
+#include "coroutine.hpp"
 
 class WebServer
 {
 public:
-    WebServer(int port, int trigMode);
+    WebServer(int port, int trigMode, int threadNum = 12, bool connAffinity = false,
+              const Placement &placement = Placement());
 
     ~WebServer();
 
     void _Start();
 
+    // 同时保持的连接数上限（默认MAX_FD），按需要提高RLIMIT_NOFILE的软限制
+    void SetMaxConns(int maxConns);
+
+#ifdef USE_CORO
+    // 协程模式：连接的读、解析、写都在reactor线程上由协程完成，只有阻塞车道的请求交给线程池
+    void EnableCoroutine();
+#endif
+
 private:
     bool InitSocket_(); // 封装套接字
     void InitEventMode_(int trigMode);
+    void RegisterMetrics_();
+    void InitDumpSignal_();
+    void DumpStats_();
+    static void OnDumpSignal_(int sig);
+    void RaiseFdLimit_();
+    bool RejectOverLimit_();
     void AddClient_(int fd, sockaddr_in addr);
 
     void DealListen_();
     void DealWrite_(HttpConn *client);
     void DealRead_(HttpConn *client);
 
+    bool SubmitRead_(HttpConn *client);
+    bool SubmitWrite_(HttpConn *client);
+    void PauseConn_(HttpConn *client, bool isWrite);
+    void ResumePaused_();
+    int PauseKey_(HttpConn *client, bool isWrite) const;
+
     void SendError_(int fd, const char *info);
     void CloseConn_(HttpConn *client);
 
     void OnRead_(HttpConn *client);
     void OnWrite_(HttpConn *client);
     void OnProcess(HttpConn *client);
+    void OnRespond_(HttpConn *client, int code = -1);
+
+#ifdef USE_CORO
+    ConnTask HandleConn_(HttpConn *client);
+    void DealCoEvent_(int fd, uint32_t events);
+#endif
 
     static const int MAX_FD = 65536;
+    static const int MAX_TASK_QUEUE = 4096; // 线程池任务队列容量
+    static const int PAUSE_RETRY_MS = 5;    // 暂停的连接重新提交任务的间隔
+    static const uint64_t PAUSE_WARN_INTERVAL_NS = 1000000000; // 暂停连接的警告最多每秒输出一次
+    static const int AFFINITY_SPILL = 64;   // 亲和模式下工作线程积压超过该值时允许其他线程分担
+    static const int BIG_WRITE_BYTES = 1 << 20; // 超过该大小的响应交给阻塞车道发送
+    static const int BLOCKING_NICE = 10;    // 阻塞车道线程的nice值
+    static const int CONN_TIMEOUT_MS = 60000; // 协程模式下连接等待读写的超时时间
+    static const int LISTEN_BACKLOG = 4096; // 全连接队列长度（内核按net.core.somaxconn截断），过小时成批的连接会因SYN被丢弃而重传
+    static const int RESERVED_FDS = 64;     // 连接之外需要的文件描述符（监听、epoll、日志、响应的文件等）
 
     static int SetFdNonblock(int fd);
+    static int dumpFd_; // SIGUSR1的处理函数写这个eventfd，由reactor线程输出延迟直方图和内存统计
 
     int port_;
     bool isClose_; // 是否关闭
     int listenFd_; // 监听的文件描述符
+    int idleFd_;   // 预留的文件描述符：文件描述符用完时关闭它，接受并关闭一个连接，再重新打开
+    int maxConns_; // 连接数上限
     char *srcDir_; // 资源的目录
 
     uint32_t listenEvent_;
     uint32_t connEvent_;
 
-    std::unique_ptr<Threadpool> threadpool_;  // 线程池
+    int threadNum_;           // 线程池的初始线程数量
+    bool connAffinity_;       // 连接亲和模式：同一个连接的任务总是交给同一个工作线程
+    unsigned int nextWorker_; // 轮询分配工作线程
+
+    std::unique_ptr<Executor> executor_;      // 执行器（IO、请求处理、阻塞三个车道的线程池）
     std::unique_ptr<Epoller> epoller_;        // epoll对象
     std::unordered_map<int, HttpConn> users_; // 保存的是客户端连接的信息（哈希表：文件描述符-http连接）
+    std::vector<std::pair<HttpConn *, bool>> pausedConns_; // 任务被线程池拒绝而暂停读写的连接（连接-是否为写事件）
+    uint64_t pauseWarnNs_;     // 上一次输出暂停警告的时间
+    uint64_t pausesSinceWarn_; // 上一次警告之后暂停的次数
+#ifdef USE_CORO
+    std::unique_ptr<CoScheduler> scheduler_; // 协程调度器，为空时使用回调模式
+#endif
 };
 
 #endif // WEBSERVER_H
\ No newline at end of file
@@ -0,0 +1,154 @@
+#ifndef BOUNDED_QUEUE_H_
+#define BOUNDED_QUEUE_H_
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <utility>
+
+// 有界无锁多生产者多消费者环形队列（Dmitry Vyukov 的 MPMC 算法）
+// 每个槽位带一个序号，生产者/消费者通过CAS抢占位置，再通过序号发布/回收槽位
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t cap = 2;
+        while (cap < capacity)
+            cap <<= 1;
+        mask_ = cap - 1;
+        cells_.reset(new Cell[cap]);
+        for (size_t i = 0; i < cap; i++)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        enqueuePos_.store(0, std::memory_order_relaxed);
+        dequeuePos_.store(0, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    // 入队，队列满时返回false，此时item保持不变
+    bool push(T &item)
+    {
+        Cell *cell;
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false; // 队列满
+            }
+            else
+            {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool push(T &&item) { return push(item); }
+
+    // 批量入队：一次CAS占用连续的多个空闲槽位，返回实际入队的数量k，items中前k个元素被移走
+    size_t pushBatch(T *items, size_t count)
+    {
+        if (count == 0)
+            return 0;
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        size_t n;
+        for (;;)
+        {
+            // 从pos开始数出连续的空闲槽位
+            n = 0;
+            while (n < count && n <= mask_)
+            {
+                size_t seq = cells_[(pos + n) & mask_].sequence.load(std::memory_order_acquire);
+                if (seq != pos + n)
+                    break;
+                n++;
+            }
+            if (n == 0)
+            {
+                size_t seq = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+                if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos) < 0)
+                    return 0; // 队列满
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (enqueuePos_.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+                break;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            Cell &cell = cells_[(pos + i) & mask_];
+            cell.data = std::move(items[i]);
+            cell.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        return n;
+    }
+
+    // 出队，队列空时返回false
+    bool pop(T &item)
+    {
+        Cell *cell;
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false; // 队列空
+            }
+            else
+            {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(cell->data);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 近似的元素数量
+    size_t size() const
+    {
+        size_t enq = enqueuePos_.load(std::memory_order_seq_cst);
+        size_t deq = dequeuePos_.load(std::memory_order_seq_cst);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> enqueuePos_; // 生产者位置
+    alignas(64) std::atomic<size_t> dequeuePos_; // 消费者位置
+};
+
+#endif
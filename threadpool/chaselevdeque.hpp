@@ -0,0 +1,124 @@
+#ifndef CHASELEV_DEQUE_H_
+#define CHASELEV_DEQUE_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+// Chase-Lev 工作窃取双端队列（Lê et al. 2013 的 C11 内存序版本）
+// 只有拥有者线程可以 push/pop（队尾），其他线程只能 steal（队头）
+// T 必须是可平凡拷贝的类型（这里存放的是任务槽位的指针）
+template <typename T>
+class ChaseLevDeque
+{
+public:
+    explicit ChaseLevDeque(int64_t capacity = 256)
+        : top_(0), bottom_(0)
+    {
+        int64_t cap = 1;
+        while (cap < capacity)
+            cap <<= 1;
+        auto arr = std::make_unique<Array>(cap);
+        array_.store(arr.get(), std::memory_order_relaxed);
+        arrays_.push_back(std::move(arr));
+    }
+
+    ChaseLevDeque(const ChaseLevDeque &) = delete;
+    ChaseLevDeque &operator=(const ChaseLevDeque &) = delete;
+
+    // 拥有者线程：压入队尾
+    void push(T item)
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array *a = array_.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1)
+            a = grow_(a, b, t);
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // 拥有者线程：从队尾弹出
+    bool pop(T &item)
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array *a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            // 队列为空
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = a->get(b);
+        if (t == b)
+        {
+            // 只剩最后一个元素，和窃取者竞争
+            bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // 任意线程：从队头窃取
+    bool steal(T &item)
+    {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+        Array *a = array_.load(std::memory_order_acquire);
+        item = a->get(t);
+        return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // 近似大小，只用于判断是否有可窃取的任务
+    int64_t size() const
+    {
+        int64_t b = bottom_.load(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_seq_cst);
+        return b > t ? b - t : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    struct Array
+    {
+        explicit Array(int64_t cap)
+            : capacity(cap), mask(cap - 1), slots(new std::atomic<T>[cap])
+        {
+        }
+        T get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T v) { slots[i & mask].store(v, std::memory_order_relaxed); }
+
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    // 扩容：旧数组保留到队列析构，窃取者可能仍在读取
+    Array *grow_(Array *old, int64_t b, int64_t t)
+    {
+        auto arr = std::make_unique<Array>(old->capacity * 2);
+        for (int64_t i = t; i < b; i++)
+            arr->put(i, old->get(i));
+        Array *raw = arr.get();
+        arrays_.push_back(std::move(arr));
+        array_.store(raw, std::memory_order_release);
+        return raw;
+    }
+
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    std::atomic<Array *> array_;
+    std::vector<std::unique_ptr<Array>> arrays_; // 只由拥有者线程修改
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "executor.hpp"
+
+Executor::Executor()
+{
+    for (int i = 0; i < LANE_COUNT; i++)
+    {
+        lanes_[i] = std::make_unique<Threadpool>();
+        concurrency_[i] = 1;
+    }
+}
+
+Threadpool &Executor::lane(Lane lane)
+{
+    return *lanes_[static_cast<int>(lane)];
+}
+
+void Executor::setConcurrency(Lane lane, int threads)
+{
+    concurrency_[static_cast<int>(lane)] = threads > 0 ? threads : 1;
+}
+
+void Executor::setPriority(Lane lane, int nice)
+{
+    lanes_[static_cast<int>(lane)]->setThreadNice(nice);
+}
+
+void Executor::start()
+{
+    for (int i = 0; i < LANE_COUNT; i++)
+        lanes_[i]->start(concurrency_[i]);
+}
+
+const char *Executor::laneName(Lane lane)
+{
+    switch (lane)
+    {
+    case Lane::IO: return "io";
+    case Lane::REQUEST: return "request";
+    case Lane::BLOCKING: return "blocking";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef EXECUTOR_H_
+#define EXECUTOR_H_
+
+#include <memory>
+#include "threadpool.hpp"
+
+// 执行车道：不同类型的任务使用各自的线程池，慢任务不会堵住快任务
+enum class Lane
+{
+    IO = 0,       // 套接字读写
+    REQUEST = 1,  // 请求解析和普通的请求处理
+    BLOCKING = 2, // 阻塞或者CPU密集的处理（POST计算、大文件发送）
+};
+
+const int LANE_COUNT = 3;
+
+// 由多个车道组成的执行器，每个车道有自己的线程池、并发上限和调度优先级
+class Executor
+{
+public:
+    Executor();
+
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    // 启动前可以通过lane()配置各个车道的线程池（模式、队列容量、过载策略等）
+    Threadpool &lane(Lane lane);
+    // 设置车道的线程数量（并发上限）
+    void setConcurrency(Lane lane, int threads);
+    int concurrency(Lane lane) const { return concurrency_[static_cast<int>(lane)]; }
+    // 设置车道线程的nice值，值越大优先级越低
+    void setPriority(Lane lane, int nice);
+
+    void start();
+
+    template <typename F>
+    bool post(Lane lane, F &&func)
+    {
+        return lanes_[static_cast<int>(lane)]->post(std::forward<F>(func));
+    }
+
+    template <typename F>
+    bool postTo(Lane lane, size_t key, F &&func)
+    {
+        return lanes_[static_cast<int>(lane)]->postTo(key, std::forward<F>(func));
+    }
+
+    template <typename F>
+    auto submit(Lane lane, F &&func)
+    {
+        return lanes_[static_cast<int>(lane)]->submit(std::forward<F>(func));
+    }
+
+    static const char *laneName(Lane lane);
+
+private:
+    std::unique_ptr<Threadpool> lanes_[LANE_COUNT];
+    int concurrency_[LANE_COUNT];
+};
+
+#endif
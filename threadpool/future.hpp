@@ -0,0 +1,154 @@
+#ifndef FUTURE_H_
+#define FUTURE_H_
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// 轻量的future/promise：一次分配共享状态，结果就绪前先自旋一小段时间，再退化为条件变量等待
+template <typename T>
+struct FutureState
+{
+    void setValue(T value)
+    {
+        value_.emplace(std::move(value));
+        publish_();
+    }
+    void setException(std::exception_ptr error)
+    {
+        error_ = error;
+        publish_();
+    }
+    T take() { return std::move(*value_); }
+
+    void publish_()
+    {
+        ready_.store(true, std::memory_order_seq_cst);
+        // 只有存在等待者时才加锁唤醒
+        if (waiting_.load(std::memory_order_seq_cst))
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            cond_.notify_all();
+        }
+    }
+
+    void wait()
+    {
+        for (int i = 0; i < 128; i++)
+        {
+            if (ready_.load(std::memory_order_acquire))
+                return;
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(mtx_);
+        waiting_.store(true, std::memory_order_seq_cst);
+        cond_.wait(lock, [this]() { return ready_.load(std::memory_order_seq_cst); });
+    }
+
+    std::optional<T> value_;
+    std::exception_ptr error_;
+    std::atomic<bool> ready_{false};
+    std::atomic<bool> waiting_{false};
+    std::mutex mtx_;
+    std::condition_variable cond_;
+};
+
+template <>
+struct FutureState<void> : FutureState<bool>
+{
+    void setValue() { FutureState<bool>::setValue(true); }
+    void take() {}
+};
+
+template <typename T>
+class Future
+{
+public:
+    Future() = default;
+    explicit Future(std::shared_ptr<FutureState<T>> state) : state_(std::move(state)) {}
+
+    bool valid() const { return state_ != nullptr; }
+    bool ready() const { return state_ && state_->ready_.load(std::memory_order_acquire); }
+    void wait() const { state_->wait(); }
+
+    // 等待结果，任务抛出的异常在这里重新抛出；只能调用一次
+    T get()
+    {
+        state_->wait();
+        auto state = std::move(state_);
+        if (state->error_)
+            std::rethrow_exception(state->error_);
+        return state->take();
+    }
+
+    // 已经失败的future，例如任务被线程池拒绝
+    static Future failed(std::exception_ptr error)
+    {
+        auto state = std::make_shared<FutureState<T>>();
+        state->setException(error);
+        return Future(state);
+    }
+
+private:
+    std::shared_ptr<FutureState<T>> state_;
+};
+
+// 在state上执行func并保存结果或异常
+template <typename T, typename F>
+void fulfill(FutureState<T> &state, F &func)
+{
+    try
+    {
+        if constexpr (std::is_void<T>::value)
+        {
+            func();
+            state.setValue();
+        }
+        else
+        {
+            state.setValue(func());
+        }
+    }
+    catch (...)
+    {
+        state.setException(std::current_exception());
+    }
+}
+
+// 提交给线程池的任务持有的结果端：任务执行时写入结果；任务没有执行就被销毁
+// （被SHED策略丢弃、线程池析构时仍在队列中）时以异常结束future，等待者不会一直阻塞
+template <typename T>
+class Promise
+{
+public:
+    explicit Promise(std::shared_ptr<FutureState<T>> state) : state_(std::move(state)) {}
+    Promise(Promise &&other) noexcept = default;
+    Promise &operator=(Promise &&other) = delete;
+    Promise(const Promise &) = delete;
+    Promise &operator=(const Promise &) = delete;
+
+    ~Promise()
+    {
+        if (state_)
+            state_->setException(std::make_exception_ptr(std::runtime_error("task dropped")));
+    }
+
+    template <typename F>
+    void fulfill(F &func)
+    {
+        ::fulfill(*state_, func);
+        state_.reset();
+    }
+
+private:
+    std::shared_ptr<FutureState<T>> state_;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "threadpool.hpp"
+
+// 基于线程池的数据并行：把[begin, end)切成大小为grain的块，调用线程和线程池中的线程一起领取块执行
+// 调用线程自己也参与执行，因此在线程池的工作线程中调用也不会死锁（最坏情况下所有块都由调用线程完成）
+
+template <typename F>
+struct ParallelForState
+{
+    size_t begin;
+    size_t end;
+    size_t grain;
+    size_t chunks;
+    const F *func;                  // 只在领取到块时访问，领取到块说明调用者还在等待
+    std::atomic<size_t> next{0};    // 下一个待领取的块
+    std::atomic<size_t> done{0};    // 已经完成的块
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;       // 第一个异常，由mtx保护
+    std::mutex mtx;
+    FutureState<void> finished;     // 最后一个块完成时就绪
+
+    // 领取并执行块，直到没有剩余的块
+    void run()
+    {
+        for (;;)
+        {
+            size_t chunk = next.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= chunks)
+                return;
+            // 已经有块失败时只计数，不再执行
+            if (!failed.load(std::memory_order_relaxed))
+            {
+                size_t first = begin + chunk * grain;
+                try
+                {
+                    (*func)(first, std::min(first + grain, end));
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (!error)
+                        error = std::current_exception();
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+            if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == chunks)
+                finished.setValue();
+        }
+    }
+};
+
+// 并行执行func(i0, i1)，覆盖[begin, end)；grain为0时按照线程数量自动选择块大小
+// 所有块完成后返回，任意块抛出的第一个异常在这里重新抛出
+template <typename F>
+void parallelFor(Threadpool &pool, size_t begin, size_t end, size_t grain, const F &func)
+{
+    if (begin >= end)
+        return;
+    size_t count = end - begin;
+    if (grain == 0)
+        grain = std::max<size_t>(1, count / (std::max(pool.threadCount(), 1u) * 4));
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1)
+    {
+        func(begin, end);
+        return;
+    }
+
+    auto state = std::make_shared<ParallelForState<F>>();
+    state->begin = begin;
+    state->end = end;
+    state->grain = grain;
+    state->chunks = chunks;
+    state->func = &func;
+
+    // 帮手任务只捕获共享状态，可以内联存放在Task中；一次批量提交，只唤醒需要的线程数
+    size_t helpers = std::min<size_t>(pool.threadCount(), chunks - 1);
+    std::vector<Task> tasks;
+    tasks.reserve(helpers);
+    for (size_t i = 0; i < helpers; i++)
+        tasks.emplace_back([state]() { state->run(); });
+    pool.submitBatch(tasks);
+
+    state->run();
+    state->finished.wait();
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+// 每个块的归约结果单独占一个缓存行：多个线程同时写入不同的块，既不会伪共享，
+// 也不会像std::vector<bool>那样几个块挤在同一个字里造成数据竞争
+template <typename T>
+struct alignas(64) ReduceSlot
+{
+    T value;
+};
+
+// 并行归约：每个块计算map(i0, i1)，再按照块的顺序用reduce合并，结果与串行计算的结合顺序一致
+template <typename T, typename MapFn, typename ReduceFn>
+T parallelReduce(Threadpool &pool, size_t begin, size_t end, size_t grain, T identity, const MapFn &map, const ReduceFn &reduce)
+{
+    if (begin >= end)
+        return identity;
+    size_t count = end - begin;
+    if (grain == 0)
+        grain = std::max<size_t>(1, count / (std::max(pool.threadCount(), 1u) * 4));
+    std::vector<ReduceSlot<T>> partial((count + grain - 1) / grain, ReduceSlot<T>{identity});
+    parallelFor(pool, begin, end, grain, [&](size_t first, size_t last) {
+        partial[(first - begin) / grain].value = map(first, last);
+    });
+    T result = std::move(identity);
+    for (auto &slot : partial)
+        result = reduce(std::move(result), std::move(slot.value));
+    return result;
+}
+
+#endif
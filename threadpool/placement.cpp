@@ -0,0 +1,146 @@
+#include "placement.hpp"
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+const Topology &Topology::instance()
+{
+    static Topology topology;
+    return topology;
+}
+
+Topology::Topology() : nodeCount_(1)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+                allowedCpus_.push_back(cpu);
+        }
+    }
+    if (allowedCpus_.empty())
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu = 0; cpu < n; cpu++)
+            allowedCpus_.push_back(cpu);
+    }
+    cpuNode_.assign(allowedCpus_.back() + 1, 0);
+
+    // /sys/devices/system/node/nodeN/cpulist
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir)
+    {
+        int maxNode = 0;
+        while (struct dirent *entry = readdir(dir))
+        {
+            int node;
+            if (sscanf(entry->d_name, "node%d", &node) != 1)
+                continue;
+            std::ifstream in("/sys/devices/system/node/" + std::string(entry->d_name) + "/cpulist");
+            std::string list;
+            std::getline(in, list);
+            for (int cpu : parseCpuList(list))
+            {
+                if (cpu < static_cast<int>(cpuNode_.size()))
+                    cpuNode_[cpu] = node;
+            }
+            maxNode = std::max(maxNode, node);
+        }
+        closedir(dir);
+        nodeCount_ = maxNode + 1;
+    }
+    // 同一个节点的CPU排在一起，按顺序分配时工作线程先填满一个节点
+    std::stable_sort(allowedCpus_.begin(), allowedCpus_.end(),
+                     [this](int a, int b) { return cpuNode_[a] < cpuNode_[b]; });
+}
+
+int Topology::nodeOfCpu(int cpu) const
+{
+    if (cpu < 0 || cpu >= static_cast<int>(cpuNode_.size()))
+        return 0;
+    return cpuNode_[cpu];
+}
+
+bool Topology::isAllowed(int cpu) const
+{
+    return std::find(allowedCpus_.begin(), allowedCpus_.end(), cpu) != allowedCpus_.end();
+}
+
+std::vector<int> Topology::parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        int first, last;
+        int n = sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (n == 1)
+            last = first;
+        else if (n != 2)
+            continue;
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+bool pinCurrentThread(const std::vector<int> &cpus)
+{
+    if (cpus.empty())
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool preferMemoryNode(int node)
+{
+    // 单节点机器上没有意义
+    if (Topology::instance().nodeCount() <= 1)
+        return false;
+    if (node < 0)
+        return false;
+    // 节点掩码是unsigned long数组，节点号可以超过一个字的位数
+    const size_t bits = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] = 1UL << (node % bits);
+    return syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * bits + 1) == 0;
+}
+
+std::vector<int> resolveWorkerCpus(const Placement &placement)
+{
+    const Topology &topology = Topology::instance();
+    std::vector<int> cpus;
+    if (placement.workerCpus == "auto")
+        cpus = topology.allowedCpus();
+    else
+    {
+        for (int cpu : Topology::parseCpuList(placement.workerCpus))
+        {
+            if (topology.isAllowed(cpu))
+                cpus.push_back(cpu);
+        }
+    }
+    if (placement.isolateAcceptor)
+    {
+        std::vector<int> reactor = Topology::parseCpuList(placement.reactorCpus);
+        cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [&](int cpu) {
+                       return std::find(reactor.begin(), reactor.end(), cpu) != reactor.end();
+                   }),
+                   cpus.end());
+    }
+    return cpus;
+}
@@ -0,0 +1,46 @@
+#ifndef PLACEMENT_H_
+#define PLACEMENT_H_
+
+#include <string>
+#include <vector>
+
+// CPU拓扑：当前进程允许使用的CPU以及它们所在的NUMA节点
+class Topology
+{
+public:
+    // 读取sched_getaffinity和/sys/devices/system/node，没有NUMA信息时所有CPU视为节点0
+    static const Topology &instance();
+
+    // 进程允许使用的CPU，按照NUMA节点排序
+    const std::vector<int> &allowedCpus() const { return allowedCpus_; }
+    int nodeCount() const { return nodeCount_; }
+    int nodeOfCpu(int cpu) const;
+    bool isAllowed(int cpu) const;
+
+    // 解析"0-3,8,10-11"格式的CPU列表
+    static std::vector<int> parseCpuList(const std::string &list);
+
+private:
+    Topology();
+
+    std::vector<int> allowedCpus_;
+    std::vector<int> cpuNode_; // 下标为CPU编号，值为NUMA节点
+    int nodeCount_;
+};
+
+// 线程放置配置，CPU列表为空表示不绑定
+struct Placement
+{
+    std::string reactorCpus;      // reactor（同时负责accept）线程绑定的CPU
+    std::string workerCpus;       // 工作线程绑定的CPU，"auto"表示使用所有允许的CPU
+    bool isolateAcceptor = false; // 工作线程不使用reactor所在的CPU
+};
+
+// 把调用线程绑定到cpus上
+bool pinCurrentThread(const std::vector<int> &cpus);
+// 调用线程之后分配的内存优先放在node节点上（first touch时生效）
+bool preferMemoryNode(int node);
+// 根据配置计算工作线程使用的CPU列表
+std::vector<int> resolveWorkerCpus(const Placement &placement);
+
+#endif
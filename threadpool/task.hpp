@@ -0,0 +1,130 @@
+#ifndef TASK_H_
+#define TASK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 只能移动的任务类型，代替std::function<void()>
+// 可调用对象足够小（不超过INLINE_SIZE）时直接存放在对象内部，不需要堆分配；否则退化为堆上存放
+class Task
+{
+public:
+    // 内联存储的大小：至少可以放下捕获了6个指针的lambda
+    static constexpr size_t INLINE_SIZE = 6 * sizeof(void *);
+
+    // 可调用对象F是否可以内联存放
+    template <typename F>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(F) <= INLINE_SIZE && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<F>::value;
+    }
+
+    Task() noexcept : ops_(nullptr), enqueueNs_(0) {}
+
+    template <typename F, typename Fn = typename std::decay<F>::type,
+              typename = typename std::enable_if<!std::is_same<Fn, Task>::value>::type>
+    Task(F &&f) : ops_(nullptr), enqueueNs_(0)
+    {
+        if constexpr (fitsInline<Fn>())
+        {
+            new (storage_) Fn(std::forward<F>(f));
+            ops_ = &InlineOps<Fn>::ops;
+        }
+        else
+        {
+            *reinterpret_cast<Fn **>(storage_) = new Fn(std::forward<F>(f));
+            ops_ = &HeapOps<Fn>::ops;
+        }
+    }
+
+    Task(Task &&other) noexcept : ops_(other.ops_), enqueueNs_(other.enqueueNs_)
+    {
+        if (ops_)
+        {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            ops_ = other.ops_;
+            enqueueNs_ = other.enqueueNs_;
+            if (ops_)
+            {
+                ops_->move(storage_, other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { ops_->invoke(storage_); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    // 是否存放在堆上
+    bool isHeap() const { return ops_ && ops_->heap; }
+
+    // 入队时间（纳秒），用于统计任务在队列中的等待时间
+    void setEnqueueTime(int64_t ns) { enqueueNs_ = ns; }
+    int64_t enqueueTime() const { return enqueueNs_; }
+
+    void reset()
+    {
+        if (ops_)
+        {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    // 手工实现的虚函数表，每种可调用对象类型一份
+    struct Ops
+    {
+        void (*invoke)(void *);
+        void (*move)(void *dst, void *src); // 移动到dst并析构src
+        void (*destroy)(void *);
+        bool heap;
+    };
+
+    template <typename Fn>
+    struct InlineOps
+    {
+        static void invoke(void *p) { (*static_cast<Fn *>(p))(); }
+        static void move(void *dst, void *src)
+        {
+            new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+            static_cast<Fn *>(src)->~Fn();
+        }
+        static void destroy(void *p) { static_cast<Fn *>(p)->~Fn(); }
+        static constexpr Ops ops = {&invoke, &move, &destroy, false};
+    };
+
+    template <typename Fn>
+    struct HeapOps
+    {
+        static void invoke(void *p) { (**static_cast<Fn **>(p))(); }
+        static void move(void *dst, void *src) { *static_cast<Fn **>(dst) = *static_cast<Fn **>(src); }
+        static void destroy(void *p) { delete *static_cast<Fn **>(p); }
+        static constexpr Ops ops = {&invoke, &move, &destroy, true};
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[INLINE_SIZE];
+    const Ops *ops_;
+    int64_t enqueueNs_;
+};
+
+#endif
@@ -0,0 +1,116 @@
+// ChaseLevDeque的并发正确性：拥有者线程压入、弹出，同时多个线程窃取，每个元素恰好被取出一次
+// 初始容量很小，压入过程中多次扩容，窃取者可能正在读旧数组
+#include "../chaselevdeque.hpp"
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// 拥有者每压入popEvery个元素弹出一个，最后弹出剩下的；thieves个线程一直窃取到拥有者结束且队列为空
+static void run(const char *name, size_t items, int thieves, size_t popEvery)
+{
+    ChaseLevDeque<size_t> deque(4);
+    std::vector<std::atomic<unsigned char>> seen(items + 1);
+    for (auto &s : seen)
+        s.store(0, std::memory_order_relaxed);
+    std::atomic<bool> ownerDone(false);
+    std::atomic<size_t> stolen(0);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thieves; t++)
+    {
+        threads.emplace_back([&]() {
+            size_t item;
+            for (;;)
+            {
+                bool done = ownerDone.load(std::memory_order_acquire);
+                if (deque.steal(item))
+                {
+                    seen[item].fetch_add(1, std::memory_order_relaxed);
+                    stolen.fetch_add(1, std::memory_order_relaxed);
+                }
+                else if (done && deque.empty())
+                {
+                    return;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    size_t item;
+    for (size_t i = 1; i <= items; i++)
+    {
+        deque.push(i);
+        if (popEvery && i % popEvery == 0 && deque.pop(item))
+            seen[item].fetch_add(1, std::memory_order_relaxed);
+    }
+    while (deque.pop(item))
+        seen[item].fetch_add(1, std::memory_order_relaxed);
+    ownerDone.store(true, std::memory_order_release);
+    for (auto &thread : threads)
+        thread.join();
+
+    size_t missing = 0, duplicated = 0;
+    for (size_t i = 1; i <= items; i++)
+    {
+        unsigned char n = seen[i].load(std::memory_order_relaxed);
+        if (n == 0)
+            missing++;
+        else if (n > 1)
+            duplicated++;
+    }
+    if (missing || duplicated)
+        printf("%s: %zu missing, %zu duplicated, %zu stolen\n", name, missing, duplicated, stolen.load());
+    check(missing == 0 && duplicated == 0, name);
+}
+
+int main()
+{
+    // 只有拥有者：后进先出
+    {
+        ChaseLevDeque<size_t> deque(2);
+        for (size_t i = 0; i < 100; i++)
+            deque.push(i);
+        bool lifo = true;
+        size_t item;
+        for (size_t i = 100; i-- > 0;)
+            lifo = lifo && deque.pop(item) && item == i;
+        check(lifo && !deque.pop(item), "owner lifo");
+    }
+    // 只有窃取者：先进先出
+    {
+        ChaseLevDeque<size_t> deque(2);
+        for (size_t i = 0; i < 100; i++)
+            deque.push(i);
+        bool fifo = true;
+        size_t item;
+        for (size_t i = 0; i < 100; i++)
+            fifo = fifo && deque.steal(item) && item == i;
+        check(fifo && !deque.steal(item), "thief fifo");
+    }
+    for (int round = 0; round < 5; round++)
+    {
+        run("push then drain, 3 thieves", 200000, 3, 0);
+        run("push/pop interleaved, 3 thieves", 200000, 3, 2);
+        // 每次压入后立刻弹出：队列中最多一个元素，拥有者和窃取者争抢最后一个元素
+        run("last element race, 2 thieves", 200000, 2, 1);
+    }
+    if (failures)
+        return 1;
+    printf("deque_test passed\n");
+    return 0;
+}
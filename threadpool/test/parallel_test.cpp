@@ -0,0 +1,81 @@
+// parallelFor/parallelReduce的正确性：结果与串行计算一致，包括bool这样会被std::vector按位压缩的结果类型
+#include "../parallel.hpp"
+#include "../../log/log.hpp"
+#include <cstdio>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+int main()
+{
+    Logger::root()->setLevel(LogLevel::INFO);
+    Threadpool pool;
+    pool.setMode(Mode::STEALING);
+    pool.start(4);
+
+    const size_t N = 100000;
+    std::vector<int> data(N);
+    for (size_t i = 0; i < N; i++)
+        data[i] = static_cast<int>(i % 1000);
+
+    std::vector<int> doubled(N);
+    parallelFor(pool, 0, N, 0, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+            doubled[i] = data[i] * 2;
+    });
+    bool same = true;
+    for (size_t i = 0; i < N; i++)
+        same = same && doubled[i] == data[i] * 2;
+    check(same, "parallelFor");
+
+    long sum = parallelReduce(pool, 0, N, 0, 0L, [&](size_t first, size_t last) {
+        long s = 0;
+        for (size_t i = first; i < last; i++)
+            s += data[i];
+        return s;
+    }, [](long a, long b) { return a + b; });
+    check(sum == 49950000L, "parallelReduce long");
+
+    // 块的合并顺序与串行一致
+    std::string joined = parallelReduce(pool, 0, 26, 1, std::string(), [](size_t first, size_t) {
+        return std::string(1, static_cast<char>('a' + first));
+    }, [](std::string a, std::string b) { return a + b; });
+    check(joined == "abcdefghijklmnopqrstuvwxyz", "parallelReduce order");
+
+    // bool结果：每个块只写自己的槽位，块很小时相邻的块同时写入
+    for (int round = 0; round < 200; round++)
+    {
+        size_t target = (round * 7919) % N;
+        auto find = [&](size_t first, size_t last) {
+            bool found = false;
+            for (size_t i = first; i < last; i++)
+                found = found || (i == target && data[i] == static_cast<int>(target % 1000));
+            return found;
+        };
+        auto any = [](bool a, bool b) { return a || b; };
+        auto all = [](bool a, bool b) { return a && b; };
+        bool found = parallelReduce(pool, 0, N, 16, false, find, any);
+        check(found, "parallelReduce bool any");
+        bool allSmall = parallelReduce(pool, 0, N, 16, true, [&](size_t first, size_t last) {
+            bool ok = true;
+            for (size_t i = first; i < last; i++)
+                ok = ok && data[i] < 1000 && i != target;
+            return ok;
+        }, all);
+        check(!allSmall, "parallelReduce bool all");
+    }
+
+    if (failures)
+        return 1;
+    printf("parallel_test passed\n");
+    return 0;
+}
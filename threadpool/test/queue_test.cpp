@@ -0,0 +1,265 @@
+// BoundedQueue的并发正确性，以及任务队列满时三种过载策略（REJECT/SHED/BLOCK）的行为
+#include "../threadpool.hpp"
+#include "../../log/log.hpp"
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// 多生产者多消费者：每个元素恰好被取出一次；单消费者时同一个生产者的元素保持先后顺序
+static void runQueue(const char *name, int producers, int consumers, size_t perProducer)
+{
+    BoundedQueue<size_t> queue(64);
+    size_t total = producers * perProducer;
+    std::vector<std::atomic<unsigned char>> seen(total);
+    for (auto &s : seen)
+        s.store(0, std::memory_order_relaxed);
+    std::atomic<size_t> consumed(0);
+    std::atomic<bool> ordered(true);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&, p]() {
+            size_t next = 0;
+            while (next < perProducer)
+            {
+                // 交替使用单个入队和批量入队，元素编号为producer * perProducer + i
+                if (next % 3 == 0)
+                {
+                    size_t items[5];
+                    size_t n = std::min<size_t>(5, perProducer - next);
+                    for (size_t i = 0; i < n; i++)
+                        items[i] = p * perProducer + next + i;
+                    next += queue.pushBatch(items, n);
+                }
+                else
+                {
+                    size_t item = p * perProducer + next;
+                    if (queue.push(item))
+                        next++;
+                }
+                if (queue.size() == queue.capacity())
+                    std::this_thread::yield();
+            }
+        });
+    }
+    for (int c = 0; c < consumers; c++)
+    {
+        threads.emplace_back([&]() {
+            std::vector<size_t> last(producers, SIZE_MAX);
+            size_t item;
+            while (consumed.load(std::memory_order_relaxed) < total)
+            {
+                if (!queue.pop(item))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                consumed.fetch_add(1, std::memory_order_relaxed);
+                seen[item].fetch_add(1, std::memory_order_relaxed);
+                size_t p = item / perProducer;
+                if (consumers == 1 && last[p] != SIZE_MAX && item <= last[p])
+                    ordered.store(false, std::memory_order_relaxed);
+                last[p] = item;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    size_t missing = 0, duplicated = 0;
+    for (auto &s : seen)
+    {
+        unsigned char n = s.load(std::memory_order_relaxed);
+        missing += n == 0;
+        duplicated += n > 1;
+    }
+    if (missing || duplicated)
+        printf("%s: %zu missing, %zu duplicated\n", name, missing, duplicated);
+    check(missing == 0 && duplicated == 0 && queue.empty(), name);
+    if (consumers == 1)
+        check(ordered.load(), "per-producer order with one consumer");
+}
+
+// future的结果：值、"task rejected"或者"task dropped"
+static std::string outcome(Future<int> &future)
+{
+    try
+    {
+        return std::to_string(future.get());
+    }
+    catch (const std::runtime_error &e)
+    {
+        return e.what();
+    }
+}
+
+// 一个工作线程被gate挡住，任务队列容量为4，再提交10个任务
+struct Overloaded
+{
+    Threadpool pool;
+    std::atomic<bool> gate{false};
+    std::atomic<bool> started{false};
+
+    Overloaded(Mode mode, Overload policy)
+    {
+        pool.setMode(mode);
+        pool.setTaskQueueThreshold(4);
+        pool.setOverloadPolicy(policy);
+        pool.start(1);
+        pool.post([this]() {
+            started = true;
+            while (!gate)
+                std::this_thread::yield();
+        });
+        while (!started)
+            std::this_thread::yield();
+    }
+    void open() { gate = true; }
+};
+
+static void testReject()
+{
+    Overloaded o(Mode::FIXED, Overload::REJECT);
+    std::vector<Future<int>> futures;
+    for (int i = 0; i < 10; i++)
+        futures.push_back(o.pool.submit([i]() { return i; }));
+    o.open();
+    int done = 0, rejected = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        std::string result = outcome(futures[i]);
+        if (result == std::to_string(i))
+            done++;
+        else if (result == "task rejected")
+            rejected++;
+    }
+    check(done == 4 && rejected == 6 && o.pool.rejectedTasks() == 6, "REJECT: first 4 run, 6 rejected");
+}
+
+static void testShed()
+{
+    Overloaded o(Mode::FIXED, Overload::SHED);
+    std::vector<Future<int>> futures;
+    for (int i = 0; i < 10; i++)
+        futures.push_back(o.pool.submit([i]() { return i; }));
+    o.open();
+    bool oldestDropped = true, newestRun = true;
+    for (int i = 0; i < 10; i++)
+    {
+        std::string result = outcome(futures[i]);
+        if (i < 6)
+            oldestDropped = oldestDropped && result == "task dropped";
+        else
+            newestRun = newestRun && result == std::to_string(i);
+    }
+    check(oldestDropped && newestRun && o.pool.shedTasks() == 6, "SHED: oldest 6 dropped, newest 4 run");
+}
+
+static void testBlock()
+{
+    Overloaded o(Mode::FIXED, Overload::BLOCK);
+    std::atomic<int> ran(0);
+    std::atomic<int> submitted(0);
+    // 提交者在队列满之后阻塞，直到gate打开后工作线程开始消费
+    std::thread submitter([&]() {
+        for (int i = 0; i < 10; i++)
+        {
+            if (o.pool.post([&ran]() { ran++; }))
+                submitted++;
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    check(submitted.load() == 4, "BLOCK: submitter waits while the queue is full");
+    o.open();
+    submitter.join();
+    while (ran < 10)
+        std::this_thread::yield();
+    check(submitted.load() == 10 && o.pool.rejectedTasks() == 0, "BLOCK: every task accepted");
+
+    // 工作线程向自己所在的线程池提交：队列满时拒绝而不是等待自己
+    Overloaded self(Mode::FIXED, Overload::BLOCK);
+    self.open();
+    Future<int> accepted = self.pool.submit([&self]() {
+        int n = 0;
+        for (int i = 0; i < 10; i++)
+            n += self.pool.post([]() {}) ? 1 : 0;
+        return n;
+    });
+    check(outcome(accepted) == "4", "BLOCK: worker self-submit rejected when full");
+}
+
+// 严格亲和（溢出阈值为0）：收件队列满时任务仍然只在目标线程上执行
+static void testStrictAffinity(Overload policy, const char *name, int expectAccepted, int expectRun)
+{
+    Threadpool pool;
+    pool.setMode(Mode::STEALING);
+    pool.setTaskQueueThreshold(8);
+    pool.setOverloadPolicy(policy);
+    pool.start(2);
+    std::atomic<bool> gate(false), started(false);
+    std::thread::id target;
+    pool.postTo(0, [&]() {
+        target = std::this_thread::get_id();
+        started = true;
+        while (!gate)
+            std::this_thread::yield();
+    });
+    while (!started)
+        std::this_thread::yield();
+
+    std::atomic<int> ran(0), elsewhere(0);
+    std::thread opener([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        gate = true;
+    });
+    int accepted = 0;
+    const int TASKS = 600; // 超过收件队列的容量（256）
+    for (int i = 0; i < TASKS; i++)
+    {
+        accepted += pool.postTo(0, [&]() {
+            if (std::this_thread::get_id() != target)
+                elsewhere++;
+            ran++;
+        });
+    }
+    opener.join();
+    while (ran < expectRun)
+        std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    bool ok = accepted == expectAccepted && ran == expectRun && elsewhere == 0;
+    if (!ok)
+        printf("%s: accepted %d ran %d elsewhere %d\n", name, accepted, ran.load(), elsewhere.load());
+    check(ok, name);
+}
+
+int main()
+{
+    Logger::root()->setLevel(LogLevel::INFO);
+    for (int round = 0; round < 3; round++)
+    {
+        runQueue("mpmc 3x3", 3, 3, 100000);
+        runQueue("mpsc 4x1", 4, 1, 100000);
+    }
+    testReject();
+    testShed();
+    testBlock();
+    testStrictAffinity(Overload::REJECT, "strict affinity REJECT", 256, 256);
+    testStrictAffinity(Overload::SHED, "strict affinity SHED", 600, 256);
+    testStrictAffinity(Overload::BLOCK, "strict affinity BLOCK", 600, 600);
+    if (failures)
+        return 1;
+    printf("queue_test passed\n");
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Task 与 std::function 的对比测试
+// 1. 单线程：构造任务 -> 放入队列 -> 取出 -> 执行，统计耗时和堆分配次数
+// 2. 线程池：原来的 std::bind + std::function 提交方式与 post(lambda) 的吞吐量
+// 3. 工作窃取模式：工作线程向自己的本地队列提交（push/pop/steal），线程池在计时之外创建，只统计提交和执行
+#include "../threadpool.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <chrono>
+#include <thread>
+
+static std::atomic<long> allocCount(0);
+
+void *operator new(size_t size)
+{
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+struct Conn
+{
+    std::atomic<long> bytes{0};
+};
+
+struct Server
+{
+    void onRead(Conn *conn) { conn->bytes++; }
+};
+
+static const int ROUNDS = 1000000;
+
+// 执行时由工作线程提交下一个任务（进入本地队列），共有CHAINS条链同时进行，空闲线程互相窃取
+struct Chain
+{
+    static const long CHAINS = 4;
+    Threadpool *pool;
+    std::atomic<long> *left;
+
+    void operator()()
+    {
+        if (left->fetch_sub(1, std::memory_order_relaxed) > CHAINS)
+            pool->post(*this);
+    }
+};
+
+template <typename Fn>
+static void report(const char *name, long ops, Fn &&fn)
+{
+    long allocs = allocCount.load();
+    auto begin = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+    printf("%-36s %8.1f ns/op %6.2f allocs/op\n", name, ns / ops, double(allocCount.load() - allocs) / ops);
+}
+
+int main()
+{
+    Server server;
+    Conn conn;
+    Conn *extra[2] = {&conn, &conn};
+
+    // 原来的路径：std::bind 包装进 std::function，拷贝进加锁的 std::queue
+    report("std::function + std::queue", ROUNDS, [&]() {
+        std::mutex mtx;
+        std::queue<std::function<void()>> queue;
+        for (int i = 0; i < ROUNDS; i++)
+        {
+            std::function<void()> task = std::bind(&Server::onRead, &server, &conn);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                queue.emplace(task);
+            }
+            std::function<void()> out;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                out = std::move(queue.front());
+                queue.pop();
+            }
+            out();
+        }
+    });
+
+    // 捕获3个指针，超出 std::function 的小对象优化
+    report("std::function (3 ptrs) + std::queue", ROUNDS, [&]() {
+        std::mutex mtx;
+        std::queue<std::function<void()>> queue;
+        for (int i = 0; i < ROUNDS; i++)
+        {
+            std::function<void()> task = [s = &server, c = &conn, e = extra[i & 1]]() { s->onRead(c); e->bytes++; };
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                queue.emplace(task);
+            }
+            std::function<void()> out;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                out = std::move(queue.front());
+                queue.pop();
+            }
+            out();
+        }
+    });
+
+    report("Task (3 ptrs) + BoundedQueue", ROUNDS, [&]() {
+        BoundedQueue<Task> queue(1024);
+        for (int i = 0; i < ROUNDS; i++)
+        {
+            queue.push(Task([s = &server, c = &conn, e = extra[i & 1]]() { s->onRead(c); e->bytes++; }));
+            Task out;
+            queue.pop(out);
+            out();
+        }
+    });
+
+    // 线程池端到端吞吐量
+    const int POOL_TASKS = 200000;
+    report("Threadpool submitTask(std::bind)", POOL_TASKS, [&]() {
+        Threadpool pool;
+        pool.setMode(Mode::STEALING);
+        pool.setTaskQueueThreshold(4096);
+        pool.start(4);
+        for (int i = 0; i < POOL_TASKS; i++)
+            pool.submitTask(std::function<void()>(std::bind(&Server::onRead, &server, &conn)));
+    });
+
+    report("Threadpool post(lambda)", POOL_TASKS, [&]() {
+        Threadpool pool;
+        pool.setMode(Mode::STEALING);
+        pool.setTaskQueueThreshold(4096);
+        pool.start(4);
+        for (int i = 0; i < POOL_TASKS; i++)
+            pool.post([s = &server, c = &conn]() { s->onRead(c); });
+    });
+
+    {
+        Threadpool pool;
+        pool.setMode(Mode::STEALING);
+        pool.setTaskQueueThreshold(4096);
+        pool.start(4);
+        std::atomic<long> left(POOL_TASKS);
+        report("Threadpool post from worker (deque)", POOL_TASKS, [&]() {
+            for (long i = 0; i < Chain::CHAINS; i++)
+                pool.post(Chain{&pool, &left});
+            while (left.load() > 0)
+                std::this_thread::yield();
+        });
+    }
+    return 0;
+}
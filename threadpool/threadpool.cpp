@@ -1,11 +1,47 @@
 #include "threadpool.hpp"
-#include <iostream>
+#include "placement.hpp"
+#include "../log/log.hpp"
+#include "../metrics/usdt.hpp"
 #include <chrono>
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
-const int THREAD_MAX_IDLE_TIME = 60;
+const size_t TASK_MAX_THRESHOLD = 1024; // 任务队列默认容量
+const size_t INJECT_BATCH = 8;          // 工作线程一次从注入队列中最多取出的任务数量
+const size_t INBOX_MIN_SIZE = 256;      // 工作线程收件队列的最小容量
+const size_t LOCAL_SLOTS = 256;         // 工作线程本地队列的任务槽位数量（2的幂）
+const size_t LOCAL_SLOT_PROBE = 4;      // 压入本地队列时最多尝试的槽位数量，都被占用时从堆上分配
+
+// VARIABLE模式弹性伸缩的参数
+const int CONTROL_INTERVAL_MS = 50;  // 控制线程的采样周期
+const int HINT_INTERVAL_MS = 5;      // 两次提前唤醒之间的最小间隔
+const long GROW_WAIT_US = 2000;      // 默认扩容阈值：平均排队时间
+const long SHRINK_WAIT_US = 200;     // 默认缩容阈值：平均排队时间
+const double CPU_HEADROOM = 0.9;     // 进程CPU使用率超过该值时不再扩容，加线程也没有用
+const double SHRINK_BUSY = 0.5;      // 工作线程忙碌比例低于该值才缩容
+const int SHRINK_TICKS = 40;         // 连续满足缩容条件的周期数（滞回，扩容快、缩容慢）
+
+static int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t processCpuNs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000LL + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000LL;
+}
+
+// 当前线程所属的线程池及其在workers_中的下标（非STEALING模式为-1），用于判断任务是否由工作线程自己提交
+static thread_local Threadpool *tlsPool = nullptr;
+static thread_local int tlsIndex = -1;
 
 Threadpool::Threadpool()
-    : initThreadCounts_(0), threadpoolMode_(Mode::FIXED), threadCountThreshold(0), curThreadCount_(0), idleThreadCount_(0), taskCount_(0), isRunning_(false)
+    : initThreadCounts_(0), threadpoolMode_(Mode::FIXED), threadCountThreshold(0), curThreadCount_(0), idleThreadCount_(0), taskQueueThreshold(TASK_MAX_THRESHOLD), taskCount_(0), overloadPolicy_(Overload::BLOCK), rejectedCount_(0), shedCount_(0), waitingCount_(0), blockedCount_(0), inboxBlockedCount_(0), isRunning_(false), growHint_(false), retireCount_(0), growWaitUs_(GROW_WAIT_US), shrinkWaitUs_(SHRINK_WAIT_US), waitNsTotal_(0), busyNsTotal_(0), doneCount_(0), sleepingCount_(0), affinitySpill_(0), threadNice_(0)
 {
 }
 
@@ -14,9 +50,33 @@ Threadpool::~Threadpool() {
     {
         std::unique_lock<std::mutex> lock(mtx_);
         condTaskNotEmpty_.notify_all();  // 唤醒所有等待的线程
+        condTaskNotFull_.notify_all();   // 唤醒阻塞的提交者
+        condInboxNotFull_.notify_all();
+    }
+    {
+        std::unique_lock<std::mutex> lock(idleMtx_);
+        for (auto &worker : workers_)
+            worker->cond.notify_one();  // 唤醒休眠的工作窃取线程
+    }
+    {
+        std::unique_lock<std::mutex> lock(ctrlMtx_);
+        ctrlCond_.notify_one();
+    }
+    if (controller_.joinable())
+        controller_.join();
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        condExit_.wait(lock, [this]() { return threads_.empty(); });  // 等待所有线程退出
+    }
+    reapThreads_();
+    // 释放未执行的任务
+    for (auto &worker : workers_)
+    {
+        TaskSlot *slot;
+        Task task;
+        while (worker->deque.pop(slot))
+            takeSlot_(slot, task);
     }
-    std::unique_lock<std::mutex> lock(mtx_);
-    condExit_.wait(lock, [this]() { return threads_.empty(); });  // 等待所有线程退出
 }
 
 // 设置线程池工作模式
@@ -41,114 +101,399 @@ void Threadpool::setThreadCountThreshold(size_t threshold)
     if (threadpoolMode_ == Mode::VARIABLE)
         threadCountThreshold = threshold;
 }
-// 给线程池提交任务--生产者
-void Threadpool::submitTask(std::function<void()> sp)
+// 设置弹性伸缩的目标--只针对VARIABLE模式
+void Threadpool::setElasticTarget(long growWaitUs, long shrinkWaitUs)
 {
-    std::unique_lock<std::mutex> lock(mtx_);
-    // 将任务放入任务队列中
-    taskQueue_.emplace(sp);
-    // 任务数量+1
-    taskCount_++;
-    // 通知其他线程，任务队列中新放了任务，任务队列不为空
-    condTaskNotEmpty_.notify_all();
-    // 如果线程池模式是VARIABLE，可以根据任务数量和空闲线程的数量，来判断是否需要创建新的线程
-    if (threadpoolMode_ == Mode::VARIABLE && taskCount_ > idleThreadCount_ && curThreadCount_ < threadCountThreshold)
-    {
-        std::cout << "create new thread..." << std::endl;
-        // 创建新的线程对象
-        auto ptr = std::make_unique<Thread>(std::bind(&Threadpool::threadFunc, this, std::placeholders::_1));
-        int threadId = ptr->getThreadId();
-        threads_.emplace(threadId, std::move(ptr));
-        // 启动线程
-        threads_[threadId]->start();
-        curThreadCount_++;
-        idleThreadCount_++;
-    }
+    if (checkRunningState())
+        return;
+    growWaitUs_ = growWaitUs;
+    shrinkWaitUs_ = std::min(shrinkWaitUs, growWaitUs);
+}
+// 设置任务队列满时的处理策略
+void Threadpool::setOverloadPolicy(Overload policy)
+{
+    if (checkRunningState())
+        return;
+    overloadPolicy_ = policy;
+}
+// 设置连接亲和模式下的溢出阈值--只针对STEALING模式
+void Threadpool::setAffinitySpill(size_t threshold)
+{
+    if (checkRunningState())
+        return;
+    affinitySpill_ = threshold;
+}
+// 设置工作线程绑定的CPU
+void Threadpool::setCpuPlacement(const std::vector<int> &cpus)
+{
+    if (checkRunningState())
+        return;
+    cpus_ = cpus;
+}
+// 设置工作线程的nice值
+void Threadpool::setThreadNice(int nice)
+{
+    if (checkRunningState())
+        return;
+    threadNice_ = nice;
 }
 
-// 线程函数，处理任务--消费者
-void Threadpool::handleTask(int threadId)
+// 工作线程启动时绑定CPU，之后由该线程分配的内存（任务中增长的缓冲区、线程的malloc arena）都落在本地节点；
+// 由其他线程（reactor）分配并首先写入的内存不受影响
+void Threadpool::placeThread_(int slot)
 {
-    // 所有线程执行完毕，线程池才回收线程资源
-    auto lastTime = std::chrono::high_resolution_clock().now();
-    for (;;)
+    // Linux下nice值是线程级的
+    if (threadNice_ != 0 && setpriority(PRIO_PROCESS, syscall(SYS_gettid), threadNice_) != 0)
+        LOG_WARN("set thread nice %d failed!", threadNice_);
+    if (cpus_.empty())
+        return;
+    int cpu = cpus_[slot % cpus_.size()];
+    if (!pinCurrentThread({cpu}))
+        LOG_WARN("pin thread to cpu %d failed!", cpu);
+    preferMemoryNode(Topology::instance().nodeOfCpu(cpu));
+}
+
+// 将任务放入任务队列，队列满时按照overloadPolicy_处理
+bool Threadpool::enqueue_(Task &task)
+{
+    if (threadpoolMode_ == Mode::VARIABLE)
+        task.setEnqueueTime(nowNs());
+    if (taskQueue_->push(task))
+    {
+        taskCount_++;
+        return true;
+    }
+    switch (overloadPolicy_)
+    {
+    case Overload::REJECT:
+        rejectedCount_++;
+        return false;
+    case Overload::SHED:
     {
-        std::function<void()> task;
+        // 丢弃最旧的任务，为新任务腾出位置；被丢弃的任务在这里销毁，不会通知投递者
+        Task oldest;
+        while (!taskQueue_->push(task))
         {
-            std::unique_lock<std::mutex> lock(mtx_);
-            // 获取任务
-            while (taskQueue_.size() == 0)
+            if (taskQueue_->pop(oldest))
             {
-                if (!isRunning_)
-                {
-                    threads_.erase(threadId);
-                    std::cout << "threadid:" << std::this_thread::get_id() << " exit!" << std::endl;
-                    condExit_.notify_all();
-                    return;
-                }
-                if (threadpoolMode_ == Mode::VARIABLE)
-                {
-                    if (std::cv_status::timeout == condTaskNotEmpty_.wait_for(lock, std::chrono::seconds(1)))
-                    {
-                        auto now = std::chrono::high_resolution_clock().now();
-                        auto dur = std::chrono::duration_cast<std::chrono::seconds>(now - lastTime);
-                        if (dur.count() >= THREAD_MAX_IDLE_TIME && curThreadCount_ > initThreadCounts_)
-                        {
-                            threads_.erase(threadId);
-                            curThreadCount_--;
-                            idleThreadCount_--;
-                            std::cout << "threadid:" << std::this_thread::get_id() << " exit!" << std::endl;
-                            return;
-                        }
-                    }
-                }
-                else
-                {
-                    condTaskNotEmpty_.wait(lock);
-                }
+                taskCount_--;
+                shedCount_++;
             }
+        }
+        taskCount_++;
+        return true;
+    }
+    case Overload::BLOCK:
+    default:
+    {
+        // 工作线程向自己所在的线程池提交：等待的是自己，所有工作线程都这样等待时没有线程消费队列
+        if (tlsPool == this)
+        {
+            rejectedCount_++;
+            return false;
+        }
+        std::unique_lock<std::mutex> lock(mtx_);
+        blockedCount_++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool pushed = false;
+        condTaskNotFull_.wait(lock, [&]() { return (pushed = taskQueue_->push(task)) || !isRunning_; });
+        blockedCount_--;
+        if (!pushed)
+            return false;
+        taskCount_++;
+        return true;
+    }
+    }
+}
+
+// 从任务队列中取出一个任务之后调用，唤醒阻塞的提交者
+void Threadpool::onTaskTaken_()
+{
+    taskCount_--;
+    // 与enqueue_中阻塞前的检查配对
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (blockedCount_ > 0)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        condTaskNotFull_.notify_one();
+    }
+}
+
+// 给线程池提交任务--生产者
+bool Threadpool::submitTask(Task task)
+{
+    if (threadpoolMode_ == Mode::STEALING)
+        return submitStealing_(std::move(task));
+    // 将任务放入任务队列中，入队本身不加锁
+    if (!enqueue_(task))
+        return false;
+    // USDT探针 task_enqueue(线程池, 目标线程（-1为共享队列）, 任务数, 共享队列中的任务数)
+    TRACE_PROBE(threadpool, task_enqueue, this, -1, 1, taskCount_.load(std::memory_order_relaxed));
+    // 只有存在等待中的线程时才加锁，通知其中一个线程任务队列不为空
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waitingCount_ > 0)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        condTaskNotEmpty_.notify_one();
+    }
+    // VARIABLE模式下线程数量由控制线程决定，这里只在没有空闲线程时提前唤醒控制线程
+    if (threadpoolMode_ == Mode::VARIABLE && idleThreadCount_ == 0 && curThreadCount_ < threadCountThreshold && !growHint_.exchange(true))
+        ctrlCond_.notify_one();
+    return true;
+}
+
+// 唤醒最多count个等待condTaskNotEmpty_的线程
+void Threadpool::wakeWaiting_(size_t count)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waitingCount_ == 0)
+        return;
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (count >= waitingCount_)
+    {
+        condTaskNotEmpty_.notify_all();
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+        condTaskNotEmpty_.notify_one();
+}
 
-            idleThreadCount_--;
-            std::cout << "tid:" << std::this_thread::get_id() << "获取任务成功..." << std::endl;
-            // 获取任务成功
-            task = std::move(taskQueue_.front());
-            taskQueue_.pop();
-            taskCount_--;
-            // 如果有任务，通知其他线程继续执行任务
-            if (taskQueue_.size() > 0)
-                condTaskNotEmpty_.notify_all();
-            // 取出一个任务，通知此时任务队列不满
-            condTaskNotFull_.notify_all();
+// 批量提交任务
+size_t Threadpool::submitBatch(std::vector<Task> &tasks)
+{
+    size_t total = tasks.size();
+    size_t accepted = 0;
+    int target = -1; // 放入的队列：-1为共享队列，否则为工作线程的本地队列
+    if (threadpoolMode_ == Mode::STEALING && tlsPool == this && tlsIndex >= 0)
+    {
+        target = tlsIndex;
+        // 工作线程自己提交的任务直接放入本地队列，由空闲线程窃取
+        for (auto &task : tasks)
+            pushLocal_(*workers_[tlsIndex], task);
+        accepted = total;
+    }
+    else
+    {
+        if (threadpoolMode_ == Mode::VARIABLE)
+        {
+            int64_t now = nowNs();
+            for (auto &task : tasks)
+                task.setEnqueueTime(now);
         }
-        // 执行任务
-        task();
-        // 任务执行完，空闲线程数量+1
-        idleThreadCount_++;
-        lastTime = std::chrono::high_resolution_clock().now();
+        // 先一次占用尽可能多的槽位
+        accepted = taskQueue_->pushBatch(tasks.data(), total);
+        taskCount_ += accepted;
+    }
+    TRACE_PROBE(threadpool, task_enqueue, this, target, static_cast<int>(accepted), taskCount_.load(std::memory_order_relaxed));
+    notifyBatch_(accepted);
+    // 队列放不下的任务逐个按照过载策略入队；BLOCK策略下可能阻塞，因此前面的任务要先唤醒线程去消费
+    while (accepted < total && enqueue_(tasks[accepted]))
+    {
+        accepted++;
+        notifyBatch_(1);
+    }
+    return accepted;
+}
+
+// 新放入count个任务之后唤醒线程
+void Threadpool::notifyBatch_(size_t count)
+{
+    if (count == 0)
+        return;
+    if (threadpoolMode_ == Mode::STEALING)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (size_t i = 0; i < count && sleepingCount_ > 0; i++)
+            wakeOne_();
+        return;
     }
+    wakeWaiting_(count);
+    if (threadpoolMode_ == Mode::VARIABLE && idleThreadCount_ < count && curThreadCount_ < threadCountThreshold && !growHint_.exchange(true))
+        ctrlCond_.notify_one();
+}
+
+// 线程函数，处理任务--消费者
+void Threadpool::handleTask(int threadId, int slot)
+{
+    threadFunc(threadId, slot);
 }
 
 // 开启线程池
 void Threadpool::start(int threadCount)
 {
+    // 任务队列的容量在启动之后不能再修改
+    taskQueue_ = std::make_unique<BoundedQueue<Task>>(taskQueueThreshold);
     // 线程池的运行状态
     isRunning_ = true;
     // 初始化线程个数
     initThreadCounts_ = threadCount;
     curThreadCount_ = threadCount;
-    // 创建线程对象
+    // 工作窃取模式：每个工作线程一个本地队列
+    if (threadpoolMode_ == Mode::STEALING)
+    {
+        for (int i = 0; i < threadCount; i++)
+        {
+            workers_.emplace_back(std::make_unique<Worker>());
+            workers_.back()->inbox = std::make_unique<BoundedQueue<Task>>(std::max(taskQueueThreshold / threadCount, INBOX_MIN_SIZE));
+            workers_.back()->seed = 2654435761u * (i + 1);
+            workers_.back()->slots = std::make_unique<TaskSlot[]>(LOCAL_SLOTS);
+        }
+    }
+    // 创建线程对象，第i个线程占用池内的槽位i
+    slots_.assign(threadCount, true);
+    std::vector<int> threadIds;
     for (int i = 0; i < threadCount; i++)
     {
-        auto ptr = std::make_unique<Thread>(std::bind(&Threadpool::threadFunc, this, std::placeholders::_1));
+        std::unique_ptr<Thread> ptr;
+        if (threadpoolMode_ == Mode::STEALING)
+            ptr = std::make_unique<Thread>([this, i](int threadId) { stealingFunc(threadId, i); });
+        else
+            ptr = std::make_unique<Thread>([this, i](int threadId) { threadFunc(threadId, i); });
         int threadId = ptr->getThreadId();
         threads_.emplace(threadId, std::move(ptr));
+        threadIds.push_back(threadId);
     }
 
     // 启动所有线程
-    for (int i = 0; i < threadCount; i++)
+    for (int threadId : threadIds)
+    {
+        threads_[threadId]->start(); // 需要去执行一个线程函数
+        idleThreadCount_++;          // 记录初始空闲线程的数量
+    }
+    if (threadpoolMode_ == Mode::VARIABLE)
+        controller_ = std::thread(&Threadpool::controllerFunc_, this);
+}
+
+// 线程退出时调用（持有mtx_）：线程不能回收自己，交给控制线程或析构函数join
+void Threadpool::exitThread_(int threadId)
+{
+    auto it = threads_.find(threadId);
+    if (it != threads_.end())
+    {
+        exitedThreads_.push_back(std::move(it->second));
+        threads_.erase(it);
+    }
+    LOG_DEBUG("thread %d exit!", threadId);
+    condExit_.notify_all();
+}
+
+// 分配最小的空闲槽位（持有mtx_）：缩容后再扩容的线程沿用空出的槽位，绑定的CPU不会漂移
+int Threadpool::acquireSlot_()
+{
+    auto it = std::find(slots_.begin(), slots_.end(), false);
+    if (it != slots_.end())
+    {
+        *it = true;
+        return static_cast<int>(it - slots_.begin());
+    }
+    slots_.push_back(true);
+    return static_cast<int>(slots_.size()) - 1;
+}
+
+// join已经退出的线程
+void Threadpool::reapThreads_()
+{
+    std::vector<std::unique_ptr<Thread>> exited;
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        exited.swap(exitedThreads_);
+    }
+    exited.clear();
+}
+
+// 扩容一个线程：线程对象在锁外创建，只在登记到threads_时加锁
+void Threadpool::growThread_()
+{
+    int slot;
     {
-        threads_[i]->start(); // 需要去执行一个线程函数
-        idleThreadCount_++;   // 记录初始空闲线程的数量
+        std::unique_lock<std::mutex> lock(mtx_);
+        slot = acquireSlot_();
+    }
+    auto ptr = std::make_unique<Thread>([this, slot](int threadId) { threadFunc(threadId, slot); });
+    Thread *thread = ptr.get();
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        threads_.emplace(thread->getThreadId(), std::move(ptr));
+    }
+    curThreadCount_++;
+    idleThreadCount_++;
+    thread->start();
+    LOG_INFO("create new thread... total:%u", curThreadCount_.load());
+}
+
+// 缩容一个线程：请求一个空闲线程退出，只唤醒一个等待中的线程
+void Threadpool::retireThread_()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (waitingCount_ == 0)
+        return;
+    retireCount_++;
+    condTaskNotEmpty_.notify_one();
+}
+
+// 根据平均排队时间和CPU使用率调整线程数量，范围为[初始线程数, threadCountThreshold]
+void Threadpool::controllerFunc_()
+{
+    static const long cpuCount = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    int64_t lastTime = nowNs();
+    int64_t lastCpu = processCpuNs();
+    unsigned long lastWait = 0, lastBusy = 0, lastDone = 0;
+    int64_t lastAction = lastTime;
+    int calmTicks = 0;
+
+    std::unique_lock<std::mutex> lock(ctrlMtx_);
+    while (isRunning_)
+    {
+        ctrlCond_.wait_for(lock, std::chrono::milliseconds(CONTROL_INTERVAL_MS), [&]() {
+            return !isRunning_ || (growHint_ && nowNs() - lastAction >= HINT_INTERVAL_MS * 1000000LL);
+        });
+        if (!isRunning_)
+            break;
+        reapThreads_();
+
+        int64_t now = nowNs();
+        int64_t cpu = processCpuNs();
+        lastAction = now;
+        unsigned long wait = waitNsTotal_, busy = busyNsTotal_, done = doneCount_;
+        int64_t elapsed = std::max<int64_t>(now - lastTime, 1);
+        unsigned long doneDelta = done - lastDone;
+        unsigned int threads = curThreadCount_;
+        // 平均排队时间；没有任务完成但队列中有任务时，说明所有线程都被占住了
+        long avgWaitUs;
+        if (doneDelta > 0)
+            avgWaitUs = (wait - lastWait) / doneDelta / 1000;
+        else
+            avgWaitUs = taskCount_ > 0 ? elapsed / 1000 : 0;
+        double busyRatio = double(busy - lastBusy) / (double(elapsed) * std::max(threads, 1u));
+        double cpuUsage = double(cpu - lastCpu) / (double(elapsed) * cpuCount);
+        bool hinted = growHint_.exchange(false);
+
+        // 提前唤醒时如果采样时间太短，只在没有空闲线程时扩容
+        if ((avgWaitUs > growWaitUs_ || (hinted && idleThreadCount_ == 0 && taskCount_ > 0)) && cpuUsage < CPU_HEADROOM && threads < threadCountThreshold)
+        {
+            calmTicks = 0;
+            growThread_();
+        }
+        else if (avgWaitUs < shrinkWaitUs_ && busyRatio < SHRINK_BUSY && threads > initThreadCounts_)
+        {
+            if (++calmTicks >= SHRINK_TICKS)
+            {
+                calmTicks = 0;
+                retireThread_();
+            }
+        }
+        else
+        {
+            calmTicks = 0;
+        }
+
+        if (hinted && elapsed < CONTROL_INTERVAL_MS * 1000000LL)
+            continue; // 采样周期不完整，保留上一次的基准
+        lastTime = now;
+        lastCpu = cpu;
+        lastWait = wait;
+        lastBusy = busy;
+        lastDone = done;
     }
 }
 
@@ -157,68 +502,338 @@ bool Threadpool::checkRunningState() const
     return isRunning_;
 }
 // 线程池中的线程只需要处理读和写时间，读取http请求报文，写（发送）http响应报文
-void Threadpool::threadFunc(int threadId)
+// slot为线程在本线程池内的槽位，绑定CPU时使用，和全局的线程编号无关
+void Threadpool::threadFunc(int threadId, int slot)
 {
-    // 所有线程执行完毕，线程池才回收线程资源
-    auto lastTime = std::chrono::high_resolution_clock().now();
+    placeThread_(slot);
+    tlsPool = this;
     for (;;)
     {
-        std::function<void()> task;
+        Task task;
+        // 先无锁地尝试获取任务，失败后再加锁等待
+        if (!taskQueue_->pop(task))
         {
             std::unique_lock<std::mutex> lock(mtx_);
-            // 获取任务
-            while (taskQueue_.size() == 0)
+            waitingCount_++;
+            // 与submitTask中的检查配对，登记等待之后再检查一次任务队列
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while (!taskQueue_->pop(task))
             {
-                if (!isRunning_)
-                {
-                    threads_.erase(threadId);
-                    std::cout << "threadid:" << std::this_thread::get_id() << " exit!" << std::endl;
-                    condExit_.notify_all();
-                    return;
-                }
-                if (threadpoolMode_ == Mode::VARIABLE)
+                // 线程池关闭，或者控制线程要求一个空闲线程退出
+                if (!isRunning_ || retireCount_ > 0)
                 {
-                    if (std::cv_status::timeout == condTaskNotEmpty_.wait_for(lock, std::chrono::seconds(1)))
+                    if (isRunning_)
                     {
-                        auto now = std::chrono::high_resolution_clock().now();
-                        auto dur = std::chrono::duration_cast<std::chrono::seconds>(now - lastTime);
-                        if (dur.count() >= THREAD_MAX_IDLE_TIME && curThreadCount_ > initThreadCounts_)
-                        {
-                            threads_.erase(threadId);
-                            curThreadCount_--;
-                            idleThreadCount_--;
-                            std::cout << "threadid:" << std::this_thread::get_id() << " exit!" << std::endl;
-                            return;
-                        }
+                        retireCount_--;
+                        curThreadCount_--;
+                        idleThreadCount_--;
                     }
+                    waitingCount_--;
+                    slots_[slot] = false;
+                    exitThread_(threadId);
+                    return;
                 }
-                else
-                {
-                    condTaskNotEmpty_.wait(lock);
-                }
+                // 空闲线程一直休眠，不做周期性的唤醒
+                condTaskNotEmpty_.wait(lock);
             }
-
-            idleThreadCount_--;
-            std::cout << "tid:" << std::this_thread::get_id() << "获取任务成功..." << std::endl;
-            // 获取任务成功
-            task = std::move(taskQueue_.front());
-            taskQueue_.pop();
-            taskCount_--;
-            // 如果有任务，通知其他线程继续执行任务
-            if (taskQueue_.size() > 0)
-                condTaskNotEmpty_.notify_all();
-            // 取出一个任务，通知此时任务队列不满
-            condTaskNotFull_.notify_all();
+            waitingCount_--;
         }
+
+        idleThreadCount_--;
+        LOG_DEBUG("thread %d 获取任务成功...", threadId);
+        // 取出一个任务，通知此时任务队列不满
+        onTaskTaken_();
         // 执行任务
-        task();
+        if (threadpoolMode_ == Mode::VARIABLE)
+        {
+            int64_t begin = nowNs();
+            waitNsTotal_.fetch_add(begin - task.enqueueTime(), std::memory_order_relaxed);
+            // USDT探针 task_dequeue(线程池, 线程, 共享队列中的任务数, 排队时间（纳秒，只有VARIABLE模式记录入队时间）)
+            TRACE_PROBE(threadpool, task_dequeue, this, threadId, taskCount_.load(std::memory_order_relaxed), begin - task.enqueueTime());
+            task();
+            busyNsTotal_.fetch_add(nowNs() - begin, std::memory_order_relaxed);
+            doneCount_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            TRACE_PROBE(threadpool, task_dequeue, this, threadId, taskCount_.load(std::memory_order_relaxed), int64_t(0));
+            task();
+        }
         // 任务执行完，空闲线程数量+1
         idleThreadCount_++;
-        lastTime = std::chrono::high_resolution_clock().now();
     }
 }
 
-int Thread::generateId_ = 0;
+// 工作窃取模式提交任务：工作线程提交的任务放入自己的本地队列，其他线程（reactor）提交的任务放入注入队列
+bool Threadpool::submitStealing_(Task task)
+{
+    if (tlsPool == this && tlsIndex >= 0)
+    {
+        pushLocal_(*workers_[tlsIndex], task);
+        TRACE_PROBE(threadpool, task_enqueue, this, tlsIndex, 1, taskCount_.load(std::memory_order_relaxed));
+    }
+    else if (!enqueue_(task))
+    {
+        return false;
+    }
+    else
+    {
+        TRACE_PROBE(threadpool, task_enqueue, this, -1, 1, taskCount_.load(std::memory_order_relaxed));
+    }
+    // 与工作线程休眠前的二次检查配对，保证不会丢失唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepingCount_ > 0)
+        wakeOne_();
+    return true;
+}
+
+// 拥有者线程把任务压入本地队列：按顺序复用已经归还的槽位，本地队列积压太多、槽位都被占用时才从堆上分配
+void Threadpool::pushLocal_(Worker &worker, Task &task)
+{
+    TaskSlot *slot = nullptr;
+    for (size_t i = 0; i < LOCAL_SLOT_PROBE && !slot; i++)
+    {
+        TaskSlot &candidate = worker.slots[worker.slotCursor++ & (LOCAL_SLOTS - 1)];
+        if (!candidate.busy.load(std::memory_order_acquire))
+            slot = &candidate;
+    }
+    if (!slot)
+    {
+        slot = new TaskSlot;
+        slot->pooled = false;
+    }
+    slot->task = std::move(task);
+    slot->busy.store(true, std::memory_order_relaxed);
+    worker.deque.push(slot); // push中的release栅栏保证窃取者看到完整的任务
+}
+
+// 取出槽位中的任务并归还槽位，此后拥有者线程可以重新填入
+void Threadpool::takeSlot_(TaskSlot *slot, Task &task)
+{
+    task = std::move(slot->task);
+    if (slot->pooled)
+        slot->busy.store(false, std::memory_order_release);
+    else
+        delete slot;
+}
+
+// 亲和提交：任务放入key对应工作线程的收件队列
+bool Threadpool::submitTaskTo(size_t key, Task task)
+{
+    if (threadpoolMode_ != Mode::STEALING)
+        return submitTask(std::move(task));
+    int index = static_cast<int>(key % workers_.size());
+    if (!workers_[index]->inbox->push(task))
+    {
+        // 收件队列满：允许溢出时交给任意线程，否则在目标线程的收件队列上按照过载策略处理
+        if (affinitySpill_ > 0)
+            return submitStealing_(std::move(task));
+        if (!enqueueInbox_(*workers_[index], task))
+            return false;
+    }
+    TRACE_PROBE(threadpool, task_enqueue, this, index, 1, taskCount_.load(std::memory_order_relaxed));
+    // 与工作线程休眠前的二次检查配对
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepingCount_ > 0)
+    {
+        wakeWorker_(index);
+        // 目标线程积压过多，再唤醒一个空闲线程来分担
+        if (isSaturated_(*workers_[index]))
+            wakeOne_();
+    }
+    return true;
+}
+
+// 严格亲和（不允许溢出）时收件队列已满：任务只能进入目标线程的收件队列，不交给共享队列
+bool Threadpool::enqueueInbox_(Worker &worker, Task &task)
+{
+    switch (overloadPolicy_)
+    {
+    case Overload::REJECT:
+        rejectedCount_++;
+        return false;
+    case Overload::SHED:
+    {
+        // 丢弃该线程收件队列中最旧的任务
+        Task oldest;
+        while (!worker.inbox->push(task))
+        {
+            if (worker.inbox->pop(oldest))
+                shedCount_++;
+        }
+        return true;
+    }
+    case Overload::BLOCK:
+    default:
+    {
+        // 与enqueue_相同，工作线程不能等待自己所在线程池的队列
+        if (tlsPool == this)
+        {
+            rejectedCount_++;
+            return false;
+        }
+        std::unique_lock<std::mutex> lock(mtx_);
+        inboxBlockedCount_++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool pushed = false;
+        condInboxNotFull_.wait(lock, [&]() { return (pushed = worker.inbox->push(task)) || !isRunning_; });
+        inboxBlockedCount_--;
+        return pushed;
+    }
+    }
+}
+
+// 从收件队列中取出任务之后调用：等待的提交者可能在等任意一个收件队列，全部唤醒各自重试
+void Threadpool::onInboxTaken_()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (inboxBlockedCount_ > 0)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        condInboxNotFull_.notify_all();
+    }
+}
+
+// 收件队列积压超过溢出阈值，允许其他线程窃取
+bool Threadpool::isSaturated_(const Worker &worker) const
+{
+    return affinitySpill_ > 0 && worker.inbox->size() >= affinitySpill_;
+}
+
+// 依次从收件队列、本地队列、注入队列、其他线程的队列中获取任务
+bool Threadpool::findTask_(int index, Task &task)
+{
+    Worker &self = *workers_[index];
+    if (self.inbox->pop(task))
+    {
+        onInboxTaken_();
+        return true;
+    }
+
+    TaskSlot *slot = nullptr;
+    if (self.deque.pop(slot))
+    {
+        takeSlot_(slot, task);
+        return true;
+    }
+
+    if (taskQueue_->pop(task))
+    {
+        onTaskTaken_();
+        // 注入队列较长时多取几个放入本地队列，减少对注入队列的竞争，也让空闲线程有任务可偷
+        size_t batch = std::min(taskQueue_->size() / workers_.size(), INJECT_BATCH - 1);
+        size_t moved = 0;
+        Task extra;
+        while (moved < batch && taskQueue_->pop(extra))
+        {
+            onTaskTaken_();
+            pushLocal_(self, extra);
+            moved++;
+        }
+        if (moved > 0 && sleepingCount_ > 0)
+            wakeOne_();
+        return true;
+    }
+
+    // 随机选择起点，依次尝试窃取
+    size_t n = workers_.size();
+    size_t start = rand_r(&self.seed) % n;
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t victim = (start + i) % n;
+        if (victim == static_cast<size_t>(index))
+            continue;
+        if (workers_[victim]->deque.steal(slot))
+        {
+            takeSlot_(slot, task);
+            return true;
+        }
+        // 亲和模式下的溢出：分担积压过多的线程的收件队列
+        if (isSaturated_(*workers_[victim]) && workers_[victim]->inbox->pop(task))
+        {
+            onInboxTaken_();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Threadpool::hasStealableTask_(int index) const
+{
+    if (!taskQueue_->empty() || !workers_[index]->inbox->empty())
+        return true;
+    for (auto &worker : workers_)
+    {
+        if (!worker->deque.empty() || isSaturated_(*worker))
+            return true;
+    }
+    return false;
+}
+
+// 定向唤醒一个休眠的工作线程
+void Threadpool::wakeOne_()
+{
+    std::lock_guard<std::mutex> lock(idleMtx_);
+    if (idleWorkers_.empty())
+        return;
+    int index = idleWorkers_.back();
+    idleWorkers_.pop_back();
+    sleepingCount_--;
+    workers_[index]->wakeup = true;
+    workers_[index]->cond.notify_one();
+}
+
+// 唤醒指定的工作线程（如果它正在休眠）
+void Threadpool::wakeWorker_(int index)
+{
+    std::lock_guard<std::mutex> lock(idleMtx_);
+    auto it = std::find(idleWorkers_.begin(), idleWorkers_.end(), index);
+    if (it == idleWorkers_.end())
+        return;
+    idleWorkers_.erase(it);
+    sleepingCount_--;
+    workers_[index]->wakeup = true;
+    workers_[index]->cond.notify_one();
+}
+
+void Threadpool::stealingFunc(int threadId, int index)
+{
+    placeThread_(index);
+    tlsPool = this;
+    tlsIndex = index;
+    Worker &self = *workers_[index];
+    for (;;)
+    {
+        Task task;
+        if (findTask_(index, task))
+        {
+            TRACE_PROBE(threadpool, task_dequeue, this, index, taskCount_.load(std::memory_order_relaxed), int64_t(0));
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMtx_);
+        if (!isRunning_)
+            break;
+        idleWorkers_.push_back(index);
+        sleepingCount_++;
+        // 登记休眠之后再检查一次任务，和submitStealing_中的检查配对
+        if (!hasStealableTask_(index))
+            self.cond.wait(lock, [&]() { return self.wakeup || !isRunning_; });
+        if (!self.wakeup)
+        {
+            // 没有被wakeOne_取走，自己从休眠列表中移除
+            idleWorkers_.erase(std::find(idleWorkers_.begin(), idleWorkers_.end(), index));
+            sleepingCount_--;
+        }
+        self.wakeup = false;
+    }
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    exitThread_(threadId);
+}
+
+std::atomic<int> Thread::generateId_(0);
 // 线程构造
 Thread::Thread(ThreadFunc func)
     : threadId_(generateId_++)
@@ -228,15 +843,16 @@ Thread::Thread(ThreadFunc func)
 // 线程析构
 Thread::~Thread()
 {
+    if (thread_.joinable())
+        thread_.join();
 }
 // 启动线程
 void Thread::start()
 {
-    std::thread t(func_, threadId_);
-    t.detach(); // 设置线程分离模式
+    thread_ = std::thread(func_, threadId_);
 }
 // 获取线程id
 int Thread::getThreadId() const
 {
     return threadId_;
-}
\ No newline at end of file
+}
@@ -6,24 +6,29 @@
 #include <condition_variable>
 #include <functional>
 #include <thread>
-#include <queue>
 #include <atomic>
 #include <unordered_map>
+#include <memory>
 
-// 任务抽象基类
-// class Task
-// {
-// public:
-//     Task();
-//     virtual ~Task();
-//     virtual void run() = 0;
-// };
+#include "chaselevdeque.hpp"
+#include "boundedqueue.hpp"
+#include "task.hpp"
+#include "future.hpp"
 
-// 线程池的工作模式:固定线程数量的线程池；可变线程数量的线程池
+// 线程池的工作模式:固定线程数量的线程池；可变线程数量的线程池；工作窃取线程池
 enum class Mode
 {
     FIXED,
-    VARIABLE
+    VARIABLE,
+    STEALING
+};
+
+// 任务队列满时的处理策略
+enum class Overload
+{
+    BLOCK,  // 阻塞等待队列有空位；提交者是本线程池的工作线程时不等待（自己等自己会死锁），按拒绝处理
+    REJECT, // 拒绝，submitTask返回false
+    SHED    // 丢弃最旧的任务：post的任务直接销毁，submit的future以异常结束；不能用于必须完成的任务
 };
 
 // 线程类
@@ -37,7 +42,7 @@ public:
 public:
     // 线程构造
     Thread(ThreadFunc func);
-    // 线程析构
+    // 线程析构，等待线程结束
     ~Thread();
     // 启动线程
     void start();
@@ -45,9 +50,10 @@ public:
     int getThreadId() const;
 
 private:
-    size_t threadId_;
+    int threadId_;
     ThreadFunc func_;
-    static int generateId_;
+    std::thread thread_;
+    static std::atomic<int> generateId_;
 };
 
 class Threadpool
@@ -68,35 +74,158 @@ public:
     void setTaskQueueThreshold(size_t threshold);
     // 设置线程数量的阈值--只针对VARIABLE模式
     void setThreadCountThreshold(size_t threshold);
+    // 设置弹性伸缩的目标--只针对VARIABLE模式
+    // 平均排队时间超过growWaitUs且CPU还有余量时扩容，低于shrinkWaitUs且线程较空闲时缩容
+    void setElasticTarget(long growWaitUs, long shrinkWaitUs);
+    // 设置任务队列满时的处理策略
+    void setOverloadPolicy(Overload policy);
+    // 设置连接亲和模式下的溢出阈值--只针对STEALING模式
+    // 工作线程的收件队列积压超过该值时，其他空闲线程可以窃取其中的任务，收件队列满时交给任意线程；
+    // 0表示严格亲和，不允许溢出，收件队列满时在该队列上按照过载策略阻塞、拒绝或丢弃
+    void setAffinitySpill(size_t threshold);
+    // 设置工作线程绑定的CPU，第i个线程绑定到cpus[i % cpus.size()]，并优先使用该CPU所在NUMA节点的内存
+    void setCpuPlacement(const std::vector<int> &cpus);
+    // 设置工作线程的nice值（线程级调度优先级），值越大优先级越低
+    void setThreadNice(int nice);
 
 public:
-    // 给线程池提交任务--生产者
-    void submitTask(std::function<void()> sp);
+    // 给线程池提交任务--生产者，任务被拒绝时返回false
+    bool submitTask(Task task);
+    // 投递任意可调用对象，不关心结果；足够小的可调用对象直接构造在Task内部，不需要堆分配
+    template <typename F>
+    bool post(F &&func)
+    {
+        return submitTask(Task(std::forward<F>(func)));
+    }
+    // 提交任务并返回Future，通过get()取得返回值或者任务抛出的异常；任务被拒绝时返回已失败的Future，
+    // 被SHED策略丢弃时future以"task dropped"异常结束
+    template <typename F, typename R = std::invoke_result_t<typename std::decay<F>::type &>>
+    Future<R> submit(F &&func)
+    {
+        auto state = std::make_shared<FutureState<R>>();
+        if (!submitTask(Task([promise = Promise<R>(state), fn = typename std::decay<F>::type(std::forward<F>(func))]() mutable { promise.fulfill(fn); })))
+            return Future<R>::failed(std::make_exception_ptr(std::runtime_error("task rejected")));
+        return Future<R>(state);
+    }
+    // 批量提交：一次占用任务队列中的多个槽位，并且只唤醒min(任务数, 空闲线程数)个线程
+    // 返回被接受的任务数量n，tasks中前n个任务被移走，其余任务保持不变（REJECT策略下队列已满）
+    size_t submitBatch(std::vector<Task> &tasks);
+    // 按照key（文件描述符或连接分配的工作线程）把任务交给固定的工作线程，同一个连接的任务总在同一个线程上执行
+    // 非STEALING模式下等同于submitTask
+    bool submitTaskTo(size_t key, Task task);
+    template <typename F>
+    bool postTo(size_t key, F &&func)
+    {
+        return submitTaskTo(key, Task(std::forward<F>(func)));
+    }
+    // 当前的工作线程数量
+    unsigned int threadCount() const { return curThreadCount_; }
+    // 空闲线程、排队任务、被拒绝和被丢弃任务的数量（指标抓取时读取）
+    unsigned int idleThreadCount() const { return idleThreadCount_; }
+    unsigned int queuedTasks() const { return taskCount_; }
+    unsigned long rejectedTasks() const { return rejectedCount_; }
+    unsigned long shedTasks() const { return shedCount_; }
     // 线程函数，处理任务--消费者
-    void handleTask(int threadId);
+    void handleTask(int threadId, int slot);
 
     void start(int threadCount = std::thread::hardware_concurrency());
 
 public:
     bool checkRunningState() const;
-    void threadFunc(int threadId);
+    void threadFunc(int threadId, int slot);
+    // 工作窃取模式的线程函数，index为工作线程在workers_中的下标
+    void stealingFunc(int threadId, int index);
 
 private:
+    // 本地队列中存放任务的槽位：由拥有者线程填入，取走任务的线程（拥有者或窃取者）归还
+    struct alignas(64) TaskSlot
+    {
+        Task task;
+        std::atomic<bool> busy{false};
+        bool pooled = true; // 槽位用完时临时从堆上分配的为false
+    };
+
+    // 工作窃取模式下每个工作线程的私有数据
+    struct Worker
+    {
+        ChaseLevDeque<TaskSlot *> deque;          // 本地任务双端队列
+        std::unique_ptr<TaskSlot[]> slots;         // 预先分配的槽位环，压入本地队列时不再分配内存
+        size_t slotCursor = 0;                     // 下一个尝试的槽位，只由拥有者线程访问
+        std::unique_ptr<BoundedQueue<Task>> inbox; // 收件队列，存放亲和到该线程的任务
+        std::condition_variable cond;              // 定向唤醒该线程
+        bool wakeup = false;                       // 由idleMtx_保护
+        unsigned int seed = 0;                     // 随机选择窃取对象
+    };
+
+    bool enqueue_(Task &task);
+    void onTaskTaken_();
+    bool submitStealing_(Task task);
+    void pushLocal_(Worker &worker, Task &task);
+    static void takeSlot_(TaskSlot *slot, Task &task);
+    bool findTask_(int index, Task &task);
+    bool hasStealableTask_(int index) const;
+    bool isSaturated_(const Worker &worker) const;
+    bool enqueueInbox_(Worker &worker, Task &task);
+    void onInboxTaken_();
+    void wakeOne_();
+    void wakeWaiting_(size_t count);
+    void notifyBatch_(size_t count);
+    void wakeWorker_(int index);
+    void placeThread_(int slot);
+    int acquireSlot_();
+    void exitThread_(int threadId);
+    void reapThreads_();
+    // VARIABLE模式的弹性伸缩控制线程
+    void controllerFunc_();
+    void growThread_();
+    void retireThread_();
+
     std::unordered_map<int, std::unique_ptr<Thread>> threads_; // 线程队列
     size_t initThreadCounts_;                                  // 固定线程数量的线程池      // std::thread::hardware_concurrency();         //获取硬件支持的线程数
     Mode threadpoolMode_;                                      // 线程池工作模式
     long unsigned int threadCountThreshold;                    // 线程数量的上限
     std::atomic<unsigned int> curThreadCount_;                 // 线程池中的线程总数量
     std::atomic<unsigned int> idleThreadCount_;                // 空闲线程的数量
-    std::queue<std::function<void()>> taskQueue_;              // 任务队列
+    std::unique_ptr<BoundedQueue<Task>> taskQueue_;            // 任务队列（工作窃取模式下作为全局注入队列）
     size_t taskQueueThreshold;                                 // 任务队列中存放任务数量的上限
     std::atomic<unsigned int> taskCount_;                      // 任务队列中任务的数量
-    std::mutex mtx_;                                           // 保护任务队列的线程安全
+    Overload overloadPolicy_;                                  // 任务队列满时的处理策略
+    std::atomic<unsigned long> rejectedCount_;                 // 被拒绝的任务数量
+    std::atomic<unsigned long> shedCount_;                     // 被丢弃的任务数量
+    std::mutex mtx_;                                           // 保护线程队列，以及等待/唤醒
     std::condition_variable condTaskNotEmpty_;                 // 任务队列中进行线程通信 任务队列非空
     std::condition_variable condTaskNotFull_;                  // 任务队列不满
+    std::atomic<unsigned int> waitingCount_;                   // 等待condTaskNotEmpty_的线程数量
+    std::atomic<unsigned int> blockedCount_;                   // 等待condTaskNotFull_的提交者数量
+    std::condition_variable condInboxNotFull_;                 // 严格亲和模式下收件队列不满
+    std::atomic<unsigned int> inboxBlockedCount_;              // 等待condInboxNotFull_的提交者数量
 
     std::atomic<bool> isRunning_;
     std::condition_variable condExit_; // 等到线程资源全部回收
+    std::vector<std::unique_ptr<Thread>> exitedThreads_; // 已经退出、等待回收的线程
+    std::vector<bool> slots_;                            // 池内槽位是否被线程占用，由mtx_保护
+
+    // VARIABLE模式的弹性伸缩
+    std::thread controller_;                  // 控制线程
+    std::mutex ctrlMtx_;
+    std::condition_variable ctrlCond_;
+    std::atomic<bool> growHint_;              // 提交任务时发现没有空闲线程，提前唤醒控制线程
+    unsigned int retireCount_;                // 等待退出的空闲线程数量，由mtx_保护
+    long growWaitUs_;                         // 扩容的排队时间阈值
+    long shrinkWaitUs_;                       // 缩容的排队时间阈值
+    std::atomic<unsigned long> waitNsTotal_;  // 任务排队时间之和
+    std::atomic<unsigned long> busyNsTotal_;  // 工作线程执行任务的时间之和
+    std::atomic<unsigned long> doneCount_;    // 执行完的任务数量
+
+    // 工作窃取模式
+    std::vector<std::unique_ptr<Worker>> workers_; // 工作线程私有队列
+    std::vector<int> idleWorkers_;                 // 休眠中的工作线程下标
+    std::mutex idleMtx_;                           // 保护idleWorkers_和Worker::wakeup
+    std::atomic<unsigned int> sleepingCount_;      // 休眠中的工作线程数量
+    size_t affinitySpill_;                         // 收件队列的溢出阈值，0表示不允许溢出
+
+    std::vector<int> cpus_; // 工作线程绑定的CPU，为空时不绑定
+    int threadNice_;        // 工作线程的nice值
 };
 
 #endif
@@ -0,0 +1,537 @@
+#include "../metrics/clock.hpp"
+#include "../metrics/histogram.hpp"
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef IP_BIND_ADDRESS_NO_PORT
+#define IP_BIND_ADDRESS_NO_PORT 24
+#endif
+
+/*
+ * 连接规模测试（C100K）：./bin/connscale [选项] http://host:port
+ *   -c 目标连接数（默认10000）        -b 每一步新建的连接数（默认1000）
+ *   -p 每一步的探测请求数（默认100）  -m 请求路径（默认/index.html）
+ *   -i 新连接只建立、不发送请求        -S 源地址个数（默认每25000个连接一个）
+ *   -T 每一步的超时（毫秒，默认10000） -o 结果（JSON）另外写入文件
+ * 分批建立长连接并保持空闲：每个新连接发送一个请求，收到响应之后不再发送（-i时不发送）。
+ * 每一步记录：这一批从开始连接到服务器全部接受（/metrics中的活跃连接数）的耗时和接受速率；
+ * 在随机选取的空闲连接上依次发送探测请求的往返延迟（epoll中有大量空闲连接时服务器的响应延迟）；
+ * 服务器的常驻内存、malloc的堆和连接内存的统计，换算成每个连接的字节数；本机TCP套接字占用的内核内存。
+ * 连接数超过一个源地址可用的临时端口（约28000）时，目标是回环地址的连接轮流绑定127.0.0.1、127.0.0.2……
+ */
+
+namespace {
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "80";
+    int connections = 10000;
+    int batch = 1000;
+    int probes = 100;
+    std::string path = "/index.html";
+    bool idleOnly = false;
+    int sources = 0;
+    int timeoutMs = 10000;
+    std::string output;
+};
+
+enum ConnState { CONNECTING, WAITING, IDLE, DEAD };
+
+struct Conn {
+    int fd = -1;
+    ConnState state = CONNECTING;
+    std::string in;
+};
+
+// 从/metrics读取的服务器状态
+struct ServerStats {
+    bool ok = false;
+    double active = 0;
+    double rss = 0;
+    double heap = 0;
+    double connMemory = 0;
+    double connObjects = 0;
+};
+
+struct Step {
+    int open = 0;            // 这一步之后客户端保持的连接
+    int failed = 0;          // 累计失败（连接失败、服务器关闭）的连接
+    double connectMs = 0;    // 这一批的连接全部建立（或者收到第一个响应）的耗时
+    double acceptMs = 0;     // 服务器全部接受的耗时，超时为-1
+    double acceptRate = 0;   // 连接/秒
+    uint64_t probeP50 = 0, probeP99 = 0, probeMax = 0; // 纳秒
+    int probeErrors = 0;
+    ServerStats server;
+    double rssPerConn = 0;   // 相对于开始时的增量
+    double heapPerConn = 0;
+    double acctPerConn = 0;  // 服务器统计的每个连接对象的内存
+    long tcpMemKb = 0;       // 本机TCP套接字的内核内存（两端都在本机时包含客户端）
+};
+
+bool ParseUrl(const std::string& url, Options& opt) {
+    std::string rest = url;
+    if(rest.compare(0, 7, "http://") == 0) { rest = rest.substr(7); }
+    rest = rest.substr(0, rest.find('/'));
+    size_t colon = rest.rfind(':');
+    if(colon == std::string::npos) {
+        opt.host = rest;
+    } else {
+        opt.host = rest.substr(0, colon);
+        opt.port = rest.substr(colon + 1);
+    }
+    return !opt.host.empty() && !opt.port.empty();
+}
+
+double MsSince(uint64_t startNs) {
+    return (CheapClock::NowNs() - startNs) / 1e6;
+}
+
+// 完整的响应的长度，还不完整时返回0，格式错误返回-1
+long ResponseLength(const std::string& in) {
+    size_t headerEnd = in.find("\r\n\r\n");
+    if(headerEnd == std::string::npos) { return 0; }
+    if(in.compare(0, 7, "HTTP/1.") != 0) { return -1; }
+    size_t bodyLen = 0;
+    for(size_t line = in.find("\r\n") + 2; line < headerEnd;) {
+        size_t next = in.find("\r\n", line);
+        if(next - line > 15 && strncasecmp(in.data() + line, "Content-length:", 15) == 0) {
+            bodyLen = strtoul(in.data() + line + 15, nullptr, 10);
+        }
+        line = next + 2;
+    }
+    size_t total = headerEnd + 4 + bodyLen;
+    return in.size() >= total ? static_cast<long>(total) : 0;
+}
+
+// 一个样本的值：不带标签的指标 名字 值
+double MetricValue(const std::string& text, const char* name) {
+    std::string key = std::string("\n") + name + " ";
+    size_t pos = text.find(key);
+    return pos == std::string::npos ? 0 : atof(text.c_str() + pos + key.size());
+}
+
+// /proc/net/sockstat中 TCP: ... mem 页数
+long TcpMemKb() {
+    FILE* in = fopen("/proc/net/sockstat", "r");
+    if(!in) { return 0; }
+    char line[256];
+    long pages = 0;
+    while(fgets(line, sizeof(line), in)) {
+        const char* mem = strstr(line, " mem ");
+        if(strncmp(line, "TCP:", 4) == 0 && mem) { pages = atol(mem + 5); }
+    }
+    fclose(in);
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+class Scaler {
+public:
+    Scaler(const Options& opt, const sockaddr_storage& addr, socklen_t addrLen)
+        : opt_(opt), addr_(addr), addrLen_(addrLen) {
+        request_ = "GET " + opt.path + " HTTP/1.1\r\nHost: " + opt.host + ":" + opt.port +
+                   "\r\nConnection: keep-alive\r\nUser-Agent: connscale\r\n\r\n";
+        rng_ = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this)) | 1;
+        epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    }
+    ~Scaler() {
+        for(auto& conn : conns_) {
+            if(conn.fd >= 0) { close(conn.fd); }
+        }
+        close(epollFd_);
+    }
+
+    ServerStats Scrape();
+    Step RunStep(int count, const ServerStats& base);
+    const std::vector<Step>& Steps() const { return steps_; }
+
+private:
+    void Open_(Conn& conn, int index);
+    void Kill_(Conn& conn);
+    void OnEvent_(Conn& conn, uint32_t events);
+    bool Send_(Conn& conn);
+    void Poll_(int timeoutMs);
+    void Probe_(Step& step);
+
+    const Options& opt_;
+    sockaddr_storage addr_;
+    socklen_t addrLen_;
+    std::string request_;
+    std::vector<Conn> conns_;
+    std::vector<Step> steps_;
+    int pending_ = 0; // 这一批中还在连接或等待响应的连接
+    int failed_ = 0;
+    uint64_t rng_;
+    int epollFd_;
+};
+
+// 每次抓取使用一个新的短连接，服务器的活跃连接数中包含它
+ServerStats Scaler::Scrape() {
+    ServerStats stats;
+    int fd = socket(addr_.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) { return stats; }
+    struct timeval tv = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    std::string text;
+    std::string req = "GET /metrics HTTP/1.1\r\nHost: " + opt_.host + ":" + opt_.port + "\r\nConnection: close\r\n\r\n";
+    if(connect(fd, reinterpret_cast<const sockaddr*>(&addr_), addrLen_) == 0 &&
+       send(fd, req.data(), req.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(req.size())) {
+        char buf[16384];
+        while(true) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if(n <= 0) { break; }
+            text.append(buf, n);
+            long len = ResponseLength(text);
+            if(len != 0) { break; }
+        }
+    }
+    close(fd);
+    if(ResponseLength(text) <= 0) { return stats; }
+    stats.ok = true;
+    stats.active = MetricValue(text, "http_connections_active");
+    stats.rss = MetricValue(text, "process_resident_memory_bytes");
+    stats.heap = MetricValue(text, "process_heap_bytes");
+    stats.connMemory = MetricValue(text, "http_conn_memory_bytes");
+    stats.connObjects = MetricValue(text, "http_conn_objects");
+    return stats;
+}
+
+void Scaler::Open_(Conn& conn, int index) {
+    conn.state = DEAD;
+    conn.fd = socket(addr_.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(conn.fd < 0) {
+        failed_++;
+        return;
+    }
+    if(opt_.sources > 1) { // 源地址轮流使用127.0.0.1..N，端口在connect时按四元组分配
+        int one = 1;
+        setsockopt(conn.fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(0x7f000001 + index % opt_.sources);
+        bind(conn.fd, reinterpret_cast<sockaddr*>(&local), sizeof(local));
+    }
+    if(connect(conn.fd, reinterpret_cast<const sockaddr*>(&addr_), addrLen_) < 0 && errno != EINPROGRESS) {
+        close(conn.fd);
+        conn.fd = -1;
+        failed_++;
+        return;
+    }
+    conn.state = CONNECTING;
+    struct epoll_event ev = {};
+    ev.events = EPOLLOUT;
+    ev.data.u64 = index;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, conn.fd, &ev);
+    pending_++;
+}
+
+void Scaler::Kill_(Conn& conn) {
+    if(conn.state == CONNECTING || conn.state == WAITING) { pending_--; }
+    if(conn.fd >= 0) {
+        close(conn.fd);
+        conn.fd = -1;
+    }
+    conn.state = DEAD;
+    std::string().swap(conn.in);
+    failed_++;
+}
+
+bool Scaler::Send_(Conn& conn) {
+    ssize_t n = send(conn.fd, request_.data(), request_.size(), MSG_NOSIGNAL); // 请求很小，一次写完
+    if(n != static_cast<ssize_t>(request_.size())) { return false; }
+    conn.state = WAITING;
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.u64 = &conn - conns_.data();
+    epoll_ctl(epollFd_, EPOLL_CTL_MOD, conn.fd, &ev);
+    return true;
+}
+
+void Scaler::OnEvent_(Conn& conn, uint32_t events) {
+    if(conn.state == CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if(err != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+            Kill_(conn);
+            return;
+        }
+        if(opt_.idleOnly) {
+            conn.state = IDLE;
+            pending_--;
+            struct epoll_event ev = {};
+            ev.events = EPOLLRDHUP; // 空闲时只关心服务器关闭连接
+            ev.data.u64 = &conn - conns_.data();
+            epoll_ctl(epollFd_, EPOLL_CTL_MOD, conn.fd, &ev);
+        } else if(!Send_(conn)) {
+            Kill_(conn);
+        }
+        return;
+    }
+    if(conn.state == IDLE) { // 服务器关闭了空闲连接
+        Kill_(conn);
+        return;
+    }
+    char buf[16384];
+    while(true) {
+        ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+        if(n > 0) {
+            conn.in.append(buf, n);
+            continue;
+        }
+        if(n < 0 && errno == EAGAIN) { break; }
+        Kill_(conn); // 响应之前关闭（如服务器连接数已满）
+        return;
+    }
+    long len = ResponseLength(conn.in);
+    if(len < 0) {
+        Kill_(conn);
+    } else if(len > 0) {
+        std::string().swap(conn.in);
+        conn.state = IDLE;
+        pending_--;
+        struct epoll_event ev = {};
+        ev.events = EPOLLRDHUP;
+        ev.data.u64 = &conn - conns_.data();
+        epoll_ctl(epollFd_, EPOLL_CTL_MOD, conn.fd, &ev);
+    }
+}
+
+void Scaler::Poll_(int timeoutMs) {
+    struct epoll_event events[1024];
+    int n = epoll_wait(epollFd_, events, 1024, timeoutMs);
+    for(int i = 0; i < n; i++) {
+        Conn& conn = conns_[events[i].data.u64];
+        if(conn.state != DEAD) { OnEvent_(conn, events[i].events); }
+    }
+}
+
+// 在随机选取的空闲连接上依次发送一个请求，测量往返延迟
+void Scaler::Probe_(Step& step) {
+    std::unique_ptr<HistogramSnapshot> hist(new HistogramSnapshot());
+    memset(hist.get(), 0, sizeof(*hist));
+    for(int i = 0; i < opt_.probes && !conns_.empty(); i++) {
+        Conn* conn = nullptr;
+        for(int tries = 0; tries < 16 && !conn; tries++) {
+            rng_ ^= rng_ << 13; // xorshift64
+            rng_ ^= rng_ >> 7;
+            rng_ ^= rng_ << 17;
+            Conn& c = conns_[rng_ % conns_.size()];
+            if(c.state == IDLE) { conn = &c; }
+        }
+        if(!conn) { break; }
+        uint64_t start = CheapClock::NowNs();
+        if(!Send_(*conn)) {
+            Kill_(*conn);
+            step.probeErrors++;
+            continue;
+        }
+        pending_++;
+        while(conn->state == WAITING && MsSince(start) < opt_.timeoutMs) {
+            Poll_(10);
+        }
+        if(conn->state != IDLE) {
+            if(conn->state == WAITING) { Kill_(*conn); }
+            step.probeErrors++;
+            continue;
+        }
+        uint64_t ns = CheapClock::NowNs() - start;
+        hist->counts[hdr::BucketIndex(ns)]++;
+        hist->count++;
+        hist->sumNs += ns;
+        hist->maxNs = std::max(hist->maxNs, ns);
+    }
+    step.probeP50 = hist->Percentile(0.5);
+    step.probeP99 = hist->Percentile(0.99);
+    step.probeMax = hist->maxNs;
+}
+
+Step Scaler::RunStep(int count, const ServerStats& base) {
+    Step step;
+    size_t first = conns_.size();
+    conns_.resize(first + count); // 事件中保存的是下标，扩容不影响
+    uint64_t start = CheapClock::NowNs();
+    for(int i = 0; i < count; i++) {
+        Open_(conns_[first + i], static_cast<int>(first + i));
+    }
+    while(pending_ > 0 && MsSince(start) < opt_.timeoutMs) {
+        Poll_(10);
+    }
+    step.connectMs = MsSince(start);
+    for(size_t i = first; i < conns_.size(); i++) { // 超时的连接
+        if(conns_[i].state == CONNECTING || conns_[i].state == WAITING) { Kill_(conns_[i]); }
+    }
+    int open = 0;
+    for(auto& conn : conns_) {
+        if(conn.state == IDLE) { open++; }
+    }
+    // 等服务器把这一批连接全部接受：活跃连接数 = 开始时的值 + 客户端保持的连接 + 抓取用的连接
+    step.acceptMs = -1;
+    uint64_t waitStart = CheapClock::NowNs();
+    while(MsSince(waitStart) < opt_.timeoutMs) {
+        ServerStats stats = Scrape();
+        if(stats.ok && stats.active >= base.active + open + 1) {
+            step.acceptMs = MsSince(start);
+            break;
+        }
+        Poll_(2);
+    }
+    if(step.acceptMs > 0) { step.acceptRate = count / (step.acceptMs / 1e3); }
+
+    Probe_(step);
+    step.server = Scrape();
+    step.open = 0;
+    for(auto& conn : conns_) {
+        if(conn.state == IDLE) { step.open++; }
+    }
+    step.failed = failed_;
+    double added = step.server.active - base.active - 1;
+    if(step.server.ok && added > 0) {
+        step.rssPerConn = (step.server.rss - base.rss) / added;
+        step.heapPerConn = (step.server.heap - base.heap) / added;
+    }
+    if(step.server.connObjects > 0) { step.acctPerConn = step.server.connMemory / step.server.connObjects; }
+    step.tcpMemKb = TcpMemKb();
+    steps_.push_back(step);
+    return step;
+}
+
+void PrintHeader() {
+    fprintf(stderr, "%8s %7s %10s %10s %10s %9s %9s %9s %8s %9s %9s %9s %9s\n", "conns", "failed", "connect_ms",
+            "accept_ms", "accept/s", "probe_p50", "probe_p99", "probe_max", "rss_MB", "rss_B/c", "heap_B/c",
+            "acct_B/c", "tcp_KB");
+}
+
+void PrintStep(const Step& s) {
+    fprintf(stderr, "%8d %7d %10.1f %10.1f %10.0f %8.0fus %8.0fus %8.0fus", s.open, s.failed, s.connectMs, s.acceptMs,
+            s.acceptRate, s.probeP50 / 1e3, s.probeP99 / 1e3, s.probeMax / 1e3);
+    if(s.server.ok) {
+        fprintf(stderr, " %8.1f %9.0f %9.0f %9.0f", s.server.rss / 1048576, s.rssPerConn, s.heapPerConn, s.acctPerConn);
+    } else { // 服务器的连接数已满时抓取也会被拒绝
+        fprintf(stderr, " %8s %9s %9s %9s", "-", "-", "-", "-");
+    }
+    fprintf(stderr, " %9ld\n", s.tcpMemKb);
+}
+
+std::string StepJson(const Step& s) {
+    char buf[1024];
+    snprintf(buf, sizeof(buf),
+             "{\"connections\":%d,\"failed\":%d,\"connect_ms\":%.1f,\"accept_ms\":%.1f,\"accept_per_s\":%.0f,"
+             "\"probe_us\":{\"p50\":%.1f,\"p99\":%.1f,\"max\":%.1f,\"errors\":%d},"
+             "\"server\":{\"active\":%.0f,\"rss_bytes\":%.0f,\"heap_bytes\":%.0f,\"conn_memory_bytes\":%.0f,"
+             "\"conn_objects\":%.0f},\"bytes_per_conn\":{\"rss\":%.0f,\"heap\":%.0f,\"accounted\":%.0f},"
+             "\"tcp_mem_kb\":%ld}",
+             s.open, s.failed, s.connectMs, s.acceptMs, s.acceptRate, s.probeP50 / 1e3, s.probeP99 / 1e3,
+             s.probeMax / 1e3, s.probeErrors, s.server.active, s.server.rss, s.server.heap, s.server.connMemory,
+             s.server.connObjects, s.rssPerConn, s.heapPerConn, s.acctPerConn, s.tcpMemKb);
+    return buf;
+}
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    int ch;
+    while((ch = getopt(argc, argv, "c:b:p:m:iS:T:o:")) != -1) {
+        switch(ch) {
+        case 'c': opt.connections = atoi(optarg); break;
+        case 'b': opt.batch = atoi(optarg); break;
+        case 'p': opt.probes = atoi(optarg); break;
+        case 'm': opt.path = optarg; break;
+        case 'i': opt.idleOnly = true; break;
+        case 'S': opt.sources = atoi(optarg); break;
+        case 'T': opt.timeoutMs = atoi(optarg); break;
+        case 'o': opt.output = optarg; break;
+        default: optind = argc + 1; break;
+        }
+    }
+    if(optind != argc - 1 || !ParseUrl(argv[optind], opt) || opt.connections <= 0 || opt.batch <= 0) {
+        fprintf(stderr, "usage: %s [-c connections] [-b batch] [-p probes] [-m /path] [-i] [-S sources] "
+                        "[-T timeout_ms] [-o result.json] http://host:port\n", argv[0]);
+        return 1;
+    }
+
+    struct addrinfo hints = {}, *res = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    int err = getaddrinfo(opt.host.c_str(), opt.port.c_str(), &hints, &res);
+    if(err != 0) {
+        fprintf(stderr, "%s:%s: %s\n", opt.host.c_str(), opt.port.c_str(), gai_strerror(err));
+        return 1;
+    }
+    sockaddr_storage addr = {};
+    memcpy(&addr, res->ai_addr, res->ai_addrlen);
+    socklen_t addrLen = res->ai_addrlen;
+    freeaddrinfo(res);
+    bool loopback = (ntohl(reinterpret_cast<sockaddr_in*>(&addr)->sin_addr.s_addr) >> 24) == 127;
+    if(opt.sources <= 0) {
+        opt.sources = loopback ? (opt.connections + 24999) / 25000 : 1;
+    }
+
+    // 每个连接一个文件描述符
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    rlim_t want = static_cast<rlim_t>(opt.connections) + 64;
+    if(limit.rlim_cur < want) {
+        limit.rlim_cur = limit.rlim_max == RLIM_INFINITY ? want : std::min(want, limit.rlim_max);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if(limit.rlim_cur < want) {
+        fprintf(stderr, "need %llu file descriptors but the hard limit is %llu (ulimit -Hn)\n",
+                static_cast<unsigned long long>(want), static_cast<unsigned long long>(limit.rlim_max));
+        return 1;
+    }
+
+    Scaler scaler(opt, addr, addrLen);
+    ServerStats base = scaler.Scrape();
+    if(!base.ok) {
+        fprintf(stderr, "cannot read http://%s:%s/metrics\n", opt.host.c_str(), opt.port.c_str());
+        return 1;
+    }
+    base.active -= 1; // 不算抓取用的连接
+    PrintHeader();
+    for(int opened = 0; opened < opt.connections; opened += opt.batch) {
+        Step step = scaler.RunStep(std::min(opt.batch, opt.connections - opened), base);
+        PrintStep(step);
+        if(step.open < opened / 2) { // 大部分连接都失败了，不再继续
+            fprintf(stderr, "too many failed connections, stopping\n");
+            break;
+        }
+    }
+
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "{\"config\":{\"host\":\"%s\",\"port\":\"%s\",\"connections\":%d,\"batch\":%d,\"probes\":%d,"
+             "\"path\":\"%s\",\"idle_only\":%s,\"sources\":%d},\"baseline\":{\"active\":%.0f,\"rss_bytes\":%.0f,"
+             "\"heap_bytes\":%.0f},\"steps\":[",
+             opt.host.c_str(), opt.port.c_str(), opt.connections, opt.batch, opt.probes, opt.path.c_str(),
+             opt.idleOnly ? "true" : "false", opt.sources, base.active, base.rss, base.heap);
+    std::string json = buf;
+    const std::vector<Step>& steps = scaler.Steps();
+    for(size_t i = 0; i < steps.size(); i++) {
+        if(i) { json += ","; }
+        json += StepJson(steps[i]);
+    }
+    json += "]}\n";
+    fputs(json.c_str(), stdout);
+    if(!opt.output.empty()) {
+        FILE* out = fopen(opt.output.c_str(), "w");
+        if(!out) {
+            perror(opt.output.c_str());
+            return 1;
+        }
+        fputs(json.c_str(), out);
+        fclose(out);
+    }
+    return 0;
+}
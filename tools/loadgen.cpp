@@ -0,0 +1,621 @@
+#include "../metrics/clock.hpp"
+#include "../metrics/histogram.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * HTTP压测工具（替代webbench）：./bin/loadgen [选项] http://host:port
+ *   -t 线程数        -c 连接总数       -d 测量时长（秒）   -w 预热时长（秒，不计入结果）
+ *   -p 流水线深度    -r 总请求速率/秒（开环模式，0为闭环）  -T 请求超时（毫秒）
+ *   -m 请求组合：逗号分隔的 权重:方法:路径[:请求体][|头部: 值]...，如
+ *      8:GET:/index.html,1:GET:/picture/img.jpg,1:GET:/video/mp4.mp4|Range: bytes=0-1048575,1:POST:/CGI:a=3&b=4
+ *   -o 结果（JSON）另外写入文件
+ * 每个线程一个epoll，负责自己的连接，连接保持keep-alive，每个连接最多同时有“流水线深度”个请求在途。
+ * 闭环模式下收到响应立即发送下一个请求；开环模式按固定间隔安排请求，来不及发送的请求排队，
+ * 延迟从计划发送的时间算起（不受coordinated omission影响）。延迟直方图与服务器的/metrics使用同样的对数-线性分桶
+ */
+
+namespace {
+struct RequestType {
+    std::string name; // 方法 路径
+    std::string raw;  // 完整的请求报文
+    int weight;
+};
+
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "80";
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    int connections = 100;
+    int durationSec = 10;
+    int warmupSec = 0;
+    int pipeline = 1;
+    double rate = 0;
+    int timeoutMs = 5000;
+    std::string mix = "1:GET:/index.html";
+    std::string output;
+};
+
+// 一个线程的统计，结束后合并
+struct Stats {
+    std::vector<HistogramSnapshot> latency; // 每种请求一个
+    uint64_t responses = 0;
+    uint64_t bytes = 0;
+    uint64_t status[6] = {};    // 1xx..5xx，其他
+    uint64_t connectErrors = 0;
+    uint64_t readErrors = 0;    // 连接在响应之前断开，在途的请求都计为错误
+    uint64_t timeouts = 0;
+    uint64_t parseErrors = 0;
+    uint64_t backlogMax = 0;    // 开环模式下排队的最大请求数
+};
+
+struct InFlight {
+    int type;
+    uint64_t startNs; // 开环模式下是计划发送的时间
+};
+
+struct Conn {
+    int fd = -1;
+    bool connecting = false;
+    bool wantWrite = false;
+    uint64_t retryNs = 0; // 连接失败之后下次重连的时间
+    std::string out;
+    size_t outPos = 0;
+    std::string in;
+    std::deque<InFlight> inflight;
+};
+
+bool ParseMix(const std::string& spec, const Options& opt, std::vector<RequestType>& types) {
+    size_t pos = 0;
+    while(pos <= spec.size()) {
+        size_t end = spec.find(',', pos);
+        if(end == std::string::npos) { end = spec.size(); }
+        std::string item = spec.substr(pos, end - pos);
+        pos = end + 1;
+        if(item.empty()) { continue; }
+        std::string headers; // |之后是额外的请求头
+        size_t bar = item.find('|');
+        if(bar != std::string::npos) {
+            std::string rest = item.substr(bar + 1);
+            item.resize(bar);
+            size_t start = 0;
+            while(start <= rest.size()) {
+                size_t next = rest.find('|', start);
+                if(next == std::string::npos) { next = rest.size(); }
+                if(next > start) { headers += rest.substr(start, next - start) + "\r\n"; }
+                start = next + 1;
+            }
+        }
+        size_t c1 = item.find(':');
+        size_t c2 = c1 == std::string::npos ? c1 : item.find(':', c1 + 1);
+        if(c2 == std::string::npos) {
+            fprintf(stderr, "bad request mix item: %s\n", item.c_str());
+            return false;
+        }
+        size_t c3 = item.find(':', c2 + 1);
+        RequestType type;
+        type.weight = atoi(item.substr(0, c1).c_str());
+        std::string method = item.substr(c1 + 1, c2 - c1 - 1);
+        std::string path = item.substr(c2 + 1, c3 == std::string::npos ? std::string::npos : c3 - c2 - 1);
+        std::string body = c3 == std::string::npos ? "" : item.substr(c3 + 1);
+        if(type.weight <= 0 || method.empty() || path.empty() || path[0] != '/') {
+            fprintf(stderr, "bad request mix item: %s\n", item.c_str());
+            return false;
+        }
+        type.name = method + " " + path;
+        type.raw = method + " " + path + " HTTP/1.1\r\nHost: " + opt.host + ":" + opt.port +
+                   "\r\nConnection: keep-alive\r\nUser-Agent: loadgen\r\n" + headers;
+        if(!body.empty() || method == "POST") {
+            type.raw += "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+                        std::to_string(body.size()) + "\r\n";
+        }
+        type.raw += "\r\n" + body;
+        types.push_back(type);
+        if(pos > spec.size()) { break; }
+    }
+    return !types.empty();
+}
+
+bool ParseUrl(const std::string& url, Options& opt) {
+    std::string rest = url;
+    if(rest.compare(0, 7, "http://") == 0) { rest = rest.substr(7); }
+    rest = rest.substr(0, rest.find('/'));
+    size_t colon = rest.rfind(':');
+    if(colon == std::string::npos) {
+        opt.host = rest;
+    } else {
+        opt.host = rest.substr(0, colon);
+        opt.port = rest.substr(colon + 1);
+    }
+    return !opt.host.empty() && !opt.port.empty();
+}
+
+bool ieq(const char* a, const char* b, size_t n) {
+    return strncasecmp(a, b, n) == 0;
+}
+
+class Worker {
+public:
+    Worker(const Options& opt, const std::vector<RequestType>& types, const sockaddr_storage& addr, socklen_t addrLen,
+           int connections, uint64_t startNs)
+        : opt_(opt), types_(types), addr_(addr), addrLen_(addrLen), conns_(connections), startNs_(startNs) {
+        stats_.latency.resize(types.size());
+        for(auto& h : stats_.latency) { memset(&h, 0, sizeof(h)); }
+        for(auto& t : types) { totalWeight_ += t.weight; }
+        measureNs_ = startNs_ + static_cast<uint64_t>(opt.warmupSec) * 1000000000ULL;
+        endNs_ = measureNs_ + static_cast<uint64_t>(opt.durationSec) * 1000000000ULL;
+        if(opt.rate > 0) {
+            intervalNs_ = 1e9 * opt.threads / opt.rate;
+        }
+        rng_ = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this)) | 1;
+    }
+
+    void Run();
+    const Stats& GetStats() const { return stats_; }
+
+private:
+    int PickType_();
+    void Connect_(Conn& conn, uint64_t now);
+    void Close_(Conn& conn, uint64_t now, bool failed);
+    void Send_(Conn& conn, uint64_t startNs);
+    void Flush_(Conn& conn, uint64_t now);
+    void Read_(Conn& conn, uint64_t now);
+    bool ParseResponse_(Conn& conn, uint64_t now); // 取出一个完整的响应
+    void UpdateEvents_(Conn& conn);
+    void Fill_(uint64_t now);
+    void CheckTimeouts_(uint64_t now);
+
+    const Options& opt_;
+    const std::vector<RequestType>& types_;
+    sockaddr_storage addr_;
+    socklen_t addrLen_;
+    std::vector<Conn> conns_;
+    uint64_t startNs_;
+    uint64_t measureNs_; // 计划在这个时间之后发送的请求才计入结果
+    uint64_t endNs_;
+    double intervalNs_ = 0;
+    double nextSendNs_ = 0;
+    std::deque<uint64_t> backlog_; // 开环模式：到了计划时间、还没有连接可以发送的请求
+    size_t nextConn_ = 0;
+    int totalWeight_ = 0;
+    uint64_t rng_;
+    int epollFd_ = -1;
+    Stats stats_;
+};
+
+int Worker::PickType_() {
+    if(types_.size() == 1) { return 0; }
+    rng_ ^= rng_ << 13; // xorshift64
+    rng_ ^= rng_ >> 7;
+    rng_ ^= rng_ << 17;
+    int r = static_cast<int>(rng_ % totalWeight_);
+    for(size_t i = 0; i < types_.size(); i++) {
+        r -= types_[i].weight;
+        if(r < 0) { return static_cast<int>(i); }
+    }
+    return 0;
+}
+
+void Worker::Connect_(Conn& conn, uint64_t now) {
+    conn.fd = socket(addr_.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(conn.fd < 0) {
+        stats_.connectErrors++;
+        conn.retryNs = now + 100000000ULL;
+        return;
+    }
+    int one = 1;
+    setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int ret = connect(conn.fd, reinterpret_cast<const sockaddr*>(&addr_), addrLen_);
+    if(ret < 0 && errno != EINPROGRESS) {
+        stats_.connectErrors++;
+        close(conn.fd);
+        conn.fd = -1;
+        conn.retryNs = now + 10000000ULL;
+        return;
+    }
+    conn.connecting = ret < 0;
+    conn.wantWrite = conn.connecting;
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | (conn.wantWrite ? EPOLLOUT : 0);
+    ev.data.ptr = &conn;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, conn.fd, &ev);
+}
+
+// 连接断开：在途的请求计为错误（开环模式下重新排队会掩盖服务器的问题）
+void Worker::Close_(Conn& conn, uint64_t now, bool failed) {
+    if(failed) {
+        for(auto& req : conn.inflight) {
+            if(req.startNs >= measureNs_) { stats_.readErrors++; }
+        }
+    }
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+    close(conn.fd);
+    conn.fd = -1;
+    conn.connecting = conn.wantWrite = false;
+    conn.out.clear();
+    conn.outPos = 0;
+    conn.in.clear();
+    conn.inflight.clear();
+    conn.retryNs = failed ? now + 10000000ULL : now;
+}
+
+void Worker::Send_(Conn& conn, uint64_t startNs) {
+    int type = PickType_();
+    conn.out += types_[type].raw;
+    conn.inflight.push_back({type, startNs});
+}
+
+void Worker::UpdateEvents_(Conn& conn) {
+    bool want = conn.connecting || conn.outPos < conn.out.size();
+    if(want == conn.wantWrite) { return; }
+    conn.wantWrite = want;
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+    ev.data.ptr = &conn;
+    epoll_ctl(epollFd_, EPOLL_CTL_MOD, conn.fd, &ev);
+}
+
+void Worker::Flush_(Conn& conn, uint64_t now) {
+    while(conn.outPos < conn.out.size()) {
+        ssize_t n = ::write(conn.fd, conn.out.data() + conn.outPos, conn.out.size() - conn.outPos);
+        if(n < 0) {
+            if(errno == EAGAIN || errno == EINTR) { break; }
+            Close_(conn, now, true);
+            return;
+        }
+        conn.outPos += n;
+    }
+    if(conn.outPos == conn.out.size()) {
+        conn.out.clear();
+        conn.outPos = 0;
+    }
+    UpdateEvents_(conn);
+}
+
+bool Worker::ParseResponse_(Conn& conn, uint64_t now) {
+    size_t headerEnd = conn.in.find("\r\n\r\n");
+    if(headerEnd == std::string::npos) { return false; }
+    const char* p = conn.in.data();
+    int status = 0;
+    if(conn.in.size() < 12 || !ieq(p, "HTTP/1.", 7) || sscanf(p + 9, "%d", &status) != 1) {
+        stats_.parseErrors++;
+        Close_(conn, now, true);
+        return false;
+    }
+    size_t bodyLen = 0;
+    bool close = false;
+    for(size_t line = conn.in.find("\r\n") + 2; line < headerEnd;) {
+        size_t next = conn.in.find("\r\n", line);
+        if(next - line > 15 && ieq(p + line, "Content-length:", 15)) {
+            bodyLen = strtoul(p + line + 15, nullptr, 10);
+        } else if(next - line >= 17 && ieq(p + line, "Connection: close", 17)) {
+            close = true;
+        }
+        line = next + 2;
+    }
+    size_t total = headerEnd + 4 + bodyLen;
+    if(conn.in.size() < total) { return false; }
+    conn.in.erase(0, total);
+    if(conn.inflight.empty()) { // 没有请求却收到了响应
+        stats_.parseErrors++;
+        Close_(conn, now, true);
+        return false;
+    }
+    InFlight req = conn.inflight.front();
+    conn.inflight.pop_front();
+    if(req.startNs >= measureNs_ && req.startNs < endNs_) {
+        HistogramSnapshot& h = stats_.latency[req.type];
+        uint64_t ns = now > req.startNs ? now - req.startNs : 0;
+        h.counts[hdr::BucketIndex(ns)]++;
+        h.count++;
+        h.sumNs += ns;
+        if(ns > h.maxNs) { h.maxNs = ns; }
+        stats_.responses++;
+        stats_.bytes += total;
+        stats_.status[status >= 100 && status < 600 ? status / 100 - 1 : 5]++;
+    }
+    if(close) {
+        Close_(conn, now, !conn.inflight.empty());
+        return false;
+    }
+    return true;
+}
+
+void Worker::Read_(Conn& conn, uint64_t now) {
+    char buf[65536];
+    while(true) {
+        ssize_t n = ::read(conn.fd, buf, sizeof(buf));
+        if(n > 0) {
+            conn.in.append(buf, n);
+            continue;
+        }
+        if(n < 0 && (errno == EAGAIN || errno == EINTR)) { break; }
+        // 对端关闭或出错：先处理已经完整收到的响应
+        while(ParseResponse_(conn, now)) {}
+        if(conn.fd >= 0) { Close_(conn, now, !conn.inflight.empty()); }
+        return;
+    }
+    while(ParseResponse_(conn, now)) {}
+}
+
+// 给有空位的连接补充请求：闭环模式下补满流水线，开环模式下从排队的请求中取
+void Worker::Fill_(uint64_t now) {
+    if(intervalNs_ > 0) {
+        while(nextSendNs_ <= static_cast<double>(now) && nextSendNs_ < static_cast<double>(endNs_)) {
+            backlog_.push_back(static_cast<uint64_t>(nextSendNs_));
+            nextSendNs_ += intervalNs_;
+        }
+        stats_.backlogMax = std::max<uint64_t>(stats_.backlogMax, backlog_.size());
+    }
+    for(size_t i = 0; i < conns_.size(); i++) {
+        if(intervalNs_ > 0 && backlog_.empty()) { break; }
+        Conn& conn = conns_[(nextConn_ + i) % conns_.size()];
+        if(conn.fd < 0) {
+            if(now >= conn.retryNs) { Connect_(conn, now); }
+            if(conn.fd < 0) { continue; }
+        }
+        if(conn.connecting) { continue; }
+        bool sent = false;
+        while(conn.inflight.size() < static_cast<size_t>(opt_.pipeline)) {
+            if(intervalNs_ > 0) {
+                if(backlog_.empty()) { break; }
+                Send_(conn, backlog_.front());
+                backlog_.pop_front();
+            } else {
+                Send_(conn, now);
+            }
+            sent = true;
+        }
+        if(sent) { Flush_(conn, now); }
+    }
+    nextConn_ = (nextConn_ + 1) % conns_.size(); // 轮流从不同的连接开始，开环模式下请求均匀分布
+}
+
+void Worker::CheckTimeouts_(uint64_t now) {
+    uint64_t timeoutNs = static_cast<uint64_t>(opt_.timeoutMs) * 1000000ULL;
+    for(auto& conn : conns_) {
+        if(conn.fd >= 0 && !conn.inflight.empty() && now - std::min(now, conn.inflight.front().startNs) > timeoutNs) {
+            for(auto& req : conn.inflight) {
+                if(req.startNs >= measureNs_) { stats_.timeouts++; }
+            }
+            conn.inflight.clear();
+            Close_(conn, now, false);
+        }
+    }
+}
+
+void Worker::Run() {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    nextSendNs_ = static_cast<double>(startNs_) + intervalNs_ * (rng_ % 1000) / 1000.0; // 各线程错开
+    std::vector<epoll_event> events(conns_.size() + 1);
+    uint64_t lastCheck = startNs_;
+    uint64_t now = CheapClock::NowNs();
+    while(now < endNs_) {
+        Fill_(now);
+        int timeoutMs = 100;
+        if(intervalNs_ > 0) {
+            double wait = (nextSendNs_ - static_cast<double>(CheapClock::NowNs())) / 1e6;
+            timeoutMs = wait <= 0 ? 0 : std::min(100, static_cast<int>(wait) + 1);
+            if(!backlog_.empty()) { timeoutMs = std::min(timeoutMs, 1); }
+        }
+        int n = epoll_wait(epollFd_, events.data(), static_cast<int>(events.size()), timeoutMs);
+        now = CheapClock::NowNs();
+        for(int i = 0; i < n; i++) {
+            Conn& conn = *static_cast<Conn*>(events[i].data.ptr);
+            if(conn.fd < 0) { continue; }
+            if(conn.connecting && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if(err) {
+                    stats_.connectErrors++;
+                    Close_(conn, now, true);
+                    continue;
+                }
+                conn.connecting = false;
+                UpdateEvents_(conn);
+            }
+            if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                Read_(conn, now);
+            }
+            if(conn.fd >= 0 && (events[i].events & EPOLLOUT)) {
+                Flush_(conn, now);
+            }
+        }
+        if(now - lastCheck > 100000000ULL) {
+            CheckTimeouts_(now);
+            lastCheck = now;
+        }
+    }
+    for(auto& conn : conns_) {
+        if(conn.fd >= 0) {
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+            close(conn.fd);
+        }
+    }
+    close(epollFd_);
+}
+
+void Merge(HistogramSnapshot& to, const HistogramSnapshot& from) {
+    for(int i = 0; i < hdr::BUCKETS; i++) { to.counts[i] += from.counts[i]; }
+    to.count += from.count;
+    to.sumNs += from.sumNs;
+    to.maxNs = std::max(to.maxNs, from.maxNs);
+}
+
+void AppendLatency(std::string& out, const HistogramSnapshot& h) {
+    static const struct { const char* name; double q; } PERCENTILES[] = {
+        {"p50", 0.5}, {"p75", 0.75}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}, {"p9999", 0.9999},
+    };
+    char buf[64];
+    snprintf(buf, sizeof(buf), "{\"mean\":%.1f", h.count ? h.sumNs / 1e3 / h.count : 0.0);
+    out += buf;
+    for(auto& p : PERCENTILES) {
+        snprintf(buf, sizeof(buf), ",\"%s\":%.1f", p.name, h.Percentile(p.q) / 1e3);
+        out += buf;
+    }
+    snprintf(buf, sizeof(buf), ",\"max\":%.1f}", h.maxNs / 1e3);
+    out += buf;
+}
+
+// 转义引号、反斜杠和控制字符，结果可以直接放在JSON字符串的引号之间
+std::string JsonEscape(const std::string& str) {
+    std::string out;
+    for(unsigned char c : str) {
+        if(c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if(c < 0x20) {
+            char hex[8];
+            snprintf(hex, sizeof(hex), "\\u%04x", c);
+            out += hex;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    int ch;
+    while((ch = getopt(argc, argv, "t:c:d:w:p:r:T:m:o:")) != -1) {
+        switch(ch) {
+        case 't': opt.threads = atoi(optarg); break;
+        case 'c': opt.connections = atoi(optarg); break;
+        case 'd': opt.durationSec = atoi(optarg); break;
+        case 'w': opt.warmupSec = atoi(optarg); break;
+        case 'p': opt.pipeline = atoi(optarg); break;
+        case 'r': opt.rate = atof(optarg); break;
+        case 'T': opt.timeoutMs = atoi(optarg); break;
+        case 'm': opt.mix = optarg; break;
+        case 'o': opt.output = optarg; break;
+        default: optind = argc + 1; break;
+        }
+    }
+    if(optind != argc - 1 || !ParseUrl(argv[optind], opt)) {
+        fprintf(stderr, "usage: %s [-t threads] [-c connections] [-d seconds] [-w warmup] [-p pipeline] "
+                        "[-r rate] [-T timeout_ms] [-m weight:METHOD:/path[:body],...] [-o result.json] http://host:port\n", argv[0]);
+        return 1;
+    }
+    opt.threads = std::max(1, std::min(opt.threads, opt.connections));
+    opt.pipeline = std::max(1, opt.pipeline);
+    std::vector<RequestType> types;
+    if(opt.connections <= 0 || opt.durationSec <= 0 || !ParseMix(opt.mix, opt, types)) {
+        return 1;
+    }
+
+    struct addrinfo hints = {}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int err = getaddrinfo(opt.host.c_str(), opt.port.c_str(), &hints, &res);
+    if(err != 0) {
+        fprintf(stderr, "%s:%s: %s\n", opt.host.c_str(), opt.port.c_str(), gai_strerror(err));
+        return 1;
+    }
+    sockaddr_storage addr = {};
+    memcpy(&addr, res->ai_addr, res->ai_addrlen);
+    socklen_t addrLen = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    uint64_t startNs = CheapClock::NowNs();
+    std::vector<std::unique_ptr<Worker>> workers;
+    for(int i = 0; i < opt.threads; i++) {
+        int conns = opt.connections / opt.threads + (i < opt.connections % opt.threads ? 1 : 0);
+        workers.emplace_back(new Worker(opt, types, addr, addrLen, conns, startNs));
+    }
+    std::vector<std::thread> threads;
+    for(auto& worker : workers) {
+        threads.emplace_back(&Worker::Run, worker.get());
+    }
+    for(auto& t : threads) { t.join(); }
+
+    // 合并各线程的结果
+    Stats total;
+    total.latency.resize(types.size());
+    for(auto& h : total.latency) { memset(&h, 0, sizeof(h)); }
+    std::unique_ptr<HistogramSnapshot> all(new HistogramSnapshot());
+    for(auto& worker : workers) {
+        const Stats& s = worker->GetStats();
+        for(size_t i = 0; i < types.size(); i++) {
+            Merge(total.latency[i], s.latency[i]);
+            Merge(*all, s.latency[i]);
+        }
+        total.responses += s.responses;
+        total.bytes += s.bytes;
+        for(int i = 0; i < 6; i++) { total.status[i] += s.status[i]; }
+        total.connectErrors += s.connectErrors;
+        total.readErrors += s.readErrors;
+        total.timeouts += s.timeouts;
+        total.parseErrors += s.parseErrors;
+        total.backlogMax = std::max(total.backlogMax, s.backlogMax);
+    }
+
+    char buf[512];
+    std::string json;
+    //用户给出的字符串（主机、请求组合）长度不定，直接追加，只有定长的数字字段经过snprintf
+    json += "{\"config\":{\"host\":\"" + JsonEscape(opt.host) + "\",\"port\":\"" + JsonEscape(opt.port) + "\",";
+    snprintf(buf, sizeof(buf),
+             "\"threads\":%d,\"connections\":%d,\"duration_s\":%d,\"warmup_s\":%d,\"pipeline\":%d,\"rate\":%.1f,\"mode\":\"%s\",",
+             opt.threads, opt.connections, opt.durationSec, opt.warmupSec, opt.pipeline, opt.rate,
+             opt.rate > 0 ? "open" : "closed");
+    json += buf;
+    json += "\"mix\":\"" + JsonEscape(opt.mix) + "\"},";
+    snprintf(buf, sizeof(buf),
+             "\"requests\":%llu,\"rps\":%.1f,\"bytes\":%llu,\"mb_per_s\":%.2f,"
+             "\"status\":{\"1xx\":%llu,\"2xx\":%llu,\"3xx\":%llu,\"4xx\":%llu,\"5xx\":%llu,\"other\":%llu},"
+             "\"errors\":{\"connect\":%llu,\"read\":%llu,\"timeout\":%llu,\"parse\":%llu},\"backlog_max\":%llu,",
+             static_cast<unsigned long long>(total.responses), total.responses / static_cast<double>(opt.durationSec),
+             static_cast<unsigned long long>(total.bytes), total.bytes / 1048576.0 / opt.durationSec,
+             static_cast<unsigned long long>(total.status[0]), static_cast<unsigned long long>(total.status[1]),
+             static_cast<unsigned long long>(total.status[2]), static_cast<unsigned long long>(total.status[3]),
+             static_cast<unsigned long long>(total.status[4]), static_cast<unsigned long long>(total.status[5]),
+             static_cast<unsigned long long>(total.connectErrors), static_cast<unsigned long long>(total.readErrors),
+             static_cast<unsigned long long>(total.timeouts), static_cast<unsigned long long>(total.parseErrors),
+             static_cast<unsigned long long>(total.backlogMax));
+    json += buf;
+    json += "\"latency_us\":";
+    AppendLatency(json, *all);
+    json += ",\"by_request\":[";
+    for(size_t i = 0; i < types.size(); i++) {
+        json += i ? ",{" : "{";
+        json += "\"name\":\"" + JsonEscape(types[i].name) + "\",\"count\":" + std::to_string(total.latency[i].count) +
+                ",\"latency_us\":";
+        AppendLatency(json, total.latency[i]);
+        json += "}";
+    }
+    json += "]}\n";
+
+    fputs(json.c_str(), stdout);
+    if(!opt.output.empty()) {
+        FILE* out = fopen(opt.output.c_str(), "w");
+        if(!out) {
+            perror(opt.output.c_str());
+            return 1;
+        }
+        fputs(json.c_str(), out);
+        fclose(out);
+    }
+    fprintf(stderr, "%llu requests in %ds, %.1f req/s, p50 %.1fus p99 %.1fus p99.9 %.1fus max %.1fus, errors %llu\n",
+            static_cast<unsigned long long>(total.responses), opt.durationSec, total.responses / static_cast<double>(opt.durationSec),
+            all->Percentile(0.5) / 1e3, all->Percentile(0.99) / 1e3, all->Percentile(0.999) / 1e3, all->maxNs / 1e3,
+            static_cast<unsigned long long>(total.connectErrors + total.readErrors + total.timeouts + total.parseErrors));
+    return 0;
+}
@@ -0,0 +1,613 @@
+#include "../http/capture.hpp"
+#include "../metrics/clock.hpp"
+#include "../metrics/histogram.hpp"
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * 流量重放工具：./bin/replay [选项] 捕获文件 http://host:port
+ *   -x 速度倍数（默认1：按捕获时的时间间隔；10：快10倍；0：不等待，收到响应立即发送下一个请求）
+ *   -t 线程数        -c 同时打开的连接数上限（默认1000）   -T 请求超时（毫秒）
+ *   -n 只重放前多少个连接（0为全部）                      -o 结果（JSON）另外写入文件
+ * 捕获文件由服务器的 -C 选项生成。捕获中的每个连接在重放时也是一个连接，在它被接受的时间（按速度缩放）建立；
+ * 连接上的字节流按HTTP报文切分成请求（请求头之后按Content-Length取请求体，末尾不完整的请求不发送），
+ * 每个请求安排在捕获中收齐的时间发送。服务器不支持流水线，同一连接上的下一个请求要等前一个响应收完，
+ * 所以延迟从实际发送算起，落后于计划的时间另外统计（lag）。同一个捕获文件每次重放的请求、连接和时间安排都相同
+ */
+
+namespace {
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "80";
+    double speed = 1;
+    int threads = 1;
+    int maxConns = 1000;
+    int timeoutMs = 5000;
+    size_t limit = 0;
+    std::string output;
+};
+
+struct Request {
+    uint64_t atNs;  // 捕获中请求收齐的时间
+    size_t offset;  // 在连接字节流中的位置
+    size_t len;
+    bool head;      // HEAD请求的响应没有响应体
+};
+
+// 捕获中的一个连接
+struct Session {
+    uint32_t id = 0;
+    uint64_t openNs = 0;
+    std::string bytes;
+    std::vector<std::pair<size_t, uint64_t>> chunks; // 每次读取结束的位置和时间
+    std::vector<Request> requests;
+};
+
+struct Stats {
+    HistogramSnapshot latency;
+    HistogramSnapshot lag;      // 实际发送比计划晚的时间
+    uint64_t sent = 0;
+    uint64_t responses = 0;
+    uint64_t bytes = 0;
+    uint64_t status[6] = {};    // 1xx..5xx，其他
+    uint64_t connectErrors = 0;
+    uint64_t closed = 0;        // 服务器提前关闭连接，没有得到响应或者没有发送的请求
+    uint64_t timeouts = 0;
+    uint64_t parseErrors = 0;
+};
+
+bool ieq(const char* a, const char* b, size_t n) {
+    return strncasecmp(a, b, n) == 0;
+}
+
+bool ParseUrl(const std::string& url, Options& opt) {
+    std::string rest = url;
+    if(rest.compare(0, 7, "http://") == 0) { rest = rest.substr(7); }
+    rest = rest.substr(0, rest.find('/'));
+    size_t colon = rest.rfind(':');
+    if(colon == std::string::npos) {
+        opt.host = rest;
+    } else {
+        opt.host = rest.substr(0, colon);
+        opt.port = rest.substr(colon + 1);
+    }
+    return !opt.host.empty() && !opt.port.empty();
+}
+
+// 把连接的字节流切分成请求，返回末尾不完整的字节数
+size_t SplitRequests(Session& s) {
+    size_t pos = 0;
+    while(pos < s.bytes.size()) {
+        size_t headerEnd = s.bytes.find("\r\n\r\n", pos);
+        if(headerEnd == std::string::npos) { break; }
+        const char* p = s.bytes.data();
+        size_t bodyLen = 0;
+        for(size_t line = s.bytes.find("\r\n", pos) + 2; line < headerEnd;) {
+            size_t next = s.bytes.find("\r\n", line);
+            if(next - line > 15 && ieq(p + line, "Content-length:", 15)) {
+                bodyLen = strtoul(p + line + 15, nullptr, 10);
+            }
+            line = next + 2;
+        }
+        size_t end = headerEnd + 4 + bodyLen;
+        if(end > s.bytes.size()) { break; }
+        // 请求的最后一个字节所在的那次读取的时间
+        auto chunk = std::lower_bound(s.chunks.begin(), s.chunks.end(), std::make_pair(end, uint64_t(0)));
+        uint64_t at = chunk == s.chunks.end() ? s.chunks.back().second : chunk->second;
+        s.requests.push_back({at, pos, end - pos, ieq(p + pos, "HEAD ", 5)});
+        pos = end;
+    }
+    return s.bytes.size() - pos;
+}
+
+// 读取捕获文件，按连接被接受的时间排序
+bool LoadCapture(const std::string& file, size_t limit, std::vector<Session>& sessions, uint64_t& spanNs,
+                 uint64_t& incomplete) {
+    FILE* fp = fopen(file.c_str(), "rb");
+    if(!fp) {
+        perror(file.c_str());
+        return false;
+    }
+    capture::FileHeader header;
+    if(fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, capture::MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s: not a capture file\n", file.c_str());
+        fclose(fp);
+        return false;
+    }
+    std::unordered_map<uint32_t, size_t> index;
+    capture::Record record;
+    std::string data;
+    spanNs = 0;
+    while(fread(&record, sizeof(record), 1, fp) == 1) {
+        data.resize(record.len());
+        if(record.len() && fread(&data[0], record.len(), 1, fp) != 1) { break; } // 服务器还在写或者异常退出
+        spanNs = std::max(spanNs, record.offsetNs);
+        auto it = index.find(record.conn);
+        if(it == index.end()) {
+            if(record.type() != capture::OPEN || (limit && sessions.size() >= limit)) { continue; }
+            it = index.emplace(record.conn, sessions.size()).first;
+            sessions.emplace_back();
+            sessions.back().id = record.conn;
+            sessions.back().openNs = record.offsetNs;
+        }
+        Session& s = sessions[it->second];
+        if(record.type() == capture::DATA) {
+            s.bytes += data;
+            s.chunks.emplace_back(s.bytes.size(), record.offsetNs);
+        }
+    }
+    fclose(fp);
+    incomplete = 0;
+    for(auto& s : sessions) {
+        if(SplitRequests(s) > 0) { incomplete++; }
+        s.chunks.clear();
+        s.chunks.shrink_to_fit();
+    }
+    sessions.erase(std::remove_if(sessions.begin(), sessions.end(), [](const Session& s) { return s.requests.empty(); }),
+                   sessions.end());
+    std::stable_sort(sessions.begin(), sessions.end(),
+                     [](const Session& a, const Session& b) { return a.openNs < b.openNs; });
+    return true;
+}
+
+struct Conn {
+    const Session* session = nullptr;
+    size_t index = 0;     // 在线程的连接列表中的位置，用作epoll的数据
+    int fd = -1;
+    bool connecting = false;
+    bool wantWrite = false;
+    size_t next = 0;      // 下一个要发送的请求
+    bool inflight = false;
+    uint64_t sendNs = 0;  // 在途请求实际发送的时间
+    std::string in;
+    size_t outPos = 0;    // 在途请求已经写出的字节
+};
+
+class Worker {
+public:
+    Worker(const Options& opt, const sockaddr_storage& addr, socklen_t addrLen, uint64_t startNs, int maxConns)
+        : opt_(opt), addr_(addr), addrLen_(addrLen), startNs_(startNs), maxConns_(std::max(1, maxConns)) {
+        memset(&stats_.latency, 0, sizeof(stats_.latency));
+        memset(&stats_.lag, 0, sizeof(stats_.lag));
+    }
+
+    void Add(const Session* session) {
+        conns_.emplace_back();
+        conns_.back().session = session;
+        conns_.back().index = conns_.size() - 1;
+    }
+
+    void Run();
+    const Stats& GetStats() const { return stats_; }
+
+private:
+    // 捕获中的时间换算成重放的计划时间
+    uint64_t Planned_(uint64_t captureNs) const {
+        return opt_.speed > 0 ? startNs_ + static_cast<uint64_t>(captureNs / opt_.speed) : startNs_;
+    }
+    void Schedule_(size_t idx, uint64_t at) { timers_.push({at, idx}); }
+    void Connect_(size_t idx, uint64_t now);
+    void Finish_(Conn& conn, bool failed); // 关闭连接，还没有完成的请求计为closed
+    void Send_(Conn& conn, uint64_t now);
+    void Flush_(Conn& conn);
+    void Read_(Conn& conn, size_t idx, uint64_t now);
+    bool ParseResponse_(Conn& conn, size_t idx, uint64_t now);
+    void UpdateEvents_(Conn& conn);
+    void CheckTimeouts_(uint64_t now);
+    void Record_(HistogramSnapshot& h, uint64_t ns);
+
+    const Options& opt_;
+    sockaddr_storage addr_;
+    socklen_t addrLen_;
+    uint64_t startNs_;
+    int maxConns_;
+    int open_ = 0;
+    size_t done_ = 0;
+    std::deque<Conn> conns_;
+    std::deque<size_t> waiting_; // 到了建立时间、但打开的连接已经达到上限
+    // 计划事件：建立连接或者发送下一个请求
+    std::priority_queue<std::pair<uint64_t, size_t>, std::vector<std::pair<uint64_t, size_t>>,
+                        std::greater<std::pair<uint64_t, size_t>>> timers_;
+    int epollFd_ = -1;
+    Stats stats_;
+};
+
+void Worker::Record_(HistogramSnapshot& h, uint64_t ns) {
+    h.counts[hdr::BucketIndex(ns)]++;
+    h.count++;
+    h.sumNs += ns;
+    if(ns > h.maxNs) { h.maxNs = ns; }
+}
+
+void Worker::Connect_(size_t idx, uint64_t now) {
+    Conn& conn = conns_[idx];
+    if(open_ >= maxConns_) {
+        waiting_.push_back(idx);
+        return;
+    }
+    conn.fd = socket(addr_.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int ret = conn.fd < 0 ? -1 : connect(conn.fd, reinterpret_cast<const sockaddr*>(&addr_), addrLen_);
+    if(conn.fd < 0 || (ret < 0 && errno != EINPROGRESS)) {
+        stats_.connectErrors++;
+        if(conn.fd >= 0) { close(conn.fd); }
+        conn.fd = -1;
+        stats_.closed += conn.session->requests.size();
+        done_++;
+        return;
+    }
+    int one = 1;
+    setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    open_++;
+    conn.connecting = ret < 0;
+    conn.wantWrite = conn.connecting;
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | (conn.wantWrite ? EPOLLOUT : 0);
+    ev.data.u64 = idx;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, conn.fd, &ev);
+    Schedule_(idx, std::max(now, Planned_(conn.session->requests[0].atNs)));
+}
+
+void Worker::Finish_(Conn& conn, bool failed) {
+    if(failed) {
+        stats_.closed += conn.session->requests.size() - conn.next; // 正在进行的请求就是requests[next]，已经包含在内
+    }
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+    close(conn.fd);
+    conn.fd = -1;
+    conn.inflight = false;
+    conn.next = conn.session->requests.size();
+    std::string().swap(conn.in);
+    open_--;
+    done_++;
+    uint64_t now = CheapClock::NowNs();
+    while(open_ < maxConns_ && !waiting_.empty()) {
+        size_t idx = waiting_.front();
+        waiting_.pop_front();
+        Connect_(idx, now);
+    }
+}
+
+void Worker::Send_(Conn& conn, uint64_t now) {
+    const Request& req = conn.session->requests[conn.next];
+    if(opt_.speed > 0) { // 不等待时所有请求都计划在开始时发送，落后的时间没有意义
+        uint64_t planned = Planned_(req.atNs);
+        Record_(stats_.lag, now > planned ? now - planned : 0);
+    }
+    conn.inflight = true;
+    conn.sendNs = now;
+    conn.outPos = 0;
+    stats_.sent++;
+    Flush_(conn);
+}
+
+void Worker::UpdateEvents_(Conn& conn) {
+    bool want = conn.connecting || (conn.inflight && conn.outPos < conn.session->requests[conn.next].len);
+    if(want == conn.wantWrite) { return; }
+    conn.wantWrite = want;
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+    ev.data.u64 = conn.index;
+    epoll_ctl(epollFd_, EPOLL_CTL_MOD, conn.fd, &ev);
+}
+
+void Worker::Flush_(Conn& conn) {
+    const Request& req = conn.session->requests[conn.next];
+    const char* data = conn.session->bytes.data() + req.offset;
+    while(conn.outPos < req.len) {
+        ssize_t n = ::write(conn.fd, data + conn.outPos, req.len - conn.outPos);
+        if(n < 0) {
+            if(errno == EAGAIN || errno == EINTR) { break; }
+            Finish_(conn, true);
+            return;
+        }
+        conn.outPos += n;
+    }
+    UpdateEvents_(conn);
+}
+
+bool Worker::ParseResponse_(Conn& conn, size_t idx, uint64_t now) {
+    size_t headerEnd = conn.in.find("\r\n\r\n");
+    if(headerEnd == std::string::npos) { return false; }
+    const char* p = conn.in.data();
+    int status = 0;
+    if(!conn.inflight || conn.in.size() < 12 || !ieq(p, "HTTP/1.", 7) || sscanf(p + 9, "%d", &status) != 1) {
+        stats_.parseErrors++;
+        Finish_(conn, true);
+        return false;
+    }
+    const Request& req = conn.session->requests[conn.next];
+    size_t bodyLen = 0;
+    bool close = false;
+    for(size_t line = conn.in.find("\r\n") + 2; line < headerEnd;) {
+        size_t next = conn.in.find("\r\n", line);
+        if(next - line > 15 && ieq(p + line, "Content-length:", 15)) {
+            bodyLen = strtoul(p + line + 15, nullptr, 10);
+        } else if(next - line >= 17 && ieq(p + line, "Connection: close", 17)) {
+            close = true;
+        }
+        line = next + 2;
+    }
+    size_t total = headerEnd + 4 + (req.head ? 0 : bodyLen);
+    if(conn.in.size() < total) { return false; }
+    conn.in.erase(0, total);
+    Record_(stats_.latency, now > conn.sendNs ? now - conn.sendNs : 0);
+    stats_.responses++;
+    stats_.bytes += total;
+    stats_.status[status >= 100 && status < 600 ? status / 100 - 1 : 5]++;
+    conn.inflight = false;
+    conn.next++;
+    if(conn.next == conn.session->requests.size() || close) {
+        Finish_(conn, conn.next < conn.session->requests.size());
+        return false;
+    }
+    Schedule_(idx, std::max(now, Planned_(conn.session->requests[conn.next].atNs)));
+    return true;
+}
+
+void Worker::Read_(Conn& conn, size_t idx, uint64_t now) {
+    char buf[65536];
+    while(true) {
+        ssize_t n = ::read(conn.fd, buf, sizeof(buf));
+        if(n > 0) {
+            conn.in.append(buf, n);
+            continue;
+        }
+        if(n < 0 && (errno == EAGAIN || errno == EINTR)) { break; }
+        while(ParseResponse_(conn, idx, now)) {}
+        if(conn.fd >= 0) { Finish_(conn, true); } // 服务器关闭连接时还有请求没有完成
+        return;
+    }
+    while(ParseResponse_(conn, idx, now)) {}
+}
+
+void Worker::CheckTimeouts_(uint64_t now) {
+    uint64_t timeoutNs = static_cast<uint64_t>(opt_.timeoutMs) * 1000000ULL;
+    for(auto& conn : conns_) {
+        if(conn.fd >= 0 && conn.inflight && now - conn.sendNs > timeoutNs) {
+            stats_.timeouts++;
+            conn.inflight = false;
+            conn.next++;
+            Finish_(conn, true);
+        }
+    }
+}
+
+void Worker::Run() {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    for(size_t i = 0; i < conns_.size(); i++) {
+        Schedule_(i, Planned_(conns_[i].session->openNs));
+    }
+    std::vector<epoll_event> events(1024);
+    uint64_t lastCheck = CheapClock::NowNs();
+    while(done_ < conns_.size()) {
+        uint64_t now = CheapClock::NowNs();
+        while(!timers_.empty() && timers_.top().first <= now) {
+            size_t idx = timers_.top().second;
+            timers_.pop();
+            Conn& conn = conns_[idx];
+            if(conn.fd < 0 && conn.next == 0) {
+                Connect_(idx, now);
+            } else if(conn.fd >= 0 && !conn.connecting && !conn.inflight && conn.next < conn.session->requests.size()) {
+                Send_(conn, now);
+            }
+        }
+        int timeoutMs = 100;
+        if(!timers_.empty()) {
+            uint64_t at = timers_.top().first;
+            timeoutMs = at <= now ? 0 : static_cast<int>(std::min<uint64_t>(100, (at - now) / 1000000 + 1));
+        }
+        int n = epoll_wait(epollFd_, events.data(), static_cast<int>(events.size()), timeoutMs);
+        now = CheapClock::NowNs();
+        for(int i = 0; i < n; i++) {
+            size_t idx = events[i].data.u64;
+            Conn& conn = conns_[idx];
+            if(conn.fd < 0) { continue; }
+            if(conn.connecting && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if(err) {
+                    stats_.connectErrors++;
+                    Finish_(conn, true);
+                    continue;
+                }
+                conn.connecting = false;
+                UpdateEvents_(conn);
+                Schedule_(idx, now); // 第一个请求的时间可能已经过了
+            }
+            if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                Read_(conn, idx, now);
+            }
+            if(conn.fd >= 0 && conn.inflight && (events[i].events & EPOLLOUT)) {
+                Flush_(conn);
+            }
+        }
+        if(now - lastCheck > 100000000ULL) {
+            CheckTimeouts_(now);
+            lastCheck = now;
+        }
+    }
+    close(epollFd_);
+}
+
+void Merge(HistogramSnapshot& to, const HistogramSnapshot& from) {
+    for(int i = 0; i < hdr::BUCKETS; i++) { to.counts[i] += from.counts[i]; }
+    to.count += from.count;
+    to.sumNs += from.sumNs;
+    to.maxNs = std::max(to.maxNs, from.maxNs);
+}
+
+void AppendLatency(std::string& out, const HistogramSnapshot& h) {
+    static const struct { const char* name; double q; } PERCENTILES[] = {
+        {"p50", 0.5}, {"p75", 0.75}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}, {"p9999", 0.9999},
+    };
+    char buf[64];
+    snprintf(buf, sizeof(buf), "{\"mean\":%.1f", h.count ? h.sumNs / 1e3 / h.count : 0.0);
+    out += buf;
+    for(auto& p : PERCENTILES) {
+        snprintf(buf, sizeof(buf), ",\"%s\":%.1f", p.name, h.Percentile(p.q) / 1e3);
+        out += buf;
+    }
+    snprintf(buf, sizeof(buf), ",\"max\":%.1f}", h.maxNs / 1e3);
+    out += buf;
+}
+
+std::string JsonEscape(const std::string& str) {
+    std::string out;
+    for(unsigned char c : str) {
+        if(c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if(c < 0x20) {
+            char hex[8];
+            snprintf(hex, sizeof(hex), "\\u%04x", c);
+            out += hex;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    int ch;
+    while((ch = getopt(argc, argv, "x:t:c:T:n:o:")) != -1) {
+        switch(ch) {
+        case 'x': opt.speed = atof(optarg); break;
+        case 't': opt.threads = atoi(optarg); break;
+        case 'c': opt.maxConns = atoi(optarg); break;
+        case 'T': opt.timeoutMs = atoi(optarg); break;
+        case 'n': opt.limit = strtoul(optarg, nullptr, 10); break;
+        case 'o': opt.output = optarg; break;
+        default: optind = argc + 1; break;
+        }
+    }
+    if(optind != argc - 2 || opt.speed < 0 || !ParseUrl(argv[optind + 1], opt)) {
+        fprintf(stderr, "usage: %s [-x speed] [-t threads] [-c max_conns] [-T timeout_ms] [-n sessions] "
+                        "[-o result.json] capture.bin http://host:port\n", argv[0]);
+        return 1;
+    }
+    std::string file = argv[optind];
+    std::vector<Session> sessions;
+    uint64_t spanNs = 0;
+    uint64_t incomplete = 0;
+    if(!LoadCapture(file, opt.limit, sessions, spanNs, incomplete)) {
+        return 1;
+    }
+    size_t requests = 0;
+    for(auto& s : sessions) { requests += s.requests.size(); }
+    if(sessions.empty()) {
+        fprintf(stderr, "%s: no complete requests\n", file.c_str());
+        return 1;
+    }
+    opt.threads = std::max(1, std::min<int>(opt.threads, static_cast<int>(sessions.size())));
+
+    struct addrinfo hints = {}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int err = getaddrinfo(opt.host.c_str(), opt.port.c_str(), &hints, &res);
+    if(err != 0) {
+        fprintf(stderr, "%s:%s: %s\n", opt.host.c_str(), opt.port.c_str(), gai_strerror(err));
+        return 1;
+    }
+    sockaddr_storage addr = {};
+    memcpy(&addr, res->ai_addr, res->ai_addrlen);
+    socklen_t addrLen = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    // 连接按顺序轮流分给各线程，每个线程的连接数上限平分
+    uint64_t startNs = CheapClock::NowNs() + 10000000ULL;
+    std::vector<std::unique_ptr<Worker>> workers;
+    for(int i = 0; i < opt.threads; i++) {
+        int conns = opt.maxConns / opt.threads + (i < opt.maxConns % opt.threads ? 1 : 0);
+        workers.emplace_back(new Worker(opt, addr, addrLen, startNs, conns));
+    }
+    for(size_t i = 0; i < sessions.size(); i++) {
+        workers[i % workers.size()]->Add(&sessions[i]);
+    }
+    std::vector<std::thread> threads;
+    for(auto& worker : workers) {
+        threads.emplace_back(&Worker::Run, worker.get());
+    }
+    for(auto& t : threads) { t.join(); }
+    double elapsed = (CheapClock::NowNs() - startNs) / 1e9;
+
+    std::unique_ptr<Stats> total(new Stats());
+    for(auto& worker : workers) {
+        const Stats& s = worker->GetStats();
+        Merge(total->latency, s.latency);
+        Merge(total->lag, s.lag);
+        total->sent += s.sent;
+        total->responses += s.responses;
+        total->bytes += s.bytes;
+        for(int i = 0; i < 6; i++) { total->status[i] += s.status[i]; }
+        total->connectErrors += s.connectErrors;
+        total->closed += s.closed;
+        total->timeouts += s.timeouts;
+        total->parseErrors += s.parseErrors;
+    }
+
+    char buf[512];
+    // 路径和主机名长度不定，直接拼接，buf 只格式化数值字段
+    std::string json = "{\"config\":{\"capture\":\"" + JsonEscape(file) + "\",\"host\":\"" + JsonEscape(opt.host) +
+                       "\",\"port\":\"" + JsonEscape(opt.port) + "\",";
+    snprintf(buf, sizeof(buf),
+             "\"speed\":%g,\"threads\":%d,\"max_conns\":%d},"
+             "\"sessions\":%zu,\"captured_requests\":%zu,\"incomplete_sessions\":%llu,\"captured_s\":%.3f,\"elapsed_s\":%.3f,",
+             opt.speed, opt.threads, opt.maxConns, sessions.size(), requests, static_cast<unsigned long long>(incomplete), spanNs / 1e9, elapsed);
+    json += buf;
+    snprintf(buf, sizeof(buf),
+             "\"requests\":%llu,\"rps\":%.1f,\"bytes\":%llu,\"mb_per_s\":%.2f,"
+             "\"status\":{\"1xx\":%llu,\"2xx\":%llu,\"3xx\":%llu,\"4xx\":%llu,\"5xx\":%llu,\"other\":%llu},"
+             "\"errors\":{\"connect\":%llu,\"closed\":%llu,\"timeout\":%llu,\"parse\":%llu},",
+             static_cast<unsigned long long>(total->responses), total->responses / elapsed,
+             static_cast<unsigned long long>(total->bytes), total->bytes / 1048576.0 / elapsed,
+             static_cast<unsigned long long>(total->status[0]), static_cast<unsigned long long>(total->status[1]),
+             static_cast<unsigned long long>(total->status[2]), static_cast<unsigned long long>(total->status[3]),
+             static_cast<unsigned long long>(total->status[4]), static_cast<unsigned long long>(total->status[5]),
+             static_cast<unsigned long long>(total->connectErrors), static_cast<unsigned long long>(total->closed),
+             static_cast<unsigned long long>(total->timeouts), static_cast<unsigned long long>(total->parseErrors));
+    json += buf;
+    json += "\"latency_us\":";
+    AppendLatency(json, total->latency);
+    json += ",\"lag_us\":";
+    AppendLatency(json, total->lag);
+    json += "}\n";
+
+    fputs(json.c_str(), stdout);
+    if(!opt.output.empty()) {
+        FILE* out = fopen(opt.output.c_str(), "w");
+        if(!out) {
+            perror(opt.output.c_str());
+            return 1;
+        }
+        fputs(json.c_str(), out);
+        fclose(out);
+    }
+    fprintf(stderr, "%llu/%zu requests over %zu connections in %.2fs (captured %.2fs), p50 %.1fus p99 %.1fus p99.9 %.1fus "
+                    "max %.1fus, lag p99 %.1fus, errors %llu\n",
+            static_cast<unsigned long long>(total->responses), requests, sessions.size(), elapsed, spanNs / 1e9,
+            total->latency.Percentile(0.5) / 1e3, total->latency.Percentile(0.99) / 1e3,
+            total->latency.Percentile(0.999) / 1e3, total->latency.maxNs / 1e3, total->lag.Percentile(0.99) / 1e3,
+            static_cast<unsigned long long>(total->connectErrors + total->closed + total->timeouts + total->parseErrors));
+    return 0;
+}